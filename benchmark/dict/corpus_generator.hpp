@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// The shape of a synthetic dictionary, written in the format of the text files loaded by the
+// dictionaries, i.e. a `key\tvalue` line per entry.
+struct CorpusOptions {
+  size_t entries = 10000;  // the lines of the file, including the ones of the duplicated keys
+  // the key lengths in code points, skewed to the short ones like the words of a language
+  size_t minKeyLength = 2;
+  size_t maxKeyLength = 10;
+  double cjkRate = 0.5;         // the rate of the keys of CJK ideographs, the others of a-z
+  double duplicateRate = 0.05;  // the rate of the lines repeating the key of an earlier line
+  // the value lengths in bytes, made of the words of a small vocabulary sharing many suffixes
+  size_t minValueLength = 8;
+  size_t maxValueLength = 64;
+  uint64_t seed = 5489;
+};
+
+// Generates the same corpus for the same options on every platform, by mapping the output of
+// std::mt19937_64, which is specified by the standard, instead of the standard distributions.
+class CorpusGenerator {
+public:
+  explicit CorpusGenerator(const CorpusOptions& options)
+      : options_(options), random_(options.seed) {
+    static const std::vector<std::string> SUFFIXES = {"", "s", "ed", "ing", "er", "ly", "tion"};
+    constexpr size_t VOCABULARY_SIZE = 512;
+    for (size_t i = 0; i < VOCABULARY_SIZE; ++i) {
+      std::string word;
+      for (size_t length = 2 + uniform(5); word.length() < length;) {
+        word.push_back(static_cast<char>('a' + skewed(26)));
+      }
+      vocabulary_.push_back(word + SUFFIXES[uniform(SUFFIXES.size())]);
+    }
+  }
+
+  // Writes the corpus to the file, and returns its distinct keys in the order of their first lines.
+  std::vector<std::string> write(const std::string& path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("Failed to create the corpus file: " + path);
+    }
+    std::vector<std::string> keys;
+    std::unordered_set<std::string> seen;
+    std::string value;
+    for (size_t line = 0; line < options_.entries; ++line) {
+      if (!keys.empty() && chance(options_.duplicateRate)) {
+        file << keys[uniform(keys.size())];
+      } else {
+        // a longer key on a collision, as the short keys run out
+        std::string key = makeKey(0);
+        for (size_t extra = 1; !seen.insert(key).second; ++extra) {
+          key = makeKey(extra);
+        }
+        file << key;
+        keys.push_back(std::move(key));
+      }
+      makeValue(value);
+      file << '\t' << value << '\n';
+    }
+    return keys;
+  }
+
+private:
+  // the common ideographs from U+4E00, picked more often than the rare ones
+  static constexpr uint32_t CJK_BEGIN = 0x4E00;
+  static constexpr uint32_t CJK_COUNT = 8000;
+
+  size_t uniform(size_t count) { return static_cast<size_t>(random_() % count); }
+  // in [0, count), the smaller numbers more likely
+  size_t skewed(size_t count) { return std::min(uniform(count), uniform(count)); }
+  bool chance(double rate) { return static_cast<double>(random_() >> 11) * 0x1.0p-53 < rate; }
+
+  std::string makeKey(size_t extraLength) {
+    const size_t length =
+        options_.minKeyLength + skewed(options_.maxKeyLength - options_.minKeyLength + 1);
+    const bool cjk = chance(options_.cjkRate);
+    std::string key;
+    for (size_t i = 0; i < length + extraLength; ++i) {
+      if (cjk) {
+        const uint32_t codePoint = CJK_BEGIN + static_cast<uint32_t>(skewed(CJK_COUNT));
+        key.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        key.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        key.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+      } else {
+        key.push_back(static_cast<char>('a' + skewed(26)));
+      }
+    }
+    return key;
+  }
+
+  void makeValue(std::string& value) {
+    const size_t length =
+        options_.minValueLength + uniform(options_.maxValueLength - options_.minValueLength + 1);
+    value.clear();
+    while (value.length() < length) {
+      if (!value.empty()) {
+        value.push_back(' ');
+      }
+      value.append(vocabulary_[skewed(vocabulary_.size())]);
+    }
+  }
+
+  CorpusOptions options_;
+  std::mt19937_64 random_;
+  std::vector<std::string> vocabulary_;
+};
@@ -1,13 +1,24 @@
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
+#include "corpus_generator.hpp"
 #include "dicts/dictionary.h"
+#include "dicts/double_array_trie.h"
+#include "dicts/fst.h"
+#include "dicts/fuzzy_matcher.h"
 #include "dicts/leveldb.h"
+#include "dicts/sharded_trie.h"
+#include "dicts/sorted_text_dictionary.h"
 #include "dicts/trie.h"
 #include "map.hpp"
 #include "process_memory.hpp"
@@ -25,8 +36,10 @@ static std::string getDataFilePath() {
 }
 constexpr size_t DICT_SIZE = 10;  // Small size for dummy data
 #else
+// the dictionary file in the environment variable, e.g. cedict_fixed.u8
 static std::string getDataFilePath() {
-  return "/Users/hj/Library/Rime/js/data/cedict_fixed.u8";
+  const char* path = std::getenv("RIME_QJS_BENCHMARK_DICT");
+  return path != nullptr ? path : "/Users/hj/Library/Rime/js/data/cedict_fixed.u8";
 }
 constexpr size_t DICT_SIZE = 119000;  // Actual size
 #endif
@@ -136,6 +149,161 @@ BENCHMARK(bmFindDataTrie)
     ->Unit(benchmark::kMicrosecond)
     ->ReportAggregatesOnly();  // Use microseconds for potentially faster search
 
+// the keys of a batch lookup, the keys in the dictionary repeated with a missing key in between
+static std::vector<std::string> makeLookupKeys(const Dictionary& dict, size_t count) {
+  std::vector<std::string> words;
+  for (const auto& [key, value] : dict.prefixSearch("")) {
+    words.push_back(key);
+    words.emplace_back("nonexistent-word");
+  }
+  std::vector<std::string> keys;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    keys.push_back(words[i % words.size()]);
+  }
+  return keys;
+}
+
+// Benchmark looking up a batch of keys with Trie, one find per key as the baseline of findMany
+static void bmFindEachTrie(benchmark::State& state) {
+  rime::Trie trie;
+  trie.loadTextFile(getDataFilePath(), PARSE_TEXT_FILE_OPTIONS);
+  const auto keys = makeLookupKeys(trie, static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    std::vector<std::optional<std::string>> values;
+    values.reserve(keys.size());
+    for (const auto& key : keys) {
+      values.push_back(trie.find(key));
+    }
+    benchmark::DoNotOptimize(values);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+}
+BENCHMARK(bmFindEachTrie)
+    ->Arg(10)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
+// Benchmark looking up a batch of keys with Trie::findMany, with the batch size and the threads
+static void bmFindManyTrie(benchmark::State& state) {
+  rime::Trie trie;
+  trie.loadTextFile(getDataFilePath(), PARSE_TEXT_FILE_OPTIONS);
+  const auto keys = makeLookupKeys(trie, static_cast<size_t>(state.range(0)));
+  const FindManyOptions options{.threads = static_cast<size_t>(state.range(1))};
+
+  for (auto _ : state) {
+    auto values = trie.findManyView(keys, options);
+    benchmark::DoNotOptimize(values);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+}
+BENCHMARK(bmFindManyTrie)
+    ->Args({10, 1})
+    ->Args({1000, 1})
+    ->Args({100000, 1})
+    ->Args({100000, 4})
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
+// Benchmark looking up the keys in a trie file with the values deduplicated and compressed or not,
+// with the file size relative to the plain one, and the decoded blocks kept in the cache
+static void bmFindCompressedTrie(benchmark::State& state) {
+  const bool compressed = state.range(0) != 0;
+  const std::string plainPath = getDataFolderPath() + "/plain_values.bin";
+  const std::string path = getDataFolderPath() + "/compressed_values.bin";
+  auto options = PARSE_TEXT_FILE_OPTIONS;
+  rime::Trie trie;
+  trie.buildBinaryFile(getDataFilePath(), options, plainPath);
+  options.deduplicateValues = compressed;
+  options.compressValues = compressed;
+  trie.buildBinaryFile(getDataFilePath(), options, path);
+  trie.loadBinaryFile(path, {.cachedValueBlocks = static_cast<size_t>(state.range(1))});
+  const auto keys = makeLookupKeys(trie, 1000);
+
+  for (auto _ : state) {
+    for (const auto& key : keys) {
+      auto value = trie.findView(key);
+      benchmark::DoNotOptimize(value);
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+  state.counters["CompressionRatio"] = static_cast<double>(std::filesystem::file_size(plainPath)) /
+                                       static_cast<double>(std::filesystem::file_size(path));
+  std::filesystem::remove(plainPath);
+  std::filesystem::remove(path);
+}
+BENCHMARK(bmFindCompressedTrie)
+    ->Args({0, 0})
+    ->Args({1, 1})
+    ->Args({1, 64})
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
+// the misspelled keys of the dummy data and the real data
+static const std::vector<std::string> FUZZY_QUERIES = {"点投", "点点地滴", "acord", "nonexistent"};
+
+// Benchmark Trie::fuzzySearch, with the max distance as the argument
+static void bmFuzzySearchTrie(benchmark::State& state) {
+  rime::Trie trie;
+  trie.loadTextFile(getDataFilePath(), PARSE_TEXT_FILE_OPTIONS);
+  const auto maxDistance = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state) {
+    for (const auto& query : FUZZY_QUERIES) {
+      auto matches = trie.fuzzySearch(query, maxDistance);
+      benchmark::DoNotOptimize(matches);
+    }
+  }
+}
+BENCHMARK(bmFuzzySearchTrie)
+    ->Arg(1)
+    ->Arg(2)
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
+// Benchmark the distances to every key as the baseline of fuzzySearch, with the max distance
+static void bmFuzzySearchBruteForce(benchmark::State& state) {
+  rime::Trie trie;
+  trie.loadTextFile(getDataFilePath(), PARSE_TEXT_FILE_OPTIONS);
+  std::vector<std::string> keys;
+  for (const auto& [key, value] : trie.prefixSearch("")) {
+    keys.push_back(key);
+  }
+  const auto maxDistance = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state) {
+    for (const auto& query : FUZZY_QUERIES) {
+      LevenshteinMatcher matcher(query, maxDistance);
+      std::vector<std::string_view> matches;
+      for (const auto& key : keys) {
+        matcher.truncate(0);
+        for (size_t pos = 0; pos < key.size();) {
+          uint32_t codePoint = 0;
+          pos += decodeUtf8(key, pos, codePoint);
+          matcher.push(codePoint);
+        }
+        if (matcher.distance().has_value()) {
+          matches.push_back(key);
+        }
+      }
+      benchmark::DoNotOptimize(matches);
+    }
+  }
+}
+BENCHMARK(bmFuzzySearchBruteForce)
+    ->Arg(1)
+    ->Arg(2)
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
 // Benchmark loading text file into std::unordered_map
 static void bmLoadTextToMap(benchmark::State& state) {
   for (auto _ : state) {
@@ -148,6 +316,24 @@ BENCHMARK(bmLoadTextToMap)
     ->Unit(benchmark::kMillisecond)
     ->ReportAggregatesOnly();
 
+// Benchmark parsing the text file in chunks, with the thread count as the argument
+static void bmParseTextFileWithThreads(benchmark::State& state) {
+  auto options = PARSE_TEXT_FILE_OPTIONS;
+  options.threads = static_cast<size_t>(state.range(0));
+  for (auto _ : state) {
+    auto map = Dictionary::parseTextFile(getDataFilePath(), options);
+    benchmark::DoNotOptimize(map);
+  }
+}
+BENCHMARK(bmParseTextFileWithThreads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMillisecond)
+    ->ReportAggregatesOnly();
+
 // Benchmark MmapStringMap serialization
 static void bmMmapSerialization(benchmark::State& state) {
   auto map = Dictionary::parseTextFile(getDataFilePath(), PARSE_TEXT_FILE_OPTIONS);
@@ -327,6 +513,429 @@ BENCHMARK(bmFindDataLevelDb)
     ->Unit(benchmark::kMicrosecond)
     ->ReportAggregatesOnly();
 
+// Benchmark looking up a batch of keys with LevelDb, one find per key as the baseline of findMany
+static void bmFindEachLevelDb(benchmark::State& state) {
+  auto levelDbDir = getDataFolderPath() + "/dictionary.leveldb";
+  removeLevelDbDir(levelDbDir);
+  LevelDb db;
+  db.loadTextFile(getDataFilePath(), PARSE_TEXT_FILE_OPTIONS);
+  db.saveToBinaryFile(levelDbDir);
+  const auto keys = makeLookupKeys(db, static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    std::vector<std::optional<std::string>> values;
+    values.reserve(keys.size());
+    for (const auto& key : keys) {
+      values.push_back(db.find(key));
+    }
+    benchmark::DoNotOptimize(values);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+
+  db.close();
+  removeLevelDbDir(levelDbDir);
+}
+BENCHMARK(bmFindEachLevelDb)
+    ->Arg(10)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
+// Benchmark looking up a batch of keys with LevelDb::findMany, with the batch size and the threads
+static void bmFindManyLevelDb(benchmark::State& state) {
+  auto levelDbDir = getDataFolderPath() + "/dictionary.leveldb";
+  removeLevelDbDir(levelDbDir);
+  LevelDb db;
+  db.loadTextFile(getDataFilePath(), PARSE_TEXT_FILE_OPTIONS);
+  db.saveToBinaryFile(levelDbDir);
+  const auto keys = makeLookupKeys(db, static_cast<size_t>(state.range(0)));
+  const FindManyOptions options{.threads = static_cast<size_t>(state.range(1))};
+
+  for (auto _ : state) {
+    auto values = db.findMany(keys, options);
+    benchmark::DoNotOptimize(values);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+
+  db.close();
+  removeLevelDbDir(levelDbDir);
+}
+BENCHMARK(bmFindManyLevelDb)
+    ->Args({10, 1})
+    ->Args({1000, 1})
+    ->Args({100000, 1})
+    ->Args({100000, 4})
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
+// Benchmark looking up the keys with LevelDb tuned with the bloom filter bits per key and the block
+// cache size in KB, reopened to start with a cold cache
+static void bmFindTunedLevelDb(benchmark::State& state) {
+  auto levelDbDir = getDataFolderPath() + "/dictionary.leveldb";
+  const LevelDbOptions tuning{.blockCacheSize = static_cast<size_t>(state.range(1)) * 1024,
+                              .bloomFilterBitsPerKey = static_cast<int>(state.range(0))};
+  removeLevelDbDir(levelDbDir);
+  std::vector<std::string> keys;
+  {
+    LevelDb dbSetup;
+    dbSetup.loadTextFile(getDataFilePath(), PARSE_TEXT_FILE_OPTIONS);
+    dbSetup.saveToBinaryFile(levelDbDir, tuning);
+    keys = makeLookupKeys(dbSetup, 10000);
+  }
+
+  LevelDb db;
+  db.loadBinaryFile(levelDbDir, tuning);
+  for (auto _ : state) {
+    for (const auto& key : keys) {
+      auto value = db.find(key);
+      benchmark::DoNotOptimize(value);
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+
+  db.close();
+  removeLevelDbDir(levelDbDir);
+}
+BENCHMARK(bmFindTunedLevelDb)
+    ->Args({0, 0})
+    ->Args({10, 0})
+    ->Args({10, 32 * 1024})
+    ->Repetitions(REPEATATIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
+// --- Benchmarks at Scale ---
+
+// The backends are compared on the synthetic corpora of the entries in the argument, to choose a
+// backend by the size of a dictionary. The corpora are generated once per run and removed at exit.
+
+constexpr const int SCALED_REPETITIONS = 3;  // fewer, as building the 1M corpus takes seconds
+constexpr size_t SCALED_LOOKUPS = 1000;      // the keys found per iteration, half of them missing
+constexpr size_t SCALED_PREFIXES = 100;      // the prefixes searched per iteration
+
+struct Corpus {
+  std::string path;
+  std::vector<std::string> lookups;
+  // the first 3 bytes of the keys, i.e. a CJK ideograph or 3 letters, as typed by the users
+  std::vector<std::string> prefixes;
+};
+
+static const Corpus& getCorpus(size_t entries) {
+  struct Corpora {
+    std::map<size_t, Corpus> bySize;
+    ~Corpora() {
+      for (const auto& [size, corpus] : bySize) {
+        std::filesystem::remove(corpus.path);
+      }
+    }
+  };
+  static Corpora corpora;
+
+  auto [found, inserted] = corpora.bySize.try_emplace(entries);
+  Corpus& corpus = found->second;
+  if (inserted) {
+    corpus.path = getDataFolderPath() + "/corpus_" + std::to_string(entries) + ".txt";
+    const auto keys = CorpusGenerator({.entries = entries}).write(corpus.path);
+    const size_t step = std::max<size_t>(keys.size() / SCALED_LOOKUPS, 1);
+    for (size_t i = 0; i < keys.size() && corpus.lookups.size() < SCALED_LOOKUPS; i += step) {
+      corpus.lookups.push_back(keys[i]);
+      corpus.lookups.push_back(keys[i] + "-missing");
+      if (corpus.prefixes.size() < SCALED_PREFIXES) {
+        corpus.prefixes.push_back(keys[i].substr(0, 3));
+      }
+    }
+  }
+  return corpus;
+}
+
+// the backends built from a corpus into a file, and loaded from it to be looked up
+struct TrieBackend {
+  static constexpr const char* NAME = "scaled.trie";
+  static void build(const std::string& txtPath, const std::string& path) {
+    rime::Trie trie;
+    trie.buildBinaryFile(txtPath, PARSE_TEXT_FILE_OPTIONS, path);
+  }
+  static void remove(const std::string& path) { std::filesystem::remove(path); }
+  void load(const std::string& path) { trie.loadBinaryFile(path); }
+  [[nodiscard]] bool find(const std::string& key) const { return trie.findView(key).has_value(); }
+  [[nodiscard]] size_t prefixSearch(const std::string& prefix) const {
+    return trie.prefixSearchView(prefix).size();
+  }
+
+  rime::Trie trie;
+};
+
+// the trie with the perfect hash of the keys, to compare the exact lookups with the walks of it
+struct PerfectHashTrieBackend : TrieBackend {
+  static constexpr const char* NAME = "scaled.phash.trie";
+  static void build(const std::string& txtPath, const std::string& path) {
+    auto options = PARSE_TEXT_FILE_OPTIONS;
+    options.perfectHashIndex = true;
+    rime::Trie trie;
+    trie.buildBinaryFile(txtPath, options, path);
+  }
+};
+
+struct DoubleArrayTrieBackend {
+  static constexpr const char* NAME = "scaled.dat";
+  static void build(const std::string& txtPath, const std::string& path) {
+    rime::DoubleArrayTrie trie;
+    trie.loadTextFile(txtPath, PARSE_TEXT_FILE_OPTIONS);
+    trie.saveToBinaryFile(path);
+  }
+  static void remove(const std::string& path) { std::filesystem::remove(path); }
+  void load(const std::string& path) { trie.loadBinaryFile(path); }
+  [[nodiscard]] bool find(const std::string& key) const { return trie.findView(key).has_value(); }
+  [[nodiscard]] size_t prefixSearch(const std::string& prefix) const {
+    return trie.prefixSearchView(prefix).size();
+  }
+
+  rime::DoubleArrayTrie trie;
+};
+
+struct FstBackend {
+  static constexpr const char* NAME = "scaled.fst";
+  static void build(const std::string& txtPath, const std::string& path) {
+    rime::Fst fst;
+    fst.loadTextFile(txtPath, PARSE_TEXT_FILE_OPTIONS);
+    fst.saveToBinaryFile(path);
+  }
+  static void remove(const std::string& path) { std::filesystem::remove(path); }
+  void load(const std::string& path) { fst.loadBinaryFile(path); }
+  [[nodiscard]] bool find(const std::string& key) const { return fst.findView(key).has_value(); }
+  [[nodiscard]] size_t prefixSearch(const std::string& prefix) const {
+    return fst.prefixSearchView(prefix).size();
+  }
+
+  rime::Fst fst;
+};
+
+// the corpus sorted into a text file by the keys, its index is built on the first load
+struct SortedTextBackend {
+  static constexpr const char* NAME = "scaled.sorted.txt";
+  static void build(const std::string& txtPath, const std::string& path) {
+    auto map = Dictionary::parseTextFile(txtPath, PARSE_TEXT_FILE_OPTIONS);
+    std::vector<std::pair<std::string, std::string>> entries(map.begin(), map.end());
+    std::sort(entries.begin(), entries.end());
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    for (const auto& [key, value] : entries) {
+      file << key << '\t' << value << '\n';
+    }
+    file.close();
+    rime::SortedTextDictionary dictionary;
+    dictionary.loadTextFile(path, PARSE_TEXT_FILE_OPTIONS);
+  }
+  static void remove(const std::string& path) {
+    std::filesystem::remove(path);
+    std::filesystem::remove(rime::SortedTextDictionary::indexPathOf(path));
+  }
+  void load(const std::string& path) { dictionary.loadTextFile(path, PARSE_TEXT_FILE_OPTIONS); }
+  [[nodiscard]] bool find(const std::string& key) const {
+    return dictionary.find(key).has_value();
+  }
+  [[nodiscard]] size_t prefixSearch(const std::string& prefix) const {
+    return dictionary.prefixSearch(prefix).size();
+  }
+
+  rime::SortedTextDictionary dictionary;
+};
+
+struct LevelDbBackend {
+  static constexpr const char* NAME = "scaled.leveldb";
+  static void build(const std::string& txtPath, const std::string& path) {
+    removeLevelDbDir(path);
+    LevelDb db;
+    db.loadTextFile(txtPath, PARSE_TEXT_FILE_OPTIONS);
+    db.saveToBinaryFile(path);
+  }
+  static void remove(const std::string& path) { removeLevelDbDir(path); }
+  void load(const std::string& path) { db.loadBinaryFile(path); }
+  [[nodiscard]] bool find(const std::string& key) const { return db.find(key).has_value(); }
+  [[nodiscard]] size_t prefixSearch(const std::string& prefix) const {
+    return db.prefixSearch(prefix).size();
+  }
+
+  LevelDb db;
+};
+
+struct MmapBackend {
+  static constexpr const char* NAME = "scaled.mmap";
+  static void build(const std::string& txtPath, const std::string& path) {
+    auto map = Dictionary::parseTextFile(txtPath, PARSE_TEXT_FILE_OPTIONS);
+    MmapStringMap mmap;
+    mmap.reserve(map.size());
+    for (const auto& [key, value] : map) {
+      mmap.add(key, value);
+    }
+    mmap.save(path);
+  }
+  static void remove(const std::string& path) { std::filesystem::remove(path); }
+  void load(const std::string& path) { mmap.load(path); }
+  [[nodiscard]] bool find(const std::string& key) const { return mmap.find(key).has_value(); }
+  [[nodiscard]] size_t prefixSearch(const std::string& prefix) const {
+    return mmap.prefixSearch(prefix).size();
+  }
+
+  MmapStringMap mmap;
+};
+
+// Benchmark building a backend from the text file
+template <typename Backend>
+static void bmBuildScaled(benchmark::State& state) {
+  const auto& corpus = getCorpus(static_cast<size_t>(state.range(0)));
+  const auto path = getDataFolderPath() + "/" + Backend::NAME;
+  for (auto _ : state) {
+    Backend::build(corpus.path, path);
+    state.PauseTiming();
+    Backend::remove(path);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// Benchmark loading a backend from the built file, with the memory it takes
+template <typename Backend>
+static void bmLoadScaled(benchmark::State& state) {
+  const auto& corpus = getCorpus(static_cast<size_t>(state.range(0)));
+  const auto path = getDataFolderPath() + "/" + Backend::NAME;
+  Backend::build(corpus.path, path);
+  for (auto _ : state) {
+    Backend backend;
+    backend.load(path);
+    benchmark::DoNotOptimize(backend);
+  }
+
+  const auto memoryStart = getRssUsage();
+  {
+    Backend backend;
+    backend.load(path);
+    state.counters["MemoryUsed(KB)"] = getRssUsage() - memoryStart;
+  }
+  Backend::remove(path);
+}
+
+// Benchmark finding the keys in a loaded backend, half of them missing
+template <typename Backend>
+static void bmFindScaled(benchmark::State& state) {
+  const auto& corpus = getCorpus(static_cast<size_t>(state.range(0)));
+  const auto path = getDataFolderPath() + "/" + Backend::NAME;
+  Backend::build(corpus.path, path);
+  {
+    Backend backend;
+    backend.load(path);
+    for (auto _ : state) {
+      for (const auto& key : corpus.lookups) {
+        auto found = backend.find(key);
+        benchmark::DoNotOptimize(found);
+      }
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * corpus.lookups.size()));
+  Backend::remove(path);
+}
+
+// Benchmark searching the short prefixes in a loaded backend
+template <typename Backend>
+static void bmPrefixSearchScaled(benchmark::State& state) {
+  const auto& corpus = getCorpus(static_cast<size_t>(state.range(0)));
+  const auto path = getDataFolderPath() + "/" + Backend::NAME;
+  Backend::build(corpus.path, path);
+  size_t matches = 0;
+  {
+    Backend backend;
+    backend.load(path);
+    for (auto _ : state) {
+      matches = 0;
+      for (const auto& prefix : corpus.prefixes) {
+        matches += backend.prefixSearch(prefix);
+      }
+      benchmark::DoNotOptimize(matches);
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * corpus.prefixes.size()));
+  state.counters["Matches"] = static_cast<double>(matches);
+  Backend::remove(path);
+}
+
+static void scaledArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->Arg(10000)->Arg(100000)->Arg(1000000);
+}
+
+#define BENCHMARK_SCALED(func, backend, unit) \
+  BENCHMARK_TEMPLATE(func, backend)           \
+      ->Apply(scaledArgs)                     \
+      ->Repetitions(SCALED_REPETITIONS)       \
+      ->Unit(unit)                            \
+      ->ReportAggregatesOnly()
+
+BENCHMARK_SCALED(bmBuildScaled, TrieBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmBuildScaled, PerfectHashTrieBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmBuildScaled, DoubleArrayTrieBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmBuildScaled, FstBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmBuildScaled, LevelDbBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmBuildScaled, MmapBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmBuildScaled, SortedTextBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmLoadScaled, TrieBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmLoadScaled, PerfectHashTrieBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmLoadScaled, DoubleArrayTrieBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmLoadScaled, FstBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmLoadScaled, LevelDbBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmLoadScaled, MmapBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmLoadScaled, SortedTextBackend, benchmark::kMillisecond);
+BENCHMARK_SCALED(bmFindScaled, TrieBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmFindScaled, PerfectHashTrieBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmFindScaled, DoubleArrayTrieBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmFindScaled, FstBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmFindScaled, LevelDbBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmFindScaled, MmapBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmFindScaled, SortedTextBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmPrefixSearchScaled, TrieBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmPrefixSearchScaled, DoubleArrayTrieBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmPrefixSearchScaled, FstBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmPrefixSearchScaled, LevelDbBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmPrefixSearchScaled, MmapBackend, benchmark::kMicrosecond);
+BENCHMARK_SCALED(bmPrefixSearchScaled, SortedTextBackend, benchmark::kMicrosecond);
+
+// Benchmark the prefix searches of a sharded trie by the shards and the threads searching them, in
+// the wall time, as the shards are searched in the other threads
+static void bmPrefixSearchSharded(benchmark::State& state) {
+  const auto& corpus = getCorpus(static_cast<size_t>(state.range(0)));
+  rime::ShardedTrie trie({.shards = static_cast<size_t>(state.range(1)),
+                          .threads = static_cast<size_t>(state.range(2))});
+  trie.loadTextFile(corpus.path, PARSE_TEXT_FILE_OPTIONS);
+  size_t matches = 0;
+  for (auto _ : state) {
+    matches = 0;
+    for (const auto& prefix : corpus.prefixes) {
+      matches += trie.prefixSearch(prefix).size();
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * corpus.prefixes.size()));
+  state.counters["Matches"] = static_cast<double>(matches);
+}
+
+static void shardedArgs(benchmark::internal::Benchmark* benchmark) {
+  for (const int64_t shards : {1, 2, 4, 8}) {
+    for (const int64_t threads : {1, 2, 4, 8}) {
+      if (threads <= shards) {
+        benchmark->Args({1000000, shards, threads});
+      }
+    }
+  }
+}
+
+BENCHMARK(bmPrefixSearchSharded)
+    ->Apply(shardedArgs)
+    ->ArgNames({"entries", "shards", "threads"})
+    ->UseRealTime()
+    ->Repetitions(SCALED_REPETITIONS)
+    ->Unit(benchmark::kMicrosecond)
+    ->ReportAggregatesOnly();
+
 // --- Main ---
 
 // Helper to create dummy file if not using real data
@@ -6,8 +6,11 @@
 #include <fstream>
 #include <ios>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 class MmapStringMap {
@@ -32,7 +35,8 @@ class MmapStringMap {
 
   std::string stringsPool_;
   std::vector<KeyValuePair> pairs_;
-  std::unordered_map<std::string_view, const StringRef&> map_;
+  // the indexes into pairs_ by the keys in stringsPool_, of the loaded map
+  std::unordered_map<std::string_view, size_t> map_;
 
 public:
   std::unordered_map<std::string, std::string> exportToMap() {
@@ -47,10 +51,7 @@ public:
     return result;
   }
 
-  void reserve(size_t size) {
-    pairs_.reserve(size);
-    map_.reserve(size);
-  }
+  void reserve(size_t size) { pairs_.reserve(size); }
 
   void add(const std::string& key, const std::string& value) {
     size_t offset = stringsPool_.size();
@@ -64,9 +65,6 @@ public:
     };
 
     pairs_.push_back(pair);
-
-    std::string_view keyView(stringsPool_.data() + offset, key.size());
-    map_.try_emplace(keyView, refVal);
   }
 
   void save(const std::string& filename) {
@@ -118,18 +116,40 @@ public:
         static_cast<const char*>(region.get_address()) + header->strings_offset;
     stringsPool_.assign(stringsBase, header->strings_size);
 
-    pairs_.reserve(header->count);
-
     const auto* pairs = reinterpret_cast<const KeyValuePair*>(
         static_cast<const char*>(region.get_address()) + sizeof(FileHeader));
+    pairs_.assign(pairs, pairs + header->count);
+
+    // indexed after the pool is copied, which the keys point into
+    map_.clear();
+    map_.reserve(pairs_.size());
+    for (size_t i = 0; i < pairs_.size(); ++i) {
+      map_.try_emplace(view(pairs_[i].key), i);
+    }
+  }
 
-    for (size_t i = 0; i < header->count; ++i) {
-      const auto& pair = pairs[i];
-      pairs_.push_back(pair);
+  [[nodiscard]] std::optional<std::string_view> find(std::string_view key) const {
+    auto found = map_.find(key);
+    if (found == map_.end()) {
+      return std::nullopt;
+    }
+    return view(pairs_[found->second].value);
+  }
 
-      std::string_view keyView(stringsBase + pair.key.offset, pair.key.length);
-      const auto& value = pair.value;
-      map_.try_emplace(keyView, value);
+  // a linear scan, as the pairs are not sorted
+  [[nodiscard]] std::vector<std::pair<std::string_view, std::string_view>> prefixSearch(
+      std::string_view prefix) const {
+    std::vector<std::pair<std::string_view, std::string_view>> result;
+    for (const auto& [key, value] : pairs_) {
+      if (view(key).substr(0, prefix.size()) == prefix) {
+        result.emplace_back(view(key), view(value));
+      }
     }
+    return result;
+  }
+
+private:
+  [[nodiscard]] std::string_view view(const StringRef& ref) const {
+    return {stringsPool_.data() + ref.offset, ref.length};
   }
 };
@@ -552,6 +552,134 @@ interface ParseTextFileOptions {
    * @default "$|$"
    */
   concatSeparator?: string
+
+  /**
+   * Number of threads to parse the file in chunks, `0` to use all the hardware threads
+   * @default 1
+   */
+  threads?: number
+
+  /**
+   * Memory budget in bytes to build a dictionary file in the key order, with `Trie.buildBinaryFile`
+   * or `LevelDb.saveToBinaryFile`. The sorted entries beyond it are spilled to temporary files next
+   * to the built file, to build the files larger than the memory.
+   * @default 0 - no limit, to build the dictionary file in memory, except that `LevelDb` sorts the
+   * entries within 64MB then
+   */
+  memoryBudget?: number
+
+  /**
+   * The column of the value split by the delimiter, counted from 1, holding the numeric weight of the key,
+   * to search the heaviest keys of a prefix with `Trie.topK`. The weight of a concatenated value is the
+   * max weight of its items. Ignored by LevelDb.
+   * @default 0 - no weights
+   */
+  weightColumn?: number
+
+  /**
+   * Whether to index the values, or the items of the concatenated values, to look up the keys by them with
+   * `Trie.reverseFind`, instead of loading the file with `isReversed` into another trie. Ignored by LevelDb.
+   * @default false
+   */
+  reverseIndex?: boolean
+  /**
+   * Whether to index the keys by a minimal perfect hash in the binary file of a trie, to find the keys in O(1)
+   * with `Trie.find`, `Trie.findAll` and `Trie.findMany` instead of walking the trie, at about 9 bytes per
+   * key. A key not in the trie is rejected by a 32-bit fingerprint, and mistaken for a key with the
+   * probability of 1 / 2^32. The prefix searches still walk the trie. Ignored by LevelDb.
+   * @default false
+   */
+  perfectHashIndex?: boolean
+  /**
+   * Whether to store the identical values once in the binary file of a trie, e.g. the same definitions of many
+   * keys. Ignored by LevelDb.
+   * @default false
+   */
+  deduplicateValues?: boolean
+  /**
+   * Whether to compress the values in the binary file of a trie, in small blocks with a dictionary trained from
+   * the values. The blocks are decoded on demand and cached, see `TrieLoadOptions.cachedValueBlocks`.
+   * Ignored by LevelDb.
+   * @default false
+   */
+  compressValues?: boolean
+}
+
+/**
+ * Options to limit the results of a prefix search
+ * @namespace PrefixSearchOptions
+ */
+interface PrefixSearchOptions {
+  /**
+   * Maximum number of results to return
+   * @default 0 - no limit
+   */
+  limit?: number
+
+  /**
+   * Number of results to skip, for pagination
+   * @default 0
+   */
+  offset?: number
+}
+
+/**
+ * Options to look up a batch of keys
+ * @namespace FindManyOptions
+ */
+interface FindManyOptions {
+  /**
+   * Number of threads to look up a large batch of keys, 0 to use all the hardware threads.
+   * A small batch is always looked up in the calling thread.
+   * @default 1
+   */
+  threads?: number
+}
+
+/**
+ * Iterates the matches of a prefix search lazily
+ * @namespace PrefixIterator
+ */
+interface PrefixIterator {
+  /**
+   * Get the next match or null if at the end
+   */
+  next(): { text: string; info: string } | null
+}
+
+/**
+ * Options for loading a binary trie file
+ * @namespace TrieLoadOptions
+ */
+interface TrieLoadOptions {
+  /**
+   * How to load the trie structure:
+   *    - `map`: map it in place, the file pages are shared between processes
+   *    - `read`: read it into private memory
+   * @default "map"
+   */
+  mode?: 'map' | 'read'
+
+  /**
+   * Hint to the OS about the access pattern of the mapped file
+   *    - `random`: lookups, disables read-ahead
+   *    - `willneed`: prefetch the file into memory
+   * @default "normal"
+   */
+  advice?: 'normal' | 'random' | 'sequential' | 'willneed'
+
+  /**
+   * Whether to verify the checksums of all the sections in the file while loading.
+   * It reads the whole file, so it's slower to load.
+   * @default false
+   */
+  verifyChecksums?: boolean
+  /**
+   * The number of the decoded blocks of the compressed values to keep in memory, if the file is built with
+   * `compressValues`. The trie fails to load if it's negative.
+   * @default 64
+   */
+  cachedValueBlocks?: number
 }
 
 /**
@@ -577,9 +705,35 @@ interface Trie {
   /**
    * Loads a trie from a binary file
    * @param path - The path to the binary file containing trie data
+   * @param options - Options for loading the binary file
    * @throws {Error} If the file cannot be read or the format is invalid
    */
-  loadBinaryFile(path: string): void
+  loadBinaryFile(path: string, options?: TrieLoadOptions): void
+
+  /**
+   * Loads a trie from a binary file on a background thread, without blocking the key strokes.
+   * The lookups before the promise is settled see the previous contents of the trie, e.g. `find`
+   * returns null for a new trie, see `isLoaded()`.
+   * The promise is settled at the next call into the plugins, as the IME has no event loop.
+   * @param path - The path to the binary file containing trie data
+   * @param options - Options for loading the binary file
+   * @returns A promise resolved once the trie is loaded, or rejected if the file cannot be read or
+   * the format is invalid
+   * @example
+   * ```js
+   * const trie = new Trie()
+   * trie.loadBinaryFileAsync(path).then(() => console.log('loaded'))
+   * // in the processor/translator/filter
+   * if (!trie.isLoaded()) return []
+   * ```
+   */
+  loadBinaryFileAsync(path: string, options?: TrieLoadOptions): Promise<void>
+
+  /**
+   * Checks whether the trie is loaded or built, e.g. by `loadBinaryFileAsync`
+   * @returns True if the trie has been loaded
+   */
+  isLoaded(): boolean
 
   /**
    * Saves the current trie to a binary file
@@ -588,6 +742,17 @@ interface Trie {
    */
   saveToBinaryFile(path: string): void
 
+  /**
+   * Builds a binary file from a text file, and loads it.
+   * Unlike `loadTextFile` and `saveToBinaryFile`, the values are not kept in memory, and the memory
+   * to sort the entries is bounded by `options.memoryBudget`.
+   * @param txtPath - The path to the text file containing trie data
+   * @param binaryPath - The path where the binary file will be saved
+   * @param options - Options for parsing the text file
+   * @throws {Error} If the files cannot be read or written
+   */
+  buildBinaryFile(txtPath: string, binaryPath: string, options?: ParseTextFileOptions): void
+
   /**
    * Searches for an exact match of the key in the trie
    * @param key - The string to search for
@@ -595,12 +760,425 @@ interface Trie {
    */
   find(key: string): string
 
+  /**
+   * Searches for the values of the key, i.e. the values of the duplicated key concatenated with
+   * `onDuplicatedKey: 'Concat'`, which are split when the trie is built
+   * @param key - The string to search for
+   * @returns the values of the key, or an empty array if the key does not exist
+   */
+  findAll(key: string): string[]
+
+  /**
+   * Searches for the exact matches of a batch of keys, in one call
+   * @param keys - The strings to search for
+   * @param options - The threads to search with
+   * @returns the values aligned with the keys, null for the keys not in the trie
+   */
+  findMany(keys: string[], options?: FindManyOptions): Array<string | null>
+
   /**
    * Searches for all key-value pairs in the trie that the key starts with the given prefix
    * @param prefix - The prefix to search for
+   * @param options - The range of the results to return
    * @returns An array of objects that the key starts with the given prefix
    */
-  prefixSearch(prefix: string): Array<{ text: string; info: string }>
+  prefixSearch(prefix: string, options?: PrefixSearchOptions): Array<{ text: string; info: string }>
+
+  /**
+   * Iterates the key-value pairs that the key starts with the given prefix lazily, the cost is
+   * proportional to the results consumed.
+   * @param prefix - The prefix to search for
+   * @returns An iterator of the matches, in the same order as `prefixSearch`
+   */
+  prefixIterator(prefix: string): PrefixIterator
+
+  /**
+   * Searches for the heaviest keys starting with the given prefix, without visiting the other keys.
+   * The trie should be built with `weightColumn`, otherwise it throws an error.
+   * @param prefix - The prefix to search for
+   * @param k - The number of the keys to return
+   * @returns The keys with their whole values and weights, in the descending order of the weights
+   * @throws {Error} If `k` is negative
+   */
+  topK(prefix: string, k: number): Array<{ text: string; info: string; weight: number }>
+
+  /**
+   * Searches for the keys similar to the query, e.g. to correct the typos, without visiting the keys
+   * starting with a prefix too far from the query.
+   * @param query - The string to search for
+   * @param maxDistance - The max Levenshtein distance in characters between the query and a key
+   * @param limit - The max number of the keys to return, 0 for no limit
+   * @returns The keys with their whole values and distances, the nearest first
+   * @throws {Error} If `maxDistance` or `limit` is negative
+   */
+  fuzzySearch(
+    query: string,
+    maxDistance: number,
+    limit?: number,
+  ): Array<{ text: string; info: string; distance: number }>
+
+  /**
+   * Finds the keys by a value, or by an item of the concatenated values, e.g. the pinyin of a Hanzi in a
+   * pinyin to Hanzi dictionary. The trie should be built with `reverseIndex`, otherwise it throws an error.
+   * @param value - The value to search for
+   * @returns The keys with the value, in the ascending order
+   */
+  reverseFind(value: string): string[]
+
+  /**
+   * Searches for the keys that are prefixes of the text, e.g. the candidate words at a position of a
+   * sentence, in one walk down the trie.
+   * @param text - The text to match the keys against
+   * @returns The keys with their whole values and lengths in the text, from the shortest to the longest
+   */
+  commonPrefixSearch(text: string): Array<{ text: string; info: string; length: number }>
+
+  /**
+   * Splits the text into the longest keys from the left greedily, i.e. forward maximal matching.
+   * @param text - The text to split
+   * @returns The segments of the text in order, with the whole values of the keys, or `null` for a
+   * character that does not start any key
+   */
+  longestMatchSegmentation(text: string): Array<{ text: string; info: string | null }>
+
+  /**
+   * Adds a key-value pair, or overrides the value of an existing key, without rebuilding the trie.
+   * The added keys are found right away, and listed after the other keys by the prefix searches.
+   * The prefix iterators created before are invalidated.
+   * @param key - The key to add
+   * @param value - The value of the key
+   */
+  add(key: string, value: string): void
+
+  /**
+   * Rebuilds the trie in memory with the added keys merged, to search them faster.
+   * `saveToBinaryFile` compacts the trie before saving it.
+   */
+  compact(): void
+}
+
+/**
+ * A dictionary on a double-array trie, an alternative to `Trie` for the plugins bound by the latency of
+ * the exact lookups, e.g. the annotation filters. A key is looked up by one read of the array per byte,
+ * at the cost of a larger binary file. The binary file is not compatible with the one of `Trie`.
+ */
+interface DoubleArrayTrie {
+  /**
+   * Creates a new instance of DoubleArrayTrie
+   */
+  new (): DoubleArrayTrie
+
+  /**
+   * Builds the trie from a text file, in the same format as `Trie.loadTextFile`
+   * @param path - The path to the text file containing trie data
+   * @param options - Options for parsing the text file
+   * @throws {Error} If the file cannot be read or the format is invalid
+   */
+  loadTextFile(path: string, options?: ParseTextFileOptions): void
+
+  /**
+   * Loads the trie from a binary file saved by `saveToBinaryFile`, with the array mapped in place
+   * @param path - The path to the binary file containing trie data
+   * @param options - Options for loading the binary file, `mode` and `advice` are ignored
+   * @throws {Error} If the file cannot be read or the format is invalid
+   */
+  loadBinaryFile(path: string, options?: TrieLoadOptions): void
+
+  /**
+   * Saves the trie to a binary file
+   * @param path - The path where the binary file will be saved
+   * @throws {Error} If the file cannot be written
+   */
+  saveToBinaryFile(path: string): void
+
+  /**
+   * Searches for an exact match of the key in the trie
+   * @param key - The string to search for
+   * @returns the value if the key exists in the trie, null otherwise
+   */
+  find(key: string): string | null
+
+  /**
+   * Searches for the values of the key, i.e. the values of the duplicated key concatenated with
+   * `onDuplicatedKey: 'Concat'`
+   * @param key - The string to search for
+   * @returns the values of the key, or an empty array if the key does not exist
+   */
+  findAll(key: string): string[]
+
+  /**
+   * Searches for the exact matches of a batch of keys
+   * @param keys - The strings to search for
+   * @returns the values aligned with the keys, null for the keys not in the trie
+   */
+  findMany(keys: string[]): Array<string | null>
+
+  /**
+   * Searches for all key-value pairs in the trie where the key starts with the given prefix
+   * @param prefix - The prefix to search for
+   * @param options - The range of the results to return
+   * @returns An array of objects containing matching key-value pairs, in the byte order of the keys
+   */
+  prefixSearch(prefix: string, options?: PrefixSearchOptions): Array<{ text: string; info: string }>
+
+  /**
+   * Checks whether the key is in the trie, without reading its value
+   * @param key - The string to search for
+   * @returns True if the key exists in the trie
+   */
+  contains(key: string): boolean
+}
+
+/**
+ * A dictionary on a minimal acyclic finite state transducer, which shares the states of the common prefixes
+ * and suffixes of the keys, e.g. a large dictionary of pinyin or inflected words. The entries could be
+ * iterated in the byte order of the keys from any key. The binary file is not compatible with the one of
+ * `Trie`.
+ */
+interface Fst {
+  /**
+   * Creates a new instance of Fst
+   */
+  new (): Fst
+
+  /**
+   * Builds the transducer from a text file, in the same format as `Trie.loadTextFile`
+   * @param path - The path to the text file containing dictionary data
+   * @param options - Options for parsing the text file
+   * @throws {Error} If the file cannot be read or the format is invalid
+   */
+  loadTextFile(path: string, options?: ParseTextFileOptions): void
+
+  /**
+   * Loads the transducer from a binary file saved by `saveToBinaryFile`, mapped in place
+   * @param path - The path to the binary file containing dictionary data
+   * @param options - Options for loading the binary file, `mode` and `advice` are ignored
+   * @throws {Error} If the file cannot be read or the format is invalid
+   */
+  loadBinaryFile(path: string, options?: TrieLoadOptions): void
+
+  /**
+   * Saves the transducer to a binary file
+   * @param path - The path where the binary file will be saved
+   * @throws {Error} If the file cannot be written
+   */
+  saveToBinaryFile(path: string): void
+
+  /**
+   * Searches for an exact match of the key
+   * @param key - The string to search for
+   * @returns the value if the key exists, null otherwise
+   */
+  find(key: string): string | null
+
+  /**
+   * Searches for the values of the key, i.e. the values of the duplicated key concatenated with
+   * `onDuplicatedKey: 'Concat'`
+   * @param key - The string to search for
+   * @returns the values of the key, or an empty array if the key does not exist
+   */
+  findAll(key: string): string[]
+
+  /**
+   * Searches for the exact matches of a batch of keys
+   * @param keys - The strings to search for
+   * @returns the values aligned with the keys, null for the missing keys
+   */
+  findMany(keys: string[]): Array<string | null>
+
+  /**
+   * Searches for all key-value pairs where the key starts with the given prefix
+   * @param prefix - The prefix to search for
+   * @param options - The range of the results to return
+   * @returns An array of objects containing matching key-value pairs, in the byte order of the keys
+   */
+  prefixSearch(prefix: string, options?: PrefixSearchOptions): Array<{ text: string; info: string }>
+
+  /**
+   * Iterates the key-value pairs of the keys from `from` (inclusive) to `to` (exclusive)
+   * @param from - The least key to return, or an empty string to start from the first key
+   * @param to - The key to stop before, or an empty string to iterate to the last key
+   * @param options - The range of the results to return
+   * @returns An array of objects containing the key-value pairs, in the byte order of the keys
+   * @example
+   * ```js
+   * // the first 10 entries since 'zhong'
+   * const entries = fst.range('zhong', '', { limit: 10 })
+   * ```
+   */
+  range(from: string, to: string, options?: PrefixSearchOptions): Array<{ text: string; info: string }>
+
+  /**
+   * Checks whether the key is in the dictionary, without reading its value
+   * @param key - The string to search for
+   * @returns True if the key exists
+   */
+  contains(key: string): boolean
+}
+
+/**
+ * Options to create a sharded trie
+ * @namespace ShardedTrieOptions
+ */
+interface ShardedTrieOptions {
+  /**
+   * Number of the tries the keys are hashed into when built from a text file. A loaded binary file keeps the
+   * shards it's saved with.
+   * @default 4
+   */
+  shards?: number
+
+  /**
+   * Number of threads to search the shards concurrently, `0` for a thread per shard up to the hardware
+   * threads, `1` to search them in the calling thread
+   * @default 0
+   */
+  threads?: number
+}
+
+/**
+ * A dictionary of the keys hashed into several tries, whose prefix searches walk the shards concurrently
+ * on a small thread pool, for the short prefixes of the dictionaries of millions of keys. The results are
+ * merged in the same order regardless of the shards and the threads.
+ */
+interface ShardedTrie {
+  /**
+   * Creates a new instance of ShardedTrie
+   * @param options - The shards and the threads to search them
+   */
+  new (options?: ShardedTrieOptions): ShardedTrie
+
+  /**
+   * Builds the shards from a text file, in the same format as `Trie.loadTextFile`
+   * @param path - The path to the text file containing dictionary data
+   * @param options - Options for parsing the text file and building the shards
+   * @throws {Error} If the file cannot be read or the format is invalid
+   */
+  loadTextFile(path: string, options?: ParseTextFileOptions): void
+
+  /**
+   * Loads the shards saved by `saveToBinaryFile`, concurrently
+   * @param path - The path to the binary file recording the shards
+   * @param options - Options for loading the binary files of the shards
+   * @throws {Error} If a file cannot be read or the format is invalid
+   */
+  loadBinaryFile(path: string, options?: TrieLoadOptions): void
+
+  /**
+   * Saves the shards to the binary files `<path>.0`, `<path>.1`, ..., and the file of the path recording them
+   * @param path - The path where the binary file will be saved
+   * @throws {Error} If a file cannot be written
+   */
+  saveToBinaryFile(path: string): void
+
+  /**
+   * Searches for an exact match of the key, in the shard of the key only
+   * @param key - The string to search for
+   * @returns the value if the key exists, null otherwise
+   */
+  find(key: string): string | null
+
+  /**
+   * Searches for the values of the key, i.e. the values of the duplicated key concatenated with
+   * `onDuplicatedKey: 'Concat'`
+   * @param key - The string to search for
+   * @returns the values of the key, or an empty array if the key does not exist
+   */
+  findAll(key: string): string[]
+
+  /**
+   * Searches for the exact matches of a batch of keys
+   * @param keys - The strings to search for
+   * @returns the values aligned with the keys, null for the missing keys
+   */
+  findMany(keys: string[]): Array<string | null>
+
+  /**
+   * Searches for all key-value pairs where the key starts with the given prefix, in all the shards
+   * concurrently. The offset and the limit apply to the merged results, so every shard collects all its
+   * matches.
+   * @param prefix - The prefix to search for
+   * @param options - The range of the results to return
+   * @returns An array of objects containing matching key-value pairs, in the byte order of the keys
+   */
+  prefixSearch(prefix: string, options?: PrefixSearchOptions): Array<{ text: string; info: string }>
+
+  /**
+   * Searches for the heaviest keys starting with the given prefix, the same as `Trie.topK`, in all the shards
+   * concurrently. The shards should be built with `weightColumn`, otherwise it throws an error.
+   * @param prefix - The prefix to search for
+   * @param k - The number of the keys to return
+   * @returns The keys with their whole values and weights, in the descending order of the weights
+   * @throws {Error} If `k` is negative
+   */
+  topK(prefix: string, k: number): Array<{ text: string; info: string; weight: number }>
+
+  /**
+   * Checks whether the key is in the dictionary
+   * @param key - The string to search for
+   * @returns True if the key exists
+   */
+  contains(key: string): boolean
+}
+
+/**
+ * A dictionary served from a text file sorted by the keys in the byte order, e.g. by `LC_ALL=C sort`, without
+ * building a binary file, for the dictionaries changed often. The text file is mapped as-is and searched on a
+ * sparse index of its lines, which is cached in the `.idx` file beside it and rebuilt once it's modified.
+ * Replace the file by renaming a new one over it: the lookups throw an Error once the loaded file is
+ * rewritten in place, until it's loaded again.
+ */
+interface SortedTextDictionary {
+  /**
+   * Creates a new instance of SortedTextDictionary
+   */
+  new (): SortedTextDictionary
+
+  /**
+   * Maps the sorted text file, and loads or builds its index. The lines of a duplicated key should be
+   * adjacent, and their values are merged on lookups following `onDuplicatedKey`.
+   * @param path - The path to the text file sorted by the keys
+   * @param options - Options for parsing the lines, `isReversed` is not supported and `lines` is ignored
+   * @throws {Error} If the file cannot be read or the keys are not sorted
+   */
+  loadTextFile(path: string, options?: ParseTextFileOptions): void
+
+  /**
+   * Searches for an exact match of the key
+   * @param key - The string to search for
+   * @returns the value if the key exists, null otherwise
+   */
+  find(key: string): string | null
+
+  /**
+   * Searches for the values of the key, i.e. the values of the duplicated key concatenated with
+   * `onDuplicatedKey: 'Concat'`
+   * @param key - The string to search for
+   * @returns the values of the key, or an empty array if the key does not exist
+   */
+  findAll(key: string): string[]
+
+  /**
+   * Searches for the exact matches of a batch of keys
+   * @param keys - The strings to search for
+   * @returns the values aligned with the keys, null for the missing keys
+   */
+  findMany(keys: string[]): Array<string | null>
+
+  /**
+   * Searches for all key-value pairs where the key starts with the given prefix
+   * @param prefix - The prefix to search for
+   * @param options - The range of the results to return
+   * @returns An array of objects containing matching key-value pairs, in the byte order of the keys
+   */
+  prefixSearch(prefix: string, options?: PrefixSearchOptions): Array<{ text: string; info: string }>
+
+  /**
+   * Checks whether the key is in the dictionary
+   * @param key - The string to search for
+   * @returns True if the key exists
+   */
+  contains(key: string): boolean
 }
 
 /**
@@ -707,6 +1285,68 @@ interface Environment {
    * @throws {Error} If command execution fails
    */
   popen(command: string): string
+
+  /**
+   * Opens a trie binary file shared by all the plugins and schemas in the process.
+   * The file is loaded once, unless it's modified since then, and released when the last plugin using it
+   * is finalized. The shared trie should not be added to.
+   * @param path - The path to the binary file containing trie data
+   * @param options - Options for loading the binary file, only the options of the first load take effect
+   * @returns The shared trie
+   * @throws {Error} If the file cannot be read or the format is invalid
+   */
+  openTrie(path: string, options?: TrieLoadOptions): Trie
+
+  /**
+   * Opens a double-array trie binary file shared by all the plugins and schemas in the process, the same way
+   * as `openTrie`.
+   * @param path - The path to the binary file saved by `DoubleArrayTrie.saveToBinaryFile`
+   * @param options - Options for loading the binary file, only the options of the first load take effect
+   * @returns The shared double-array trie
+   * @throws {Error} If the file cannot be read or the format is invalid
+   */
+  openDoubleArrayTrie(path: string, options?: TrieLoadOptions): DoubleArrayTrie
+
+  /**
+   * Opens an FST binary file shared by all the plugins and schemas in the process, the same way as
+   * `openTrie`.
+   * @param path - The path to the binary file saved by `Fst.saveToBinaryFile`
+   * @param options - Options for loading the binary file, only the options of the first load take effect
+   * @returns The shared FST
+   * @throws {Error} If the file cannot be read or the format is invalid
+   */
+  openFst(path: string, options?: TrieLoadOptions): Fst
+
+  /**
+   * Opens a sharded trie shared by all the plugins and schemas in the process, the same way as `openTrie`.
+   * Its shards are searched on a thread per shard, up to the hardware threads.
+   * @param path - The path to the binary file saved by `ShardedTrie.saveToBinaryFile`
+   * @param options - Options for loading the shards, only the options of the first load take effect
+   * @returns The shared sharded trie
+   * @throws {Error} If a file cannot be read or the format is invalid
+   */
+  openShardedTrie(path: string, options?: TrieLoadOptions): ShardedTrie
+
+  /**
+   * Opens a sorted text file shared by all the plugins and schemas in the process, the same way as
+   * `openTrie`. It's reloaded with its index rebuilt once the file is modified.
+   * @param path - The path to the text file sorted by the keys
+   * @param options - Options for parsing the lines, only the options of the first load take effect
+   * @returns The shared dictionary
+   * @throws {Error} If the file cannot be read or the keys are not sorted
+   */
+  openSortedTextDictionary(path: string, options?: ParseTextFileOptions): SortedTextDictionary
+
+  /**
+   * Opens a LevelDB database shared by all the plugins and schemas in the process, since a database could
+   * be opened only once at a time. It's closed when the last plugin using it is finalized, rather than
+   * by `close()` of a plugin.
+   * @param path - The path to the folder of the database
+   * @param options - Options to tune the database, only the options of the first open take effect
+   * @returns The shared database
+   * @throws {Error} If the database cannot be opened
+   */
+  openLevelDb(path: string, options?: LevelDbOptions): LevelDb
 }
 
 /**
@@ -872,6 +1512,37 @@ interface CommitHistory {
   readonly repr: string
 }
 
+/**
+ * Options to tune a LevelDb database
+ * @namespace LevelDbOptions
+ */
+interface LevelDbOptions {
+  /**
+   * The size in bytes of the LRU cache of the uncompressed blocks
+   * @default 0 - the default cache of LevelDB (8MB)
+   */
+  blockCacheSize?: number
+
+  /**
+   * The bits per key of the bloom filters, to skip reading the blocks without the key on lookups.
+   * 10 bits per key is about 1% false positives. It should be the same when the database is saved and loaded.
+   * @default 0 - no bloom filters
+   */
+  bloomFilterBitsPerKey?: number
+
+  /**
+   * Whether to compress the blocks with snappy when the database is saved
+   * @default true
+   */
+  compression?: boolean
+
+  /**
+   * Whether to cache the blocks read by the lookups and searches
+   * @default true
+   */
+  fillCache?: boolean
+}
+
 /**
  * Represents a LevelDB key-value store for dictionary data
  * @namespace LevelDb
@@ -894,16 +1565,20 @@ interface LevelDb {
   /**
    * Loads dictionary data from a binary file
    * @param path - The path to the binary file containing dictionary data
+   * @param options - Options to tune the database
    * @throws {Error} If the file cannot be read or the format is invalid
    */
-  loadBinaryFile(path: string): void
+  loadBinaryFile(path: string, options?: LevelDbOptions): void
 
   /**
-   * Saves the current dictionary data to a binary file
+   * Saves the current dictionary data to a binary file.
+   * The entries are written in the key order in bounded batches, sorted within `memoryBudget` of the
+   * parse text file options, and the database is compacted at last to be read-optimized.
    * @param path - The path where the binary file will be saved
+   * @param options - Options to tune the database, the bloom filter and the compression take effect here
    * @throws {Error} If the file cannot be written
    */
-  saveToBinaryFile(path: string): void
+  saveToBinaryFile(path: string, options?: LevelDbOptions): void
 
   /**
    * Searches for an exact match of the key in the dictionary
@@ -912,15 +1587,41 @@ interface LevelDb {
    */
   find(key: string): string | null
 
+  /**
+   * Searches for the values of the key, i.e. the values of the duplicated key concatenated with
+   * `onDuplicatedKey: 'Concat'`
+   * @param key - The string to search for
+   * @returns the values of the key, or an empty array if the key does not exist
+   */
+  findAll(key: string): string[]
+
+  /**
+   * Searches for the exact matches of a batch of keys, in one snapshot of the database
+   * @param keys - The strings to search for
+   * @param options - The threads to search with
+   * @returns the values aligned with the keys, null for the keys not in the dictionary
+   */
+  findMany(keys: string[], options?: FindManyOptions): Array<string | null>
+
   /**
    * Searches for all key-value pairs in the dictionary where the key starts with the given prefix
    * @param prefix - The prefix to search for
+   * @param options - The range of the results to return
    * @returns An array of objects containing matching key-value pairs
    */
-  prefixSearch(prefix: string): Array<{ text: string; info: string }>
+  prefixSearch(prefix: string, options?: PrefixSearchOptions): Array<{ text: string; info: string }>
+
+  /**
+   * Iterates the key-value pairs that the key starts with the given prefix lazily.
+   * The database is kept open by the iterator until it's garbage collected.
+   * @param prefix - The prefix to search for
+   * @returns An iterator of the matches, in the same order as `prefixSearch`
+   */
+  prefixIterator(prefix: string): PrefixIterator
 
   /**
-   * Closes the LevelDB database and releases resources
+   * Closes the LevelDB database and releases resources. It does nothing on a database opened with
+   * `Environment.openLevelDb`, which is still used by the other plugins.
    */
   close(): void
 }
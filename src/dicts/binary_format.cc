@@ -0,0 +1,164 @@
+#include "dicts/binary_format.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace rime {
+
+// `extraHeaderFields` are the fields appended to the header by a newer writer
+static uint32_t computeHeaderChecksum(const BinaryFileHeader& header,
+                                      std::string_view extraHeaderFields,
+                                      const std::vector<BinarySectionEntry>& sections) {
+  BinaryFileHeader copy = header;
+  copy.headerCrc32 = 0;
+  boost::crc_32_type crc;
+  crc.process_bytes(&copy, sizeof(copy));
+  crc.process_bytes(extraHeaderFields.data(), extraHeaderFields.size());
+  crc.process_bytes(sections.data(), sections.size() * sizeof(BinarySectionEntry));
+  return crc.checksum();
+}
+
+BinaryFileWriter::BinaryFileWriter(binary_format::Layout layout,
+                                   uint64_t entryCount,
+                                   uint64_t valueCount) {
+  std::memcpy(header_.magic, binary_format::MAGIC.data(), sizeof(header_.magic));
+  header_.version = binary_format::BASE_VERSION;
+  header_.endianness = binary_format::ENDIANNESS_MARK;
+  header_.layout = layout;
+  header_.headerSize = sizeof(BinaryFileHeader);
+  header_.entryCount = entryCount;
+  header_.valueCount = valueCount;
+}
+
+void BinaryFileWriter::addSection(binary_format::SectionType type,
+                                  size_t alignment,
+                                  SectionWriter writer) {
+  sections_.push_back({type, alignment, std::move(writer)});
+}
+
+void BinaryFileWriter::requireVersion(uint32_t version) {
+  header_.version = std::max(header_.version, version);
+}
+
+void BinaryFileWriter::write(std::ostream& out) const {
+  BinaryFileHeader header = header_;
+  header.sectionCount = static_cast<uint32_t>(sections_.size());
+  std::vector<BinarySectionEntry> entries(sections_.size());
+
+  // reserve the space of the header and the section table, to be filled in at last
+  const auto start = out.tellp();
+  const std::string placeholder(sizeof(header) + entries.size() * sizeof(BinarySectionEntry), '\0');
+  out.write(placeholder.data(), static_cast<std::streamsize>(placeholder.size()));
+
+  for (size_t i = 0; i < sections_.size(); ++i) {
+    const auto& section = sections_[i];
+    const auto pos = static_cast<size_t>(out.tellp() - start);
+    const size_t padding = (section.alignment - pos % section.alignment) % section.alignment;
+    const std::string zeros(padding, '\0');
+    out.write(zeros.data(), static_cast<std::streamsize>(padding));
+
+    SectionStream stream(out);
+    section.writer(stream);
+    entries[i] = {section.type, stream.checksum(), pos + padding, stream.size()};
+  }
+
+  header.headerCrc32 = computeHeaderChecksum(header, {}, entries);
+  const auto end = out.tellp();
+  out.seekp(start);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(entries.data()),
+            static_cast<std::streamsize>(entries.size() * sizeof(BinarySectionEntry)));
+  out.seekp(end);
+}
+
+void BinaryFileWriter::writeFile(const std::string& filePath) const {
+  ScopedTempFile tempFile{filePath};
+  {
+    std::ofstream file(tempFile.path(), std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Failed to open file for writing " + filePath);
+    }
+    write(file);
+    if (!file) {
+      throw std::runtime_error("Failed to write file " + filePath);
+    }
+  }
+  std::filesystem::rename(tempFile.path(), filePath);
+}
+
+bool BinaryFileReader::isBinaryFile(const void* data, size_t size) {
+  return size >= binary_format::MAGIC.size() &&
+         std::memcmp(data, binary_format::MAGIC.data(), binary_format::MAGIC.size()) == 0;
+}
+
+BinaryFileReader::BinaryFileReader(const void* data, size_t size)
+    : data_(static_cast<const char*>(data)), size_(size) {
+  if (!isBinaryFile(data, size) || size < sizeof(BinaryFileHeader)) {
+    throw std::runtime_error("Not a binary dictionary file");
+  }
+  std::memcpy(&header_, data_, sizeof(header_));
+
+  if (header_.endianness != binary_format::ENDIANNESS_MARK) {
+    throw std::runtime_error("The binary dictionary file was built on a machine of another "
+                             "endianness, please rebuild it");
+  }
+  if (header_.version > binary_format::VERSION) {
+    throw std::runtime_error("Unsupported binary dictionary file version " +
+                             std::to_string(header_.version) + ", please upgrade librime-qjs");
+  }
+  // the newer writers could only append fields to the header
+  if (header_.headerSize < sizeof(BinaryFileHeader) || header_.headerSize > size_ ||
+      header_.sectionCount > (size_ - header_.headerSize) / sizeof(BinarySectionEntry)) {
+    throw std::runtime_error("Corrupted data file");
+  }
+
+  sections_.resize(header_.sectionCount);
+  std::memcpy(sections_.data(), data_ + header_.headerSize,
+              sections_.size() * sizeof(BinarySectionEntry));
+  std::string_view extraHeaderFields(data_ + sizeof(BinaryFileHeader),
+                                     header_.headerSize - sizeof(BinaryFileHeader));
+  if (computeHeaderChecksum(header_, extraHeaderFields, sections_) != header_.headerCrc32) {
+    throw std::runtime_error("Corrupted data file: header checksum mismatch");
+  }
+
+  for (const auto& section : sections_) {
+    if (section.offset > size_ || section.size > size_ - section.offset) {
+      throw std::runtime_error("Corrupted data file: section out of bounds");
+    }
+  }
+}
+
+std::optional<std::string_view> BinaryFileReader::findSection(
+    binary_format::SectionType type) const {
+  for (const auto& section : sections_) {
+    if (section.type == type) {
+      return std::string_view(data_ + section.offset, section.size);
+    }
+  }
+  return std::nullopt;
+}
+
+std::string_view BinaryFileReader::section(binary_format::SectionType type) const {
+  auto section = findSection(type);
+  if (!section.has_value()) {
+    throw std::runtime_error("Corrupted data file: missing section " +
+                             std::to_string(static_cast<uint32_t>(type)));
+  }
+  return section.value();
+}
+
+void BinaryFileReader::verifyChecksums() const {
+  for (const auto& section : sections_) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data_ + section.offset, section.size);
+    if (crc.checksum() != section.crc32) {
+      throw std::runtime_error("Corrupted data file: checksum mismatch of section " +
+                               std::to_string(static_cast<uint32_t>(section.type)));
+    }
+  }
+}
+
+}  // namespace rime
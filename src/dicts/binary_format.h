@@ -0,0 +1,298 @@
+#pragma once
+
+#include <boost/crc.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rime {
+
+// Layout of a binary dictionary file:
+//
+//   BinaryFileHeader | BinarySectionEntry[sectionCount] | padding | section | padding | section ...
+//
+// All the integers are stored in the native byte order of the machine that wrote the file, and the
+// file is rejected on a machine of the other byte order, since the sections are mapped as-is.
+// Every section starts at an aligned offset, so that it could be accessed in place.
+namespace binary_format {
+
+constexpr std::string_view MAGIC = "RIMEDICT";
+// The newest version of the files this reader supports. A file is written with the oldest version
+// whose readers understand all its sections, so that an older reader rejects it as unsupported
+// instead of misreading it.
+constexpr uint32_t VERSION = 2;
+constexpr uint32_t BASE_VERSION = 1;
+// the deduplicated or compressed value pool, or the perfect hash index of the keys
+constexpr uint32_t VALUE_ENCODING_VERSION = 2;
+constexpr uint32_t ENDIANNESS_MARK = 0x01020304;
+
+// the alignment of the mapped sections, a multiple of the common page sizes (4K and 16K)
+constexpr size_t PAGE_ALIGNMENT = 16 * 1024;
+constexpr size_t DEFAULT_ALIGNMENT = sizeof(uint64_t);
+
+enum class Layout : std::uint32_t {
+  MarisaTrie = 1,
+  DoubleArrayTrie = 2,
+  Fst = 3,
+  SortedTextIndex = 4,
+  ShardedTrie = 5,  // the shard count of the trie files beside it
+};
+
+enum class SectionType : std::uint32_t {
+  ConcatSeparator = 1,  // the separator of the concatenated values of duplicated keys
+  ValueOffsets = 2,     // uint64_t[valueCount + 1], the offsets of the values in the value pool
+  ValuePool = 3,        // the value strings, without separators
+  MarisaTrie = 4,       // the marisa trie, in the format of marisa::Trie::write()
+  ValueItemBegins = 5,  // uint64_t[valueCount + 1], the index of the first item of each value
+  ValueItems = 6,       // ValueItem[], the items of the concatenated values
+  WeightColumn = 7,     // uint64_t column, and the delimiter of the weights in the values
+  KeyWeights = 8,       // double[valueCount], the weights of the keys in the byte order
+  KeyOrder = 9,         // uint32_t[valueCount], the key ids in the byte order of the keys
+  WeightTree = 10,      // uint32_t[valueCount], the segment tree of the heaviest keys
+  ReverseIndex = 11,    // ReverseEntry[], the value items in the byte order of their texts
+
+  // the value pool stored by `ParseTextFileOptions::deduplicateValues` and `compressValues`
+  ValueIndexes = 12,           // uint32_t[valueCount], the unique value of each key
+  ValueBlocks = 13,            // ValueBlock[blockCount + 1], the blocks of the compressed pool
+  CompressedValuePool = 14,    // the compressed blocks of the pool, instead of ValuePool
+  CompressionDictionary = 15,  // the dictionary shared by the compressed blocks
+
+  DoubleArray = 16,  // DoubleArrayUnit[], the transitions of a double-array trie
+
+  // the minimal acyclic transducer of `Fst`
+  FstStates = 17,  // FstState[stateCount], the root is the last one
+  FstArcs = 18,    // FstArc[arcCount], the arcs of each state in the ascending order of the labels
+
+  // the sparse line index of a sorted text file, cached beside it
+  SortedTextSource = 19,  // SortedTextSource, the text file and the options it's indexed with
+  SortedTextLines = 20,   // uint64_t[], the offsets of every `stride` entry lines in the text file
+
+  // the minimal perfect hash of the keys of a trie, see `ParseTextFileOptions::perfectHashIndex`
+  PerfectHashLevels = 21,  // uint64_t[levelCount + 1], the bit offsets of the levels
+  PerfectHashBits = 22,    // uint64_t[wordCount], the bits of all the levels
+  PerfectHashRanks = 23,   // uint32_t[wordCount], the set bits before each word
+  PerfectHashSlots = 24,   // PerfectHashSlot[valueCount], in the ranks of the bits of the keys
+
+  ShardCount = 25,  // uint64_t, the trie files `<path>.<index>` of a sharded trie
+};
+
+}  // namespace binary_format
+
+struct BinarySectionEntry {
+  binary_format::SectionType type;
+  uint32_t crc32;
+  uint64_t offset;  // from the beginning of the file
+  uint64_t size;
+};
+
+struct BinaryFileHeader {
+  char magic[8];  // NOLINT(modernize-avoid-c-arrays)
+  uint32_t version;
+  uint32_t endianness;
+  binary_format::Layout layout;
+  uint32_t headerSize;  // sizeof(BinaryFileHeader) of the writer, the section table follows it
+  uint32_t sectionCount;
+  uint32_t headerCrc32;  // of the header (with this field as 0) and the section table
+  uint64_t entryCount;   // number of keys
+  uint64_t valueCount;
+};
+
+// an item of a concatenated value, split by the concat separator at build time
+struct ValueItem {
+  uint32_t offset;  // from the beginning of the value
+  uint32_t length;
+};
+
+// an item of the value of a key, referred to by the reverse index instead of copying its text
+struct ReverseEntry {
+  uint32_t keyId;
+  uint32_t item;  // the index of the item in the value, 0 if the values are not concatenated
+};
+
+// a block of the compressed value pool, ended by the next one
+struct ValueBlock {
+  uint64_t begin;       // the offset of its first value in the decoded pool
+  uint64_t compressed;  // the offset of the block in the compressed pool
+};
+
+// a node of a double-array trie, whose child by the code c is the unit at `base + c` if the check
+// of that unit is the index of the node. The code of a byte b is b + 1, and the code 0 leads to the
+// terminal child of a key, whose base is the key id instead.
+struct DoubleArrayUnit {
+  uint32_t base;
+  uint32_t check;  // the index of the parent, or DOUBLE_ARRAY_FREE for an unused unit
+};
+constexpr uint32_t DOUBLE_ARRAY_FREE = 0xFFFFFFFF;
+
+// a state of a minimal acyclic transducer, shared by all the keys with the same suffixes after it
+struct FstState {
+  uint32_t firstArc;  // the index of its first arc in the arcs
+  uint16_t arcCount;
+  uint8_t final;  // 1 if a key ends at the state
+  uint8_t reserved;
+};
+
+// An arc of a minimal acyclic transducer, labeled by a byte of the keys. The id of a key, i.e. its
+// index in the byte order of the keys, is the sum of the outputs of the arcs along its path.
+struct FstArc {
+  uint32_t target;  // the index of the state it leads to
+  uint32_t output;  // the keys of its source state before the ones through it
+  uint8_t label;
+  uint8_t reserved[3];  // NOLINT(modernize-avoid-c-arrays)
+};
+
+// the text file indexed by a sparse line index, which is rebuilt if any of them changes
+struct SortedTextSource {
+  uint64_t size;
+  int64_t modifiedTime;   // in the ticks of std::filesystem::file_time_type
+  uint32_t stride;        // the entry lines per offset in the index
+  uint32_t optionsCrc32;  // of the delimiter, the comment prefix and the chars to remove
+};
+
+// the key placed at a bit of the perfect hash, with a fingerprint to reject the other keys hashed
+// to the same bit
+struct PerfectHashSlot {
+  uint32_t keyId;
+  uint32_t fingerprint;
+};
+
+static_assert(sizeof(ValueItem) == 8, "ValueItem should be packed");
+static_assert(sizeof(ReverseEntry) == 8, "ReverseEntry should be packed");
+static_assert(sizeof(ValueBlock) == 16, "ValueBlock should be packed");
+static_assert(sizeof(DoubleArrayUnit) == 8, "DoubleArrayUnit should be packed");
+static_assert(sizeof(FstState) == 8, "FstState should be packed");
+static_assert(sizeof(FstArc) == 12, "FstArc should be packed");
+static_assert(sizeof(SortedTextSource) == 24, "SortedTextSource should be packed");
+static_assert(sizeof(PerfectHashSlot) == 8, "PerfectHashSlot should be packed");
+static_assert(sizeof(BinarySectionEntry) == 24, "BinarySectionEntry should be packed");
+static_assert(sizeof(BinaryFileHeader) == 48, "BinaryFileHeader should be packed");
+
+// Writes the registered sections to a binary dictionary file, and fills in the header.
+class BinaryFileWriter {
+public:
+  // Streams the content of a section to the file, and computes its checksum on the fly
+  class SectionStream {
+    class ChecksumBuffer : public std::streambuf {
+      std::ostream& out_;
+
+    public:
+      boost::crc_32_type crc;
+      uint64_t size = 0;
+
+      explicit ChecksumBuffer(std::ostream& out) : out_(out) {}
+
+    protected:
+      int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+          return traits_type::not_eof(ch);
+        }
+        const char c = traits_type::to_char_type(ch);
+        return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+      }
+
+      std::streamsize xsputn(const char* data, std::streamsize count) override {
+        out_.write(data, count);
+        crc.process_bytes(data, static_cast<size_t>(count));
+        size += static_cast<uint64_t>(count);
+        return out_ ? count : 0;
+      }
+    };
+
+    ChecksumBuffer buffer_;
+    std::ostream stream_;
+
+  public:
+    explicit SectionStream(std::ostream& out) : buffer_(out), stream_(&buffer_) {}
+
+    [[nodiscard]] std::ostream& stream() { return stream_; }
+
+    void writeBytes(std::string_view data) {
+      stream_.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    template <typename T>
+    void writeValue(const T& value) {
+      stream_.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    [[nodiscard]] uint32_t checksum() const { return buffer_.crc.checksum(); }
+    [[nodiscard]] uint64_t size() const { return buffer_.size; }
+  };
+
+  using SectionWriter = std::function<void(SectionStream&)>;
+
+  BinaryFileWriter(binary_format::Layout layout, uint64_t entryCount, uint64_t valueCount);
+
+  void addSection(binary_format::SectionType type, size_t alignment, SectionWriter writer);
+  // raises the version of the file to the one introducing the sections added
+  void requireVersion(uint32_t version);
+
+  // writes the file, the stream should be opened in binary mode and be seekable
+  void write(std::ostream& out) const;
+  // Writes to a temporary file and renames it, so that the existing mappings of the file stay
+  // valid. Throws std::runtime_error if it fails, leaving no temporary file behind.
+  void writeFile(const std::string& filePath) const;
+
+private:
+  struct PendingSection {
+    binary_format::SectionType type;
+    size_t alignment;
+    SectionWriter writer;
+  };
+
+  BinaryFileHeader header_{};
+  std::vector<PendingSection> sections_;
+};
+
+// A temporary file next to the base path, removed when it goes out of scope unless it's renamed
+class ScopedTempFile {
+  std::filesystem::path path_;
+
+public:
+  explicit ScopedTempFile(const std::filesystem::path& base) : path_(base.string() + ".temp") {}
+  ~ScopedTempFile() {
+    std::error_code error;
+    std::filesystem::remove(path_, error);
+  }
+
+  ScopedTempFile(const ScopedTempFile&) = delete;
+  ScopedTempFile& operator=(const ScopedTempFile&) = delete;
+  ScopedTempFile(ScopedTempFile&&) = delete;
+  ScopedTempFile& operator=(ScopedTempFile&&) = delete;
+
+  [[nodiscard]] const std::filesystem::path& path() const { return path_; }
+};
+
+// Validates the header of a mapped binary dictionary file, and locates its sections.
+class BinaryFileReader {
+public:
+  // Returns false if the data does not start with the magic, i.e. it's not in this format.
+  static bool isBinaryFile(const void* data, size_t size);
+
+  // Throws std::runtime_error if the header or the section table is invalid.
+  BinaryFileReader(const void* data, size_t size);
+
+  [[nodiscard]] const BinaryFileHeader& header() const { return header_; }
+
+  [[nodiscard]] std::optional<std::string_view> findSection(
+      binary_format::SectionType type) const;
+  // Throws std::runtime_error if the section is missing.
+  [[nodiscard]] std::string_view section(binary_format::SectionType type) const;
+
+  // Throws std::runtime_error if the checksum of any section mismatches.
+  void verifyChecksums() const;
+
+private:
+  const char* data_;
+  size_t size_;
+  BinaryFileHeader header_{};
+  std::vector<BinarySectionEntry> sections_;
+};
+
+}  // namespace rime
@@ -0,0 +1,231 @@
+#include "dicts/block_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+namespace rime {
+
+// the shortest match worth a token, also the bytes hashed to find the matches
+constexpr size_t MIN_MATCH = 4;
+constexpr int HASH_BITS = 14;
+constexpr size_t HASH_SIZE = size_t{1} << HASH_BITS;
+// the candidates of a hash to compare, trading the compression ratio for the build time
+constexpr size_t MAX_CHAIN = 16;
+
+// the substrings counted to train a dictionary, and the segments of the samples picked into it
+constexpr size_t KMER_LENGTH = 8;
+constexpr size_t SEGMENT_LENGTH = 64;
+constexpr int KMER_COUNT_BITS = 20;
+
+static uint32_t hashBytes(const char* data, size_t length, int bits) {
+  uint64_t value = 0;
+  std::memcpy(&value, data, length);
+  return static_cast<uint32_t>((value * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static void writeVarint(std::string& out, uint64_t value) {
+  constexpr uint64_t MORE = 0x80;
+  while (value >= MORE) {
+    out.push_back(static_cast<char>((value & (MORE - 1)) | MORE));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+static uint64_t readVarint(std::string_view data, size_t& pos) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (pos >= data.size()) {
+      break;
+    }
+    const auto byte = static_cast<unsigned char>(data[pos++]);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Corrupted data file");
+}
+
+static size_t matchLength(std::string_view source, std::string_view target) {
+  const size_t limit = std::min(source.size(), target.size());
+  size_t length = 0;
+  while (length < limit && source[length] == target[length]) {
+    ++length;
+  }
+  return length;
+}
+
+std::string block_codec::trainDictionary(const std::vector<std::string_view>& samples,
+                                         size_t capacity) {
+  std::string text;
+  for (const auto& sample : samples) {
+    text.append(sample);
+  }
+  if (text.size() < KMER_LENGTH || capacity == 0) {
+    return {};
+  }
+
+  std::vector<uint32_t> counts(size_t{1} << KMER_COUNT_BITS, 0);
+  for (size_t i = 0; i + KMER_LENGTH <= text.size(); ++i) {
+    ++counts[hashBytes(text.data() + i, KMER_LENGTH, KMER_COUNT_BITS)];
+  }
+  // the substrings repeated in the samples, which are not picked yet
+  const auto score = [&](size_t begin) {
+    const size_t end = std::min(begin + SEGMENT_LENGTH, text.size());
+    uint64_t result = 0;
+    for (size_t i = begin; i + KMER_LENGTH <= end; ++i) {
+      const uint32_t count = counts[hashBytes(text.data() + i, KMER_LENGTH, KMER_COUNT_BITS)];
+      result += count > 1 ? count : 0;
+    }
+    return result;
+  };
+
+  // the scores only drop as the segments are picked, so a popped segment is picked if its score
+  // is still the highest, or pushed back with the lower score
+  std::priority_queue<std::pair<uint64_t, size_t>> queue;
+  for (size_t begin = 0; begin < text.size(); begin += SEGMENT_LENGTH) {
+    queue.emplace(score(begin), begin);
+  }
+  std::vector<size_t> picked;
+  size_t pickedSize = 0;
+  while (!queue.empty() && pickedSize < capacity) {
+    const size_t begin = queue.top().second;
+    queue.pop();
+    const uint64_t current = score(begin);
+    if (current == 0) {
+      continue;
+    }
+    if (!queue.empty() && current < queue.top().first) {
+      queue.emplace(current, begin);
+      continue;
+    }
+    picked.push_back(begin);
+    const size_t end = std::min(begin + SEGMENT_LENGTH, text.size());
+    pickedSize += end - begin;
+    for (size_t i = begin; i + KMER_LENGTH <= end; ++i) {
+      counts[hashBytes(text.data() + i, KMER_LENGTH, KMER_COUNT_BITS)] = 0;
+    }
+  }
+
+  std::string dictionary;
+  for (auto it = picked.rbegin(); it != picked.rend(); ++it) {
+    dictionary.append(text, *it, SEGMENT_LENGTH);
+  }
+  if (dictionary.size() > capacity) {
+    dictionary.erase(0, dictionary.size() - capacity);
+  }
+  return dictionary;
+}
+
+void block_codec::decompress(std::string_view compressed,
+                             std::string_view dictionary,
+                             size_t size,
+                             std::string& out) {
+  out.clear();
+  out.reserve(size);  // not to be reallocated while copying the matches from itself
+  size_t pos = 0;
+  while (true) {
+    const uint64_t literals = readVarint(compressed, pos);
+    if (literals > compressed.size() - pos || literals > size - out.size()) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    out.append(compressed.substr(pos, literals));
+    pos += literals;
+    if (out.size() == size) {
+      break;
+    }
+
+    const uint64_t length = readVarint(compressed, pos) + MIN_MATCH;
+    const uint64_t distance = readVarint(compressed, pos);
+    if (distance == 0 || distance > out.size() + dictionary.size() ||
+        length > size - out.size()) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    for (uint64_t remaining = length; remaining > 0;) {
+      const size_t current = out.size();
+      if (distance > current) {  // into the end of the dictionary
+        const size_t count = std::min<uint64_t>(remaining, distance - current);
+        out.append(dictionary.substr(dictionary.size() - (distance - current), count));
+        remaining -= count;
+      } else {  // the overlapped bytes repeat, so copy up to `distance` bytes at a time
+        const size_t count = std::min<uint64_t>(remaining, distance);
+        out.append(out.data() + current - distance, count);
+        remaining -= count;
+      }
+    }
+  }
+  if (pos != compressed.size()) {
+    throw std::runtime_error("Corrupted data file");
+  }
+}
+
+BlockCompressor::BlockCompressor(std::string_view dictionary)
+    : dictionary_(dictionary),
+      dictionaryHeads_(HASH_SIZE, NO_POSITION),
+      dictionaryChain_(dictionary.size(), NO_POSITION) {
+  for (size_t pos = 0; pos + MIN_MATCH <= dictionary_.size(); ++pos) {
+    const uint32_t hash = hashBytes(dictionary_.data() + pos, MIN_MATCH, HASH_BITS);
+    dictionaryChain_[pos] = dictionaryHeads_[hash];
+    dictionaryHeads_[hash] = static_cast<int32_t>(pos);
+  }
+}
+
+void BlockCompressor::compress(std::string_view block, std::string& out) {
+  heads_.assign(HASH_SIZE, NO_POSITION);
+  chain_.assign(block.size(), NO_POSITION);
+  const auto insert = [&](size_t pos, uint32_t hash) {
+    chain_[pos] = heads_[hash];
+    heads_[hash] = static_cast<int32_t>(pos);
+  };
+
+  size_t literalBegin = 0;
+  size_t pos = 0;
+  while (pos + MIN_MATCH <= block.size()) {
+    const uint32_t hash = hashBytes(block.data() + pos, MIN_MATCH, HASH_BITS);
+    const auto target = block.substr(pos);
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+    size_t depth = 0;
+    for (int32_t candidate = heads_[hash]; candidate != NO_POSITION && depth < MAX_CHAIN;
+         candidate = chain_[candidate], ++depth) {
+      const size_t length = matchLength(block.substr(candidate), target);
+      if (length > bestLength) {
+        bestLength = length;
+        bestDistance = pos - candidate;
+      }
+    }
+    depth = 0;
+    for (int32_t candidate = dictionaryHeads_[hash]; candidate != NO_POSITION && depth < MAX_CHAIN;
+         candidate = dictionaryChain_[candidate], ++depth) {
+      const size_t length = matchLength(dictionary_.substr(candidate), target);
+      if (length > bestLength) {
+        bestLength = length;
+        bestDistance = pos + dictionary_.size() - candidate;
+      }
+    }
+
+    if (bestLength < MIN_MATCH) {
+      insert(pos, hash);
+      ++pos;
+      continue;
+    }
+    writeVarint(out, pos - literalBegin);
+    out.append(block.substr(literalBegin, pos - literalBegin));
+    writeVarint(out, bestLength - MIN_MATCH);
+    writeVarint(out, bestDistance);
+    for (const size_t end = pos + bestLength; pos < end; ++pos) {
+      if (pos + MIN_MATCH <= block.size()) {
+        insert(pos, hashBytes(block.data() + pos, MIN_MATCH, HASH_BITS));
+      }
+    }
+    literalBegin = pos;
+  }
+  writeVarint(out, block.size() - literalBegin);
+  out.append(block.substr(literalBegin));
+}
+
+}  // namespace rime
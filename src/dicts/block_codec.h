@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rime {
+
+// A byte-oriented LZ77 codec for the small blocks of a value pool, which are decoded on demand.
+// A block alone is too small to repeat much of itself, so the matches could also refer to a
+// dictionary shared by all the blocks, as if it preceded every block. The dictionary is trained
+// from the most repeated segments of the values, e.g. the common words of the definitions.
+//
+// A compressed block is a sequence of the literal runs each followed by a match:
+//
+//   varint literalLength | literals | varint (matchLength - MIN_MATCH) | varint distance ...
+//
+// where the last literal run ends the block without a match, and the distance counts back from
+// the current position into the block and then into the end of the dictionary.
+namespace block_codec {
+
+// Returns a dictionary of at most `capacity` bytes, made of the segments of the samples with the
+// most repeated substrings, the most useful ones at the end to be referred to by shorter distances.
+std::string trainDictionary(const std::vector<std::string_view>& samples, size_t capacity);
+
+// Decodes a block of `size` bytes compressed with the dictionary into `out`.
+// Throws std::runtime_error if the compressed block is corrupted.
+void decompress(std::string_view compressed,
+                std::string_view dictionary,
+                size_t size,
+                std::string& out);
+
+}  // namespace block_codec
+
+// Compresses the blocks with a dictionary, whose matches are indexed once for all the blocks.
+class BlockCompressor {
+public:
+  // the dictionary should outlive the compressor
+  explicit BlockCompressor(std::string_view dictionary);
+
+  // Appends the compressed block to `out`.
+  void compress(std::string_view block, std::string& out);
+
+private:
+  // the previous position with the same hash, or NO_POSITION
+  static constexpr int32_t NO_POSITION = -1;
+
+  std::string_view dictionary_;
+  std::vector<int32_t> dictionaryHeads_;  // the last position of each hash in the dictionary
+  std::vector<int32_t> dictionaryChain_;
+  std::vector<int32_t> heads_;  // of the current block
+  std::vector<int32_t> chain_;
+};
+
+}  // namespace rime
@@ -1,74 +1,204 @@
 #include "dictionary.h"
 
 #include <algorithm>
-#include <fstream>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <filesystem>
+#include <future>
+
+#include "dicts/external_sorter.h"
+#include "dicts/text_scanner.h"
+#include "thread_pool.hpp"
+
+// the chunks smaller than this are not worth a thread
+constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+// maps a text file to be scanned, a missing or empty file is read as an empty text
+class MappedTextFile {
+  boost::interprocess::file_mapping mapping_;
+  boost::interprocess::mapped_region region_;
+  std::string_view text_;
+
+public:
+  explicit MappedTextFile(const std::string& path) {
+    std::error_code ec;
+    const auto fileSize = std::filesystem::file_size(path, ec);
+    if (ec || fileSize == 0) {
+      return;
+    }
+    mapping_ = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only);
+    region_ = boost::interprocess::mapped_region(mapping_, boost::interprocess::read_only);
+    region_.advise(boost::interprocess::mapped_region::advice_sequential);
+    text_ = std::string_view(static_cast<const char*>(region_.get_address()), region_.get_size());
+  }
+
+  [[nodiscard]] std::string_view text() const { return text_; }
+};
 
 std::unordered_map<std::string, std::string> Dictionary::parseTextFile(
     const std::string& path,
     const ParseTextFileOptions& options) {
-  std::unordered_map<std::string, std::string> ret(options.lines);
-  std::ifstream infile(path);
-  std::string line;
-  while (std::getline(infile, line)) {
-    if (!line.empty() && line.find(options.comment) == 0) {
-      continue;
-    }
+  MappedTextFile file(path);
+  const std::string_view text = file.text();
+  if (text.empty()) {
+    return {};
+  }
+
+  const size_t threads = ThreadPool::resolveThreadCount(options.threads);
+  const size_t chunkCount = std::clamp<size_t>(text.size() / MIN_CHUNK_SIZE, 1, threads);
+  if (chunkCount == 1) {
+    return parseChunk(text, options, options.lines);
+  }
+  return parseChunksInParallel(text, options, chunkCount);
+}
 
-    if (!options.charsToRemove.empty()) {
-      removeChars(line, options.charsToRemove);
+size_t Dictionary::parseSortedTextFile(const std::string& path,
+                                     const ParseTextFileOptions& options,
+                                     const std::string& tempPathPrefix,
+                                     const EntryVisitor& visitor) {
+  MappedTextFile file(path);
+  ExternalSorter sorter(options, tempPathPrefix);
+  const ByteSetScanner charsToRemove(options.charsToRemove);
+  TextLineScanner scanner(file.text(), options.delimiter, charsToRemove);
+  TextLine line;
+  std::string buffer;
+  std::string key;
+  std::string value;
+  while (scanner.next(line)) {
+    if (parseLine(line, options, charsToRemove, buffer, key, value)) {
+      sorter.add(std::move(key), std::move(value));
     }
+  }
+  sorter.finish(visitor);
+  return sorter.spilledRuns();
+}
 
-    size_t tabPos = line.find(options.delimiter);
-    if (tabPos == std::string::npos) {
+std::unordered_map<std::string, std::string> Dictionary::parseChunk(
+    std::string_view text,
+    const ParseTextFileOptions& options,
+    size_t expectedLines) {
+  std::unordered_map<std::string, std::string> map(expectedLines);
+  const ByteSetScanner charsToRemove(options.charsToRemove);
+  TextLineScanner scanner(text, options.delimiter, charsToRemove);
+  TextLine line;
+  std::string buffer;
+  std::string key;
+  std::string value;
+  while (scanner.next(line)) {
+    if (!parseLine(line, options, charsToRemove, buffer, key, value)) {
       continue;
     }
+    auto [it, inserted] = map.try_emplace(std::move(key));
+    if (inserted) {
+      it->second = std::move(value);
+    } else {
+      mergeDuplicatedValue(it->second, std::move(value), options);
+    }
+  }
+  return map;
+}
 
-    std::string key = line.substr(0, tabPos);
-    std::string value = line.substr(tabPos + 1);
+bool Dictionary::parseLine(const TextLine& line,
+                           const ParseTextFileOptions& options,
+                           const ByteSetScanner& charsToRemove,
+                           std::string& buffer,
+                           std::string& key,
+                           std::string& value) {
+  std::string_view text = line.text;
+  if (!text.empty() && text.substr(0, options.comment.size()) == options.comment) {
+    return false;
+  }
 
-    if (options.isReversed) {
-      std::swap(key, value);
-    }
+  // Removing the chars does not move the delimiter found by the scanner, unless the delimiter is
+  // made of several chars or is one of the chars to remove, then remove them from a copy first.
+  const bool removeFromCopy =
+      line.hasCharsToRemove &&
+      (options.delimiter.size() != 1 || charsToRemove.contains(options.delimiter.front()));
+  size_t delimiterPos = line.delimiterPos;
+  if (removeFromCopy || options.delimiter.empty()) {
+    buffer.assign(text);
+    removeChars(buffer, charsToRemove);
+    text = buffer;
+    delimiterPos = text.find(options.delimiter);
+  }
+  if (delimiterPos == std::string_view::npos) {
+    return false;
+  }
 
-    if (options.onDuplicatedKey != OnDuplicatedKey::Overwrite) {
-      auto it = ret.find(key);
-      if (it != ret.end()) {
-        if (options.onDuplicatedKey == OnDuplicatedKey::Skip) {
-          continue;
-        }
-        if (options.onDuplicatedKey == OnDuplicatedKey::Concat) {
-          value = ret[key].append(options.concatSeparator).append(value);
-        }
-      }
-    }
+  key.assign(text.substr(0, delimiterPos));
+  value.assign(text.substr(std::min(delimiterPos + 1, text.size())));
+  if (line.hasCharsToRemove && !removeFromCopy) {
+    removeChars(key, charsToRemove);
+    removeChars(value, charsToRemove);
+  }
 
-    ret[key] = value;
+  if (options.isReversed) {
+    std::swap(key, value);
   }
-  return ret;
+  return true;
 }
 
-std::vector<std::string> Dictionary::split(const std::string& str, const std::string& delimiters) {
-  std::vector<std::string> tokens;
-  size_t start = 0;
-  size_t end = 0;
+void Dictionary::mergeDuplicatedValue(std::string& existing,
+                                      std::string&& later,
+                                      const ParseTextFileOptions& options) {
+  if (options.onDuplicatedKey == OnDuplicatedKey::Overwrite) {
+    existing = std::move(later);
+  } else if (options.onDuplicatedKey == OnDuplicatedKey::Concat) {
+    existing.append(options.concatSeparator).append(later);
+  }  // else skip the later one
+}
+
+std::unordered_map<std::string, std::string> Dictionary::parseChunksInParallel(
+    std::string_view text,
+    const ParseTextFileOptions& options,
+    size_t chunkCount) {
+  // split the text at the line breaks, into chunks of about the same size
+  std::vector<std::string_view> chunks;
+  size_t chunkStart = 0;
+  for (size_t i = 1; i <= chunkCount && chunkStart < text.size(); ++i) {
+    size_t chunkEnd = i == chunkCount ? text.size() : text.size() / chunkCount * i;
+    if (chunkEnd < chunkStart) {
+      chunkEnd = chunkStart;
+    }
+    chunkEnd = text.find('\n', chunkEnd);
+    chunkEnd = chunkEnd == std::string_view::npos ? text.size() : chunkEnd + 1;
+    chunks.push_back(text.substr(chunkStart, chunkEnd - chunkStart));
+    chunkStart = chunkEnd;
+  }
 
-  while ((end = str.find_first_of(delimiters, start)) != std::string::npos) {
-    if (end != start) {  // Avoid empty tokens
-      tokens.push_back(str.substr(start, end - start));
+  std::vector<std::future<std::unordered_map<std::string, std::string>>> futures;
+  {
+    ThreadPool pool(chunks.size());
+    for (const auto& chunk : chunks) {
+      futures.push_back(pool.submit([&options, chunk, lines = options.lines / chunks.size()] {
+        return parseChunk(chunk, options, lines);
+      }));
     }
-    start = end + 1;
   }
 
-  if (start < str.length()) {
-    tokens.push_back(str.substr(start));
+  // merge in the order of the chunks, to keep the file order of the duplicated keys
+  auto ret = futures.front().get();
+  ret.reserve(options.lines);
+  for (size_t i = 1; i < futures.size(); ++i) {
+    mergeChunk(ret, futures[i].get(), options);
   }
+  return ret;
+}
 
-  return tokens;
+void Dictionary::mergeChunk(std::unordered_map<std::string, std::string>& target,
+                            std::unordered_map<std::string, std::string>&& chunk,
+                            const ParseTextFileOptions& options) {
+  while (!chunk.empty()) {
+    auto node = chunk.extract(chunk.begin());
+    auto result = target.insert(std::move(node));
+    if (!result.inserted) {
+      mergeDuplicatedValue(result.position->second, std::move(result.node.mapped()), options);
+    }
+  }
 }
 
-void Dictionary::removeChars(std::string& str, const std::string& charsToRemove) {
-  str.erase(std::remove_if(
-                str.begin(), str.end(),
-                [&charsToRemove](char c) { return charsToRemove.find(c) != std::string::npos; }),
+void Dictionary::removeChars(std::string& str, const ByteSetScanner& charsToRemove) {
+  str.erase(std::remove_if(str.begin(), str.end(),
+                           [&charsToRemove](char c) { return charsToRemove.contains(c); }),
             str.end());
 }
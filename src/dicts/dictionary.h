@@ -1,11 +1,16 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+class ByteSetScanner;
+struct TextLine;
+
 constexpr const char* MAGIC_KEY_TO_STORE_CONCAT_SEPARATOR = "MAGIC_KEY_TO_STORE_CONCAT_SEPARATOR";
 
 enum class OnDuplicatedKey : std::uint8_t {
@@ -22,6 +27,36 @@ struct ParseTextFileOptions {
   std::string charsToRemove = "\r";
   OnDuplicatedKey onDuplicatedKey = OnDuplicatedKey::Overwrite;
   std::string concatSeparator = "$|$";
+  // the number of threads to parse the file in chunks, 0 to use all the hardware threads
+  size_t threads = 1;
+  // the memory in bytes to keep the entries when building a dictionary file in the key order, the
+  // entries beyond it are spilled to temporary files next to the built file. 0 for no limit, or for
+  // `LevelDb::DEFAULT_MEMORY_BUDGET` when building a LevelDb.
+  size_t memoryBudget = 0;
+  // the column of the value split by the delimiter, counted from 1, holding the numeric weight of
+  // the key to search the top completions of a prefix. 0 for no weights.
+  size_t weightColumn = 0;
+  // whether to index the value items to look up the keys by them, in the same file as the keys
+  bool reverseIndex = false;
+  // whether to index the keys by a minimal perfect hash in the binary file of a trie, to find the
+  // keys in O(1) without walking the trie, at about 9 bytes per key
+  bool perfectHashIndex = false;
+  // whether to store the identical values once in the binary file of a trie, e.g. the same
+  // definitions of many keys
+  bool deduplicateValues = false;
+  // whether to compress the values in the binary file of a trie, in small blocks with a dictionary
+  // trained from the values, to be decoded on demand, see `TrieLoadOptions::cachedValueBlocks`
+  bool compressValues = false;
+};
+
+struct PrefixSearchOptions {
+  size_t limit = 0;   // the maximum number of the results, 0 for no limit
+  size_t offset = 0;  // the number of the results to skip
+};
+
+struct FindManyOptions {
+  // the number of threads to look up a large batch of keys, 0 to use all the hardware threads
+  size_t threads = 1;
 };
 
 class Dictionary {
@@ -32,6 +67,11 @@ public:
   virtual void loadBinaryFile(const std::string& filePath) = 0;
   virtual void saveToBinaryFile(const std::string& filePath) = 0;
   [[nodiscard]] virtual std::optional<std::string> find(const std::string& key) const = 0;
+  // Returns the values of the key, i.e. the items of the concatenated values of a duplicated key.
+  [[nodiscard]] virtual std::vector<std::string> findAll(const std::string& key) const = 0;
+  // Looks up a batch of keys, the results are aligned with the keys.
+  [[nodiscard]] virtual std::vector<std::optional<std::string>> findMany(
+      const std::vector<std::string>& keys) const = 0;
   [[nodiscard]] virtual std::vector<std::pair<std::string, std::string>> prefixSearch(
       const std::string& prefix) const = 0;
 
@@ -39,9 +79,65 @@ public:
       const std::string& path,
       const ParseTextFileOptions& options);
 
+  using EntryVisitor = std::function<void(const std::string& key, const std::string& value)>;
+
+  // Visits the entries of the text file in the byte order of the keys, with the duplicated keys
+  // merged. The memory is bounded by `options.memoryBudget`, the sorted runs beyond it are spilled
+  // to the files starting with `tempPathPrefix`, which are removed before it returns. Returns the
+  // number of the spilled runs.
+  static size_t parseSortedTextFile(const std::string& path,
+                                  const ParseTextFileOptions& options,
+                                  const std::string& tempPathPrefix,
+                                  const EntryVisitor& visitor);
+
+  // merges the value of a later line of a duplicated key, following the `onDuplicatedKey` policy
+  static void mergeDuplicatedValue(std::string& existing,
+                                   std::string&& later,
+                                   const ParseTextFileOptions& options);
+
+  // Visits the non-empty items of a value concatenated with the separator, or the value itself if
+  // the separator is empty.
+  template <typename Visitor>
+  static void forEachItem(std::string_view value, std::string_view separator, Visitor&& visitor) {
+    if (separator.empty()) {
+      visitor(value);
+      return;
+    }
+    size_t start = 0;
+    size_t end = 0;
+    while ((end = value.find(separator, start)) != std::string_view::npos) {
+      if (end != start) {
+        visitor(value.substr(start, end - start));
+      }
+      start = end + separator.length();
+    }
+    if (start < value.length()) {
+      visitor(value.substr(start));
+    }
+  }
+
 protected:
-  static std::vector<std::string> split(const std::string& str, const std::string& delimiters);
+  // returns false if the line is a comment or has no delimiter
+  static bool parseLine(const TextLine& line,
+                        const ParseTextFileOptions& options,
+                        const ByteSetScanner& charsToRemove,
+                        std::string& buffer,
+                        std::string& key,
+                        std::string& value);
 
 private:
-  static void removeChars(std::string& str, const std::string& charsToRemove);
+  static void removeChars(std::string& str, const ByteSetScanner& charsToRemove);
+
+  static std::unordered_map<std::string, std::string> parseChunk(
+      std::string_view text,
+      const ParseTextFileOptions& options,
+      size_t expectedLines);
+  static std::unordered_map<std::string, std::string> parseChunksInParallel(
+      std::string_view text,
+      const ParseTextFileOptions& options,
+      size_t chunkCount);
+  // merges a map parsed from a later chunk of the file, following the `onDuplicatedKey` policy
+  static void mergeChunk(std::unordered_map<std::string, std::string>& target,
+                         std::unordered_map<std::string, std::string>&& chunk,
+                         const ParseTextFileOptions& options);
 };
@@ -0,0 +1,108 @@
+#include "dicts/dictionary_registry.h"
+
+#include <iterator>
+#include <stdexcept>
+
+std::shared_ptr<rime::Trie> DictionaryRegistry::openTrie(const std::string& path,
+                                                         const rime::TrieLoadOptions& options) {
+  return open<rime::Trie>("trie", path, true, [&](const std::string& canonicalPath) {
+    auto trie = std::make_shared<rime::Trie>();
+    trie->loadBinaryFile(canonicalPath, options);
+    return trie;
+  });
+}
+
+std::shared_ptr<rime::DoubleArrayTrie> DictionaryRegistry::openDoubleArrayTrie(
+    const std::string& path,
+    const rime::TrieLoadOptions& options) {
+  return open<rime::DoubleArrayTrie>(
+      "double-array-trie", path, true, [&](const std::string& canonicalPath) {
+        auto trie = std::make_shared<rime::DoubleArrayTrie>();
+        trie->loadBinaryFile(canonicalPath, options);
+        return trie;
+      });
+}
+
+std::shared_ptr<rime::Fst> DictionaryRegistry::openFst(const std::string& path,
+                                                       const rime::TrieLoadOptions& options) {
+  return open<rime::Fst>("fst", path, true, [&](const std::string& canonicalPath) {
+    auto fst = std::make_shared<rime::Fst>();
+    fst->loadBinaryFile(canonicalPath, options);
+    return fst;
+  });
+}
+
+std::shared_ptr<rime::ShardedTrie> DictionaryRegistry::openShardedTrie(
+    const std::string& path,
+    const rime::TrieLoadOptions& options) {
+  return open<rime::ShardedTrie>("sharded-trie", path, true, [&](const std::string& canonicalPath) {
+    auto trie = std::make_shared<rime::ShardedTrie>();
+    trie->loadBinaryFile(canonicalPath, options);
+    return trie;
+  });
+}
+
+std::shared_ptr<rime::SortedTextDictionary> DictionaryRegistry::openSortedTextDictionary(
+    const std::string& path,
+    const ParseTextFileOptions& options) {
+  return open<rime::SortedTextDictionary>(
+      "sorted-text", path, true, [&](const std::string& canonicalPath) {
+        auto dictionary = std::make_shared<rime::SortedTextDictionary>();
+        dictionary->loadTextFile(canonicalPath, options);
+        return dictionary;
+      });
+}
+
+std::shared_ptr<LevelDb> DictionaryRegistry::openLevelDb(const std::string& path,
+                                                         const LevelDbOptions& options) {
+  // the files in the folder are modified by leveldb itself, and it could not be reopened anyway
+  return open<LevelDb>("leveldb", path, false, [&](const std::string& canonicalPath) {
+    auto db = std::make_shared<LevelDb>();
+    db->loadBinaryFile(canonicalPath, options);
+    if (!db->isLoaded()) {
+      throw std::runtime_error("Failed to open LevelDb " + canonicalPath);
+    }
+    db->markShared();
+    return db;
+  });
+}
+
+size_t DictionaryRegistry::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (const auto& [key, entry] : entries_) {
+    count += entry.dictionary.expired() ? 0 : 1;
+  }
+  return count;
+}
+
+template <typename T, typename Loader>
+std::shared_ptr<T> DictionaryRegistry::open(const std::string& kind,
+                                            const std::string& path,
+                                            bool reloadIfModified,
+                                            const Loader& load) {
+  std::error_code error;
+  const auto canonicalPath = std::filesystem::canonical(path, error).string();
+  if (error) {
+    throw std::runtime_error("Failed to open dictionary " + path + ": " + error.message());
+  }
+  const auto modified = std::filesystem::last_write_time(canonicalPath, error);
+
+  // loads under the lock, so that the users opening the same file at once share one load
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    it = it->second.dictionary.expired() ? entries_.erase(it) : std::next(it);
+  }
+
+  const auto key = kind + ":" + canonicalPath;
+  auto it = entries_.find(key);
+  if (it != entries_.end() && (!reloadIfModified || it->second.modified == modified)) {
+    if (auto dictionary = it->second.dictionary.lock()) {
+      return std::static_pointer_cast<T>(dictionary);
+    }
+  }
+
+  std::shared_ptr<T> dictionary = load(canonicalPath);
+  entries_.insert_or_assign(key, Entry{modified, dictionary});
+  return dictionary;
+}
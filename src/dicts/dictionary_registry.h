@@ -0,0 +1,67 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "dicts/double_array_trie.h"
+#include "dicts/fst.h"
+#include "dicts/leveldb.h"
+#include "dicts/sharded_trie.h"
+#include "dicts/sorted_text_dictionary.h"
+#include "dicts/trie.h"
+
+// Shares the dictionaries loaded from the same path between the plugins of all the schemas, so
+// that a file is loaded once per process, and released when the last user drops it. A shared
+// dictionary should not be added to, as the other users would see the added keys too.
+class DictionaryRegistry {
+public:
+  static DictionaryRegistry& instance() {
+    static DictionaryRegistry instance;
+    return instance;
+  }
+
+  // Returns the trie loaded from the binary file, or loads it if it's not loaded, or if the file
+  // has been modified since it was loaded. The options of the first load are kept until then.
+  std::shared_ptr<rime::Trie> openTrie(const std::string& path,
+                                       const rime::TrieLoadOptions& options = {});
+  // the same as `openTrie`, but for the binary file of a double-array trie
+  std::shared_ptr<rime::DoubleArrayTrie> openDoubleArrayTrie(
+      const std::string& path,
+      const rime::TrieLoadOptions& options = {});
+  // the same as `openTrie`, but for the binary file of an FST
+  std::shared_ptr<rime::Fst> openFst(const std::string& path,
+                                     const rime::TrieLoadOptions& options = {});
+  // the same as `openTrie`, but for the file of a sharded trie, searched on a thread per shard
+  std::shared_ptr<rime::ShardedTrie> openShardedTrie(const std::string& path,
+                                                     const rime::TrieLoadOptions& options = {});
+  // the same as `openTrie`, but for a sorted text file, which is reloaded with its index rebuilt
+  // once it's modified
+  std::shared_ptr<rime::SortedTextDictionary> openSortedTextDictionary(
+      const std::string& path,
+      const ParseTextFileOptions& options = {});
+  // Returns the database opened at the folder, or opens it if it's not opened. A database could
+  // be opened only once in a process, for the lock of its folder.
+  std::shared_ptr<LevelDb> openLevelDb(const std::string& path,
+                                       const LevelDbOptions& options = {});
+
+  // the number of the dictionaries still in use
+  [[nodiscard]] size_t size();
+
+private:
+  struct Entry {
+    std::filesystem::file_time_type modified;
+    std::weak_ptr<void> dictionary;
+  };
+
+  template <typename T, typename Loader>
+  std::shared_ptr<T> open(const std::string& kind,
+                          const std::string& path,
+                          bool reloadIfModified,
+                          const Loader& load);
+
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;  // by the kind and the canonical path
+};
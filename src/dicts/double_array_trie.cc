@@ -0,0 +1,411 @@
+#include "dicts/double_array_trie.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace rime {
+
+// the code of the terminal child of a key, the code of a byte b is b + 1
+constexpr uint32_t END_CODE = 0;
+constexpr uint32_t MAX_CODE = 256;
+// the failed attempts to place the children of a node from a free unit before it's no longer tried,
+// so that the crowded head of the array is not scanned again for every node
+constexpr uint8_t MAX_TRIALS = 16;
+constexpr uint32_t NO_UNIT = std::numeric_limits<uint32_t>::max();
+
+static uint32_t codeAt(std::string_view key, size_t depth) {
+  return depth < key.length() ? static_cast<unsigned char>(key[depth]) + 1 : END_CODE;
+}
+
+// Builds the array from the sorted unique keys, placing the children of a node at the first base
+// where all of them fit in the free units, which are linked in a list to be tried in order.
+class DoubleArrayBuilder {
+public:
+  explicit DoubleArrayBuilder(const std::vector<std::string_view>& keys) : keys_(keys) {}
+
+  std::vector<DoubleArrayUnit> build() {
+    // the root is not linked as a free unit, and no child is placed at it as the bases start at 1
+    units_.assign(1, {0, DOUBLE_ARRAY_FREE});
+    nextFree_.assign(1, NO_UNIT);
+    prevFree_.assign(1, NO_UNIT);
+    trials_.assign(1, MAX_TRIALS);
+    if (keys_.empty()) {
+      return std::move(units_);
+    }
+
+    // the keys in [begin, end) share the first `depth` bytes, which lead to the node
+    struct Pending {
+      uint32_t node;
+      size_t begin;
+      size_t end;
+      size_t depth;
+    };
+    std::vector<Pending> pending{{0, 0, keys_.size(), 0}};
+    std::vector<uint32_t> codes;
+    std::vector<size_t> begins;  // of the keys of each child, and the end
+    while (!pending.empty()) {
+      const Pending current = pending.back();
+      pending.pop_back();
+      codes.clear();
+      begins.clear();
+      for (size_t i = current.begin; i < current.end; ++i) {
+        const uint32_t code = codeAt(keys_[i], current.depth);
+        if (codes.empty() || codes.back() != code) {
+          codes.push_back(code);
+          begins.push_back(i);
+        }
+      }
+      begins.push_back(current.end);
+
+      const uint32_t base = findBase(codes);
+      grow(static_cast<size_t>(base) + codes.back() + 1);
+      units_[current.node].base = base;
+      for (size_t i = 0; i < codes.size(); ++i) {
+        const uint32_t child = base + codes[i];
+        occupy(child, current.node);
+        if (codes[i] == END_CODE) {
+          units_[child].base = static_cast<uint32_t>(begins[i]);  // the key id
+        } else {
+          pending.push_back({child, begins[i], begins[i + 1], current.depth + 1});
+        }
+      }
+    }
+
+    // the free units at the end are never reached
+    while (units_.back().check == DOUBLE_ARRAY_FREE && units_.size() > 1) {
+      units_.pop_back();
+    }
+    return std::move(units_);
+  }
+
+private:
+  // the free units are tried from the head, the new ones are appended to the tail
+  [[nodiscard]] bool isListed(uint32_t unit) const { return trials_[unit] < MAX_TRIALS; }
+
+  void unlink(uint32_t unit) {
+    (prevFree_[unit] != NO_UNIT ? nextFree_[prevFree_[unit]] : head_) = nextFree_[unit];
+    (nextFree_[unit] != NO_UNIT ? prevFree_[nextFree_[unit]] : tail_) = prevFree_[unit];
+    trials_[unit] = MAX_TRIALS;
+  }
+
+  // extends the array to at least `size` units, the new units are free
+  void grow(size_t size) {
+    const size_t oldSize = units_.size();
+    if (size <= oldSize) {
+      return;
+    }
+    size = std::max(size, oldSize + oldSize / 2);
+    if (size + MAX_CODE >= NO_UNIT) {
+      throw std::runtime_error("Too many keys for a double-array trie");
+    }
+    units_.resize(size, {0, DOUBLE_ARRAY_FREE});
+    nextFree_.resize(size, NO_UNIT);
+    prevFree_.resize(size, NO_UNIT);
+    trials_.resize(size, 0);
+    for (auto unit = static_cast<uint32_t>(oldSize); unit < size; ++unit) {
+      prevFree_[unit] = tail_;
+      (tail_ != NO_UNIT ? nextFree_[tail_] : head_) = unit;
+      tail_ = unit;
+    }
+  }
+
+  void occupy(uint32_t unit, uint32_t parent) {
+    if (isListed(unit)) {
+      unlink(unit);
+    }
+    units_[unit].check = parent;
+  }
+
+  [[nodiscard]] bool fits(uint32_t base, const std::vector<uint32_t>& codes) const {
+    return std::all_of(codes.begin(), codes.end(), [&](uint32_t code) {
+      const size_t unit = static_cast<size_t>(base) + code;
+      return unit >= units_.size() || units_[unit].check == DOUBLE_ARRAY_FREE;
+    });
+  }
+
+  uint32_t findBase(const std::vector<uint32_t>& codes) {
+    for (uint32_t unit = head_; unit != NO_UNIT;) {
+      const uint32_t next = nextFree_[unit];
+      if (unit > codes.front()) {
+        const uint32_t base = unit - codes.front();
+        if (fits(base, codes)) {
+          return base;
+        }
+        if (++trials_[unit] == MAX_TRIALS) {
+          unlink(unit);
+        }
+      }
+      unit = next;
+    }
+    // after the end of the array
+    return static_cast<uint32_t>(std::max<size_t>(units_.size(), codes.front() + 1) -
+                                 codes.front());
+  }
+
+  const std::vector<std::string_view>& keys_;
+  std::vector<DoubleArrayUnit> units_;
+  std::vector<uint32_t> nextFree_;
+  std::vector<uint32_t> prevFree_;
+  std::vector<uint8_t> trials_;  // of each free unit, MAX_TRIALS if it's not listed
+  uint32_t head_ = NO_UNIT;
+  uint32_t tail_ = NO_UNIT;
+};
+
+void DoubleArrayTrie::loadTextFile(const std::string& txtPath,
+                                   const ParseTextFileOptions& options) {
+  const auto map = parseTextFile(txtPath, options);
+  concatSeparator_ =
+      options.onDuplicatedKey == OnDuplicatedKey::Concat ? options.concatSeparator : "";
+  build(map);
+  valuePoolOptions_ = {options.deduplicateValues, options.compressValues};
+}
+
+void DoubleArrayTrie::build(const std::unordered_map<std::string, std::string>& map) {
+  if (map.size() >= std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Too many keys for a double-array trie");
+  }
+  std::vector<const std::pair<const std::string, std::string>*> entries;
+  entries.reserve(map.size());
+  for (const auto& entry : map) {
+    entries.push_back(&entry);
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const auto* a, const auto* b) { return a->first < b->first; });
+  std::vector<std::string_view> keys;
+  std::vector<std::string> data;
+  keys.reserve(entries.size());
+  data.reserve(entries.size());
+  for (const auto* entry : entries) {
+    keys.emplace_back(entry->first);
+    data.push_back(entry->second);
+  }
+
+  ownedUnits_ = DoubleArrayBuilder(keys).build();
+  units_ = ownedUnits_.data();
+  unitCount_ = ownedUnits_.size();
+  keyCount_ = keys.size();
+  data_ = std::move(data);
+  region_.reset();
+  values_.clear();
+}
+
+void DoubleArrayTrie::loadBinaryFile(const std::string& filePath) {
+  loadBinaryFile(filePath, TrieLoadOptions{});
+}
+
+void DoubleArrayTrie::loadBinaryFile(const std::string& filePath,
+                                     const TrieLoadOptions& options) {
+  boost::interprocess::file_mapping mapping(filePath.c_str(), boost::interprocess::read_only);
+  auto region =
+      std::make_unique<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_only);
+  BinaryFileReader reader(region->get_address(), region->get_size());
+  if (reader.header().layout != binary_format::Layout::DoubleArrayTrie) {
+    throw std::runtime_error("Not a binary double-array trie file: " + filePath);
+  }
+  if (options.verifyChecksums) {
+    reader.verifyChecksums();
+  }
+
+  const uint64_t keyCount = reader.header().valueCount;
+  ValuePool values;
+  values.load(reader, keyCount, options.cachedValueBlocks);
+  auto units = reader.section(binary_format::SectionType::DoubleArray);
+  if (units.empty() || units.size() % sizeof(DoubleArrayUnit) != 0) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  auto separator = reader.findSection(binary_format::SectionType::ConcatSeparator);
+
+  region_ = std::move(region);
+  units_ = reinterpret_cast<const DoubleArrayUnit*>(units.data());
+  unitCount_ = units.size() / sizeof(DoubleArrayUnit);
+  ownedUnits_.clear();
+  keyCount_ = keyCount;
+  data_.clear();
+  values_ = std::move(values);
+  valuePoolOptions_ = values_.options();
+  concatSeparator_ = separator.has_value() ? std::string(separator.value()) : "";
+}
+
+void DoubleArrayTrie::saveToBinaryFile(const std::string& filePath) {
+  if (unitCount_ == 0) {
+    throw std::runtime_error("No trie loaded.");
+  }
+  BinaryFileWriter writer(binary_format::Layout::DoubleArrayTrie, keyCount_, keyCount_);
+  if (!concatSeparator_.empty()) {
+    writer.addSection(binary_format::SectionType::ConcatSeparator,
+                      binary_format::DEFAULT_ALIGNMENT,
+                      [this](auto& out) { out.writeBytes(concatSeparator_); });
+  }
+  // read under a pin per batch, so that the cache keeps the recently decoded blocks only
+  ValuePool::addSections(writer, keyCount_,
+                         values_.pinInBatches([this](size_t id) { return valueAt(id); }),
+                         valuePoolOptions_);
+  // page-aligned to be mapped in place
+  writer.addSection(binary_format::SectionType::DoubleArray, binary_format::PAGE_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(units_),
+                                      unitCount_ * sizeof(DoubleArrayUnit)});
+                    });
+  writer.writeFile(filePath);
+}
+
+std::string_view DoubleArrayTrie::valueAt(size_t id) const {
+  return region_ ? values_.at(id) : data_[id];
+}
+
+std::optional<uint32_t> DoubleArrayTrie::walk(std::string_view key) const {
+  if (unitCount_ == 0) {  // neither built nor loaded
+    return std::nullopt;
+  }
+  uint32_t node = 0;
+  for (const char ch : key) {
+    const size_t child =
+        static_cast<size_t>(units_[node].base) + static_cast<unsigned char>(ch) + 1;
+    if (child >= unitCount_ || units_[child].check != node) {
+      return std::nullopt;
+    }
+    node = static_cast<uint32_t>(child);
+  }
+  return node;
+}
+
+std::optional<uint32_t> DoubleArrayTrie::keyIdAt(uint32_t node) const {
+  const size_t child = static_cast<size_t>(units_[node].base) + END_CODE;
+  if (child >= unitCount_ || units_[child].check != node || units_[child].base >= keyCount_) {
+    return std::nullopt;
+  }
+  return units_[child].base;
+}
+
+void DoubleArrayTrie::forEachPrefixMatch(
+    std::string_view prefix,
+    const std::function<bool(const std::string&, uint32_t)>& visitor) const {
+  auto start = walk(prefix);
+  if (!start.has_value()) {
+    return;
+  }
+
+  // walks down the nodes depth-first, trying the codes of the children in the ascending order
+  struct Frame {
+    uint32_t node;
+    size_t length;  // of the key of the node
+    uint32_t code;  // of the next child to try
+  };
+  std::string key(prefix);
+  std::vector<Frame> stack{{start.value(), key.length(), END_CODE}};
+  while (!stack.empty()) {
+    Frame& frame = stack.back();
+    const size_t base = units_[frame.node].base;
+    bool descended = false;
+    while (frame.code <= MAX_CODE && base + frame.code < unitCount_) {
+      const uint32_t code = frame.code++;
+      const size_t child = base + code;
+      if (units_[child].check != frame.node) {
+        continue;
+      }
+      key.resize(frame.length);
+      if (code == END_CODE) {
+        if (units_[child].base < keyCount_ && !visitor(key, units_[child].base)) {
+          return;
+        }
+        continue;
+      }
+      key.push_back(static_cast<char>(code - 1));
+      stack.push_back({static_cast<uint32_t>(child), key.length(), END_CODE});
+      descended = true;
+      break;
+    }
+    if (!descended) {
+      stack.pop_back();
+    }
+  }
+}
+
+std::optional<std::string> DoubleArrayTrie::find(const std::string& key) const {
+  const auto pin = values_.pin();
+  auto value = findView(key);
+  return value.has_value() ? std::optional<std::string>(value.value()) : std::nullopt;
+}
+
+std::optional<std::string_view> DoubleArrayTrie::findView(std::string_view key) const {
+  const auto pin = values_.pin();  // the decoded values are kept until the next lookup
+  auto node = walk(key);
+  auto id = node.has_value() ? keyIdAt(node.value()) : std::nullopt;
+  return id.has_value() ? std::optional<std::string_view>(valueAt(id.value())) : std::nullopt;
+}
+
+bool DoubleArrayTrie::contains(std::string_view key) const {
+  auto node = walk(key);
+  return node.has_value() && keyIdAt(node.value()).has_value();
+}
+
+std::vector<std::string> DoubleArrayTrie::findAll(const std::string& key) const {
+  const auto pin = values_.pin();
+  auto items = findAllView(key);
+  return {items.begin(), items.end()};
+}
+
+std::vector<std::string_view> DoubleArrayTrie::findAllView(std::string_view key) const {
+  const auto pin = values_.pin();
+  std::vector<std::string_view> results;
+  if (auto value = findView(key)) {
+    forEachItem(value.value(), concatSeparator_,
+                [&](std::string_view item) { results.push_back(item); });
+  }
+  return results;
+}
+
+std::vector<std::optional<std::string>> DoubleArrayTrie::findMany(
+    const std::vector<std::string>& keys) const {
+  const auto pin = values_.pin();
+  std::vector<std::optional<std::string>> values;
+  values.reserve(keys.size());
+  for (const auto& key : keys) {
+    auto value = findView(key);
+    values.push_back(value.has_value() ? std::optional<std::string>(value.value()) : std::nullopt);
+  }
+  return values;
+}
+
+std::vector<std::pair<std::string, std::string>> DoubleArrayTrie::prefixSearch(
+    const std::string& prefix) const {
+  return prefixSearch(prefix, {});
+}
+
+std::vector<std::pair<std::string, std::string>> DoubleArrayTrie::prefixSearch(
+    const std::string& prefix,
+    const PrefixSearchOptions& options) const {
+  const auto pin = values_.pin();
+  auto matches = prefixSearchView(prefix, options);
+  std::vector<std::pair<std::string, std::string>> results;
+  results.reserve(matches.size());
+  for (auto& [key, value] : matches) {
+    results.emplace_back(std::move(key), value);
+  }
+  return results;
+}
+
+std::vector<std::pair<std::string, std::string_view>> DoubleArrayTrie::prefixSearchView(
+    std::string_view prefix,
+    const PrefixSearchOptions& options) const {
+  const auto pin = values_.pin();
+  std::vector<std::pair<std::string, std::string_view>> results;
+  size_t skipped = 0;
+  const auto isFull = [&] { return options.limit > 0 && results.size() >= options.limit; };
+  // a result per item of the concatenated values, the same as `Trie::prefixSearchView`
+  forEachPrefixMatch(prefix, [&](const std::string& key, uint32_t id) {
+    forEachItem(valueAt(id), concatSeparator_, [&](std::string_view item) {
+      if (skipped < options.offset) {
+        ++skipped;
+      } else if (!isFull()) {
+        results.emplace_back(key, item);
+      }
+    });
+    return !isFull();
+  });
+  return results;
+}
+
+}  // namespace rime
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dicts/binary_format.h"
+#include "dicts/dictionary.h"
+#include "dicts/trie.h"
+#include "dicts/value_pool.h"
+
+namespace rime {
+
+// A dictionary on a double-array trie, an alternative to the marisa `Trie` for the workloads bound
+// by the latency of the exact lookups. A key is walked by one indexed read of the array per byte,
+// instead of the several ones of a succinct trie, at the cost of a larger file. The keys are
+// numbered in their byte order, and the array of a loaded binary file is mapped in place.
+class DoubleArrayTrie : public Dictionary {
+public:
+  void loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) override;
+  void loadBinaryFile(const std::string& filePath) override;
+  // The mode and the advice of the options are ignored, as the array is always mapped.
+  void loadBinaryFile(const std::string& filePath, const TrieLoadOptions& options);
+  void saveToBinaryFile(const std::string& filePath) override;
+  void build(const std::unordered_map<std::string, std::string>& map);
+
+  [[nodiscard]] std::optional<std::string> find(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::string> findAll(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::optional<std::string>> findMany(
+      const std::vector<std::string>& keys) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix,
+      const PrefixSearchOptions& options) const;
+
+  // Zero-copy variants of find/prefixSearch, valid as long as the ones of `Trie`.
+  [[nodiscard]] std::optional<std::string_view> findView(std::string_view key) const;
+  [[nodiscard]] std::vector<std::string_view> findAllView(std::string_view key) const;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string_view>> prefixSearchView(
+      std::string_view prefix,
+      const PrefixSearchOptions& options = {}) const;
+
+  [[nodiscard]] bool contains(std::string_view key) const;
+  [[nodiscard]] size_t size() const { return keyCount_; }
+  // the bytes of the array, to compare the footprint with the other dictionaries
+  [[nodiscard]] size_t arraySize() const { return unitCount_ * sizeof(DoubleArrayUnit); }
+
+private:
+  // keeps the loaded binary file mapped, the array and the value pool below point into it
+  std::unique_ptr<boost::interprocess::mapped_region> region_;
+  const DoubleArrayUnit* units_ = nullptr;
+  size_t unitCount_ = 0;
+  std::vector<DoubleArrayUnit> ownedUnits_;  // if built in memory
+  size_t keyCount_ = 0;
+  std::vector<std::string> data_;        // the values of the keys built in memory, by the key ids
+  ValuePool values_;                     // of the loaded binary file
+  ValuePool::Options valuePoolOptions_;  // how the values are stored in the saved binary file
+  std::string concatSeparator_;
+
+  [[nodiscard]] std::string_view valueAt(size_t id) const;
+  // the node reached from the root by the bytes of the key, or std::nullopt
+  [[nodiscard]] std::optional<uint32_t> walk(std::string_view key) const;
+  // the key id of the key ending at the node, or std::nullopt
+  [[nodiscard]] std::optional<uint32_t> keyIdAt(uint32_t node) const;
+  // Visits the keys starting with the prefix and their ids in the byte order of the keys, until the
+  // visitor returns false.
+  void forEachPrefixMatch(std::string_view prefix,
+                          const std::function<bool(const std::string&, uint32_t)>& visitor) const;
+};
+
+}  // namespace rime
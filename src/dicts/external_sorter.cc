@@ -0,0 +1,209 @@
+#include "dicts/external_sorter.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+
+// the read buffer of a run file while merging the runs
+constexpr size_t MIN_RUN_BUFFER_SIZE = 64 * 1024;
+// the runs merged at once, to bound the open files and their read buffers
+constexpr size_t MAX_MERGED_RUNS = 64;
+
+static void writeString(std::ostream& out, const std::string& str) {
+  const uint64_t length = str.length();
+  out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+  out.write(str.data(), static_cast<std::streamsize>(length));
+}
+
+// returns false at the end of the file
+static bool readString(std::istream& in, std::string& str) {
+  uint64_t length = 0;
+  if (!in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+    return false;
+  }
+  str.resize(length);
+  if (!in.read(str.data(), static_cast<std::streamsize>(length))) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  return true;
+}
+
+// writes the entries visited by `visit` to a run file
+template <typename Visit>
+static void writeRun(const std::string& path, Visit&& visit) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("Failed to open file for writing " + path);
+  }
+  visit([&out](const std::string& key, const std::string& value) {
+    writeString(out, key);
+    writeString(out, value);
+  });
+  if (!out) {
+    throw std::runtime_error("Failed to write file " + path);
+  }
+}
+
+class RunReader {
+  std::unique_ptr<char[]> buffer_;  // NOLINT(modernize-avoid-c-arrays)
+  std::ifstream in_;
+
+public:
+  size_t index;  // the runs spilled earlier have the smaller indexes
+  std::pair<std::string, std::string> entry;
+
+  RunReader(const std::string& path, size_t bufferSize, size_t index)
+      : buffer_(std::make_unique<char[]>(bufferSize)),  // NOLINT(modernize-avoid-c-arrays)
+        index(index) {
+    in_.rdbuf()->pubsetbuf(buffer_.get(), static_cast<std::streamsize>(bufferSize));
+    in_.open(path, std::ios::binary);
+    if (!in_) {
+      throw std::runtime_error("Failed to open file " + path);
+    }
+  }
+
+  bool next() { return readString(in_, entry.first) && readString(in_, entry.second); }
+};
+
+ExternalSorter::ExternalSorter(const ParseTextFileOptions& options, std::string tempPathPrefix)
+    : options_(options), tempPathPrefix_(std::move(tempPathPrefix)) {}
+
+ExternalSorter::~ExternalSorter() {
+  for (const auto& path : runPaths_) {
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+  }
+}
+
+void ExternalSorter::add(std::string&& key, std::string&& value) {
+  memoryUsage_ += key.capacity() + value.capacity();
+  entries_.emplace_back(std::move(key), std::move(value));
+  if (options_.memoryBudget > 0 &&
+      memoryUsage_ + entries_.capacity() * sizeof(Entry) >= options_.memoryBudget) {
+    spill();
+  }
+}
+
+void ExternalSorter::finish(const Dictionary::EntryVisitor& visitor) {
+  if (runPaths_.empty()) {
+    sortEntries();
+    for (const auto& [key, value] : entries_) {
+      visitor(key, value);
+    }
+  } else {
+    if (!entries_.empty()) {
+      spill();
+    }
+    std::vector<Entry>().swap(entries_);  // release the memory for the read buffers
+    mergeRuns(visitor);
+  }
+  entries_.clear();
+  memoryUsage_ = 0;
+}
+
+void ExternalSorter::sortEntries() {
+  // stable, to merge the values of a duplicated key in the order they were added
+  std::stable_sort(entries_.begin(), entries_.end(),
+                   [](const Entry& a, const Entry& b) { return a.first < b.first; });
+
+  auto last = entries_.begin();
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (last != entries_.begin() && std::prev(last)->first == it->first) {
+      Dictionary::mergeDuplicatedValue(std::prev(last)->second, std::move(it->second), options_);
+      continue;
+    }
+    if (last != it) {
+      *last = std::move(*it);
+    }
+    ++last;
+  }
+  entries_.erase(last, entries_.end());
+}
+
+void ExternalSorter::spill() {
+  sortEntries();
+
+  auto path = tempPathPrefix_ + ".run" + std::to_string(spilledRuns_++);
+  runPaths_.push_back(path);  // to be removed even if it fails to be written
+  writeRun(path, [this](const auto& write) {
+    for (const auto& [key, value] : entries_) {
+      write(key, value);
+    }
+  });
+
+  // released, as the capacity is counted in the budget of the next run
+  std::vector<Entry>().swap(entries_);
+  memoryUsage_ = 0;
+}
+
+void ExternalSorter::mergeRuns(const Dictionary::EntryVisitor& visitor) {
+  // Merges the consecutive runs into the new runs until they could be merged at once, which keeps
+  // the values of a duplicated key in the order they were added. The new runs are appended to the
+  // paths, so that all the files are removed even if a pass fails.
+  while (runPaths_.size() > MAX_MERGED_RUNS) {
+    const size_t runs = runPaths_.size();
+    for (size_t begin = 0; begin < runs; begin += MAX_MERGED_RUNS) {
+      auto path = tempPathPrefix_ + ".merged" + std::to_string(mergedRuns_++);
+      runPaths_.push_back(path);
+      writeRun(path, [&](const auto& write) {
+        mergeRuns(begin, std::min(begin + MAX_MERGED_RUNS, runs), write);
+      });
+    }
+    for (size_t i = 0; i < runs; ++i) {
+      std::error_code ec;
+      std::filesystem::remove(runPaths_[i], ec);
+    }
+    runPaths_.erase(runPaths_.begin(), runPaths_.begin() + static_cast<std::ptrdiff_t>(runs));
+  }
+  mergeRuns(0, runPaths_.size(), visitor);
+}
+
+void ExternalSorter::mergeRuns(size_t begin,
+                               size_t end,
+                               const Dictionary::EntryVisitor& visitor) {
+  const size_t bufferSize =
+      std::max(MIN_RUN_BUFFER_SIZE, options_.memoryBudget / ((end - begin) * 2));
+
+  // the smallest key on the top, and the earliest run for the duplicated keys
+  auto greater = [](const RunReader* a, const RunReader* b) {
+    const int order = a->entry.first.compare(b->entry.first);
+    return order != 0 ? order > 0 : a->index > b->index;
+  };
+  std::priority_queue<RunReader*, std::vector<RunReader*>, decltype(greater)> queue(greater);
+
+  std::vector<std::unique_ptr<RunReader>> readers;
+  for (size_t i = begin; i < end; ++i) {
+    readers.push_back(std::make_unique<RunReader>(runPaths_[i], bufferSize, i));
+    if (readers.back()->next()) {
+      queue.push(readers.back().get());
+    }
+  }
+
+  std::string key;
+  std::string value;
+  while (!queue.empty()) {
+    RunReader* reader = queue.top();
+    queue.pop();
+    key = std::move(reader->entry.first);
+    value = std::move(reader->entry.second);
+    if (reader->next()) {
+      queue.push(reader);
+    }
+
+    while (!queue.empty() && queue.top()->entry.first == key) {
+      RunReader* duplicated = queue.top();
+      queue.pop();
+      Dictionary::mergeDuplicatedValue(value, std::move(duplicated->entry.second), options_);
+      if (duplicated->next()) {
+        queue.push(duplicated);
+      }
+    }
+    visitor(key, value);
+  }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dicts/dictionary.h"
+
+// Sorts the entries of a dictionary by key within a memory budget. The entries are kept in memory
+// until the budget is reached, then sorted and spilled to a temporary run file. The runs are merged
+// at last, and the values of the duplicated keys are merged in the order they were added.
+class ExternalSorter {
+public:
+  ExternalSorter(const ParseTextFileOptions& options, std::string tempPathPrefix);
+  ExternalSorter(const ExternalSorter&) = delete;
+  ExternalSorter(ExternalSorter&&) = delete;
+  ExternalSorter& operator=(const ExternalSorter&) = delete;
+  ExternalSorter& operator=(ExternalSorter&&) = delete;
+  ~ExternalSorter();
+
+  void add(std::string&& key, std::string&& value);
+
+  // Visits the entries in the byte order of the keys, each key once.
+  void finish(const Dictionary::EntryVisitor& visitor);
+
+  // the sorted runs spilled to the temporary files
+  [[nodiscard]] size_t spilledRuns() const { return spilledRuns_; }
+
+private:
+  using Entry = std::pair<std::string, std::string>;
+
+  // sorts the entries in memory, and merges the values of the duplicated keys
+  void sortEntries();
+  void spill();
+  // merges the runs in passes of a bounded number of runs, and visits the merged entries
+  void mergeRuns(const Dictionary::EntryVisitor& visitor);
+  // merges the runs of the indexes [begin, end), the earlier runs first for the duplicated keys
+  void mergeRuns(size_t begin, size_t end, const Dictionary::EntryVisitor& visitor);
+
+  const ParseTextFileOptions& options_;
+  std::string tempPathPrefix_;
+  std::vector<Entry> entries_;
+  size_t memoryUsage_ = 0;
+  size_t spilledRuns_ = 0;
+  size_t mergedRuns_ = 0;  // the runs written by the merge passes
+  std::vector<std::string> runPaths_;  // of the runs to be merged, in the order they're spilled
+};
@@ -0,0 +1,490 @@
+#include "dicts/fst.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace rime {
+
+// Builds the minimal transducer from the keys added in the ascending byte order, in the way of
+// Daciuk et al.: the states of the previous key beyond its common prefix with the next key have
+// no more arcs to come, and are replaced by the equivalent states built before, if any.
+class FstBuilder {
+public:
+  FstBuilder() : register_(0, StateHash{this}, StateEqual{this}) {}
+
+  void add(std::string_view key) {
+    if (started_ && key <= std::string_view(previous_)) {
+      throw std::runtime_error("The keys of an FST should be unique and in the ascending order");
+    }
+    if (++keyCount_ >= std::numeric_limits<uint32_t>::max()) {
+      throw std::runtime_error("Too many keys for an FST");
+    }
+    size_t common = 0;
+    if (started_) {
+      common = static_cast<size_t>(
+          std::mismatch(key.begin(), key.end(), previous_.begin(), previous_.end()).first -
+          key.begin());
+    }
+    freeze(common);
+    for (size_t depth = common; depth < key.length(); ++depth) {
+      frontier_[depth].arcs.push_back({static_cast<uint8_t>(key[depth]), 0});
+      frontier_.emplace_back();
+    }
+    frontier_.back().final = true;
+    previous_.assign(key);
+    started_ = true;
+  }
+
+  // Freezes the remaining states, and moves the transducer out, with the root as the last state.
+  void finish(std::vector<FstState>& states, std::vector<FstArc>& arcs) {
+    freeze(0);
+    // the root is never equivalent to another state, which has only the shorter keys after it
+    append(frontier_[0]);
+    register_.clear();
+    states = std::move(states_);
+    arcs = std::move(arcs_);
+  }
+
+private:
+  struct PendingArc {
+    uint8_t label;
+    uint32_t target;  // set when the target is frozen
+  };
+  struct PendingState {
+    std::vector<PendingArc> arcs;
+    bool final = false;
+  };
+
+  // hashes and compares the frozen states by their finality and arcs, which determine the outputs
+  struct StateHash {
+    const FstBuilder* builder;
+    size_t operator()(uint32_t id) const {
+      const FstState& state = builder->states_[id];
+      size_t hash = state.final;
+      for (uint32_t i = 0; i < state.arcCount; ++i) {
+        const FstArc& arc = builder->arcs_[state.firstArc + i];
+        hash = hash * 31 + ((static_cast<size_t>(arc.target) << 8) | arc.label);
+      }
+      return hash;
+    }
+  };
+  struct StateEqual {
+    const FstBuilder* builder;
+    bool operator()(uint32_t a, uint32_t b) const {
+      const FstState& x = builder->states_[a];
+      const FstState& y = builder->states_[b];
+      if (x.final != y.final || x.arcCount != y.arcCount) {
+        return false;
+      }
+      return std::equal(builder->arcs_.begin() + x.firstArc,
+                        builder->arcs_.begin() + x.firstArc + x.arcCount,
+                        builder->arcs_.begin() + y.firstArc, [](const FstArc& p, const FstArc& q) {
+                          return p.target == q.target && p.label == q.label;
+                        });
+    }
+  };
+
+  // freezes the states deeper than the depth, and links them to their parents
+  void freeze(size_t depth) {
+    if (frontier_.empty()) {
+      frontier_.emplace_back();
+    }
+    while (frontier_.size() > depth + 1) {
+      const uint32_t id = intern(frontier_.back());
+      frontier_.pop_back();
+      frontier_.back().arcs.back().target = id;
+    }
+  }
+
+  // appends the frozen state, and returns its id
+  uint32_t append(const PendingState& pending) {
+    if (arcs_.size() + pending.arcs.size() >= std::numeric_limits<uint32_t>::max()) {
+      throw std::runtime_error("Too many keys for an FST");
+    }
+    FstState state{static_cast<uint32_t>(arcs_.size()),
+                   static_cast<uint16_t>(pending.arcs.size()),
+                   static_cast<uint8_t>(pending.final ? 1 : 0), 0};
+    uint32_t count = state.final;
+    for (const auto& arc : pending.arcs) {
+      arcs_.push_back({arc.target, count, arc.label, {}});
+      count += counts_[arc.target];
+    }
+    states_.push_back(state);
+    counts_.push_back(count);
+    return static_cast<uint32_t>(states_.size() - 1);
+  }
+
+  // returns the equivalent state built before, or the state appended
+  uint32_t intern(const PendingState& pending) {
+    const uint32_t id = append(pending);
+    auto [found, inserted] = register_.insert(id);
+    if (!inserted) {
+      arcs_.resize(states_.back().firstArc);
+      states_.pop_back();
+      counts_.pop_back();
+    }
+    return *found;
+  }
+
+  std::vector<FstState> states_;
+  std::vector<FstArc> arcs_;
+  std::vector<uint32_t> counts_;  // the keys after each state
+  std::unordered_set<uint32_t, StateHash, StateEqual> register_;
+  std::vector<PendingState> frontier_;  // the unfrozen states along the previous key
+  std::string previous_;
+  bool started_ = false;
+  size_t keyCount_ = 0;
+};
+
+void Fst::loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) {
+  // the entries are parsed in the key order, which builds the transducer in one pass
+  FstBuilder builder;
+  std::vector<std::string> data;
+  parseSortedTextFile(txtPath, options, txtPath,
+                      [&](const std::string& key, const std::string& value) {
+                        builder.add(key);
+                        data.push_back(value);
+                      });
+  builder.finish(ownedStates_, ownedArcs_);
+  setTransducer(ownedStates_.data(), ownedStates_.size(), ownedArcs_.data(), ownedArcs_.size());
+  keyCount_ = data.size();
+  data_ = std::move(data);
+  region_.reset();
+  values_.clear();
+  concatSeparator_ =
+      options.onDuplicatedKey == OnDuplicatedKey::Concat ? options.concatSeparator : "";
+  valuePoolOptions_ = {options.deduplicateValues, options.compressValues};
+}
+
+void Fst::build(const std::unordered_map<std::string, std::string>& map) {
+  std::vector<const std::pair<const std::string, std::string>*> entries;
+  entries.reserve(map.size());
+  for (const auto& entry : map) {
+    entries.push_back(&entry);
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const auto* a, const auto* b) { return a->first < b->first; });
+
+  FstBuilder builder;
+  std::vector<std::string> data;
+  data.reserve(entries.size());
+  for (const auto* entry : entries) {
+    builder.add(entry->first);
+    data.push_back(entry->second);
+  }
+  builder.finish(ownedStates_, ownedArcs_);
+  setTransducer(ownedStates_.data(), ownedStates_.size(), ownedArcs_.data(), ownedArcs_.size());
+  keyCount_ = data.size();
+  data_ = std::move(data);
+  region_.reset();
+  values_.clear();
+}
+
+void Fst::loadBinaryFile(const std::string& filePath) {
+  loadBinaryFile(filePath, TrieLoadOptions{});
+}
+
+void Fst::loadBinaryFile(const std::string& filePath, const TrieLoadOptions& options) {
+  boost::interprocess::file_mapping mapping(filePath.c_str(), boost::interprocess::read_only);
+  auto region =
+      std::make_unique<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_only);
+  BinaryFileReader reader(region->get_address(), region->get_size());
+  if (reader.header().layout != binary_format::Layout::Fst) {
+    throw std::runtime_error("Not a binary FST file: " + filePath);
+  }
+  if (options.verifyChecksums) {
+    reader.verifyChecksums();
+  }
+
+  const uint64_t keyCount = reader.header().valueCount;
+  ValuePool values;
+  values.load(reader, keyCount, options.cachedValueBlocks);
+  auto states = reader.section(binary_format::SectionType::FstStates);
+  auto arcs = reader.section(binary_format::SectionType::FstArcs);
+  if (states.empty() || states.size() % sizeof(FstState) != 0 ||
+      arcs.size() % sizeof(FstArc) != 0) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  auto separator = reader.findSection(binary_format::SectionType::ConcatSeparator);
+
+  region_ = std::move(region);
+  setTransducer(reinterpret_cast<const FstState*>(states.data()), states.size() / sizeof(FstState),
+                reinterpret_cast<const FstArc*>(arcs.data()), arcs.size() / sizeof(FstArc));
+  ownedStates_.clear();
+  ownedArcs_.clear();
+  keyCount_ = keyCount;
+  data_.clear();
+  values_ = std::move(values);
+  valuePoolOptions_ = values_.options();
+  concatSeparator_ = separator.has_value() ? std::string(separator.value()) : "";
+}
+
+void Fst::saveToBinaryFile(const std::string& filePath) {
+  if (stateCount_ == 0) {
+    throw std::runtime_error("No trie loaded.");
+  }
+  BinaryFileWriter writer(binary_format::Layout::Fst, keyCount_, keyCount_);
+  if (!concatSeparator_.empty()) {
+    writer.addSection(binary_format::SectionType::ConcatSeparator,
+                      binary_format::DEFAULT_ALIGNMENT,
+                      [this](auto& out) { out.writeBytes(concatSeparator_); });
+  }
+  // read under a pin per batch, so that the cache keeps the recently decoded blocks only
+  ValuePool::addSections(writer, keyCount_,
+                         values_.pinInBatches([this](size_t id) { return valueAt(id); }),
+                         valuePoolOptions_);
+  // page-aligned to be mapped in place
+  writer.addSection(binary_format::SectionType::FstStates, binary_format::PAGE_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(states_),
+                                      stateCount_ * sizeof(FstState)});
+                    });
+  writer.addSection(binary_format::SectionType::FstArcs, binary_format::DEFAULT_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeBytes(
+                          {reinterpret_cast<const char*>(arcs_), arcCount_ * sizeof(FstArc)});
+                    });
+  writer.writeFile(filePath);
+}
+
+void Fst::setTransducer(const FstState* states,
+                        size_t stateCount,
+                        const FstArc* arcs,
+                        size_t arcCount) {
+  states_ = states;
+  stateCount_ = stateCount;
+  arcs_ = arcs;
+  arcCount_ = arcCount;
+}
+
+std::string_view Fst::valueAt(size_t id) const {
+  return region_ ? values_.at(id) : data_[id];
+}
+
+const FstArc* Fst::arcOf(const FstState& state, unsigned char label) const {
+  if (static_cast<size_t>(state.firstArc) + state.arcCount > arcCount_) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  const FstArc* begin = arcs_ + state.firstArc;
+  const FstArc* end = begin + state.arcCount;
+  const FstArc* arc = std::lower_bound(begin, end, label, [](const FstArc& a, unsigned char b) {
+    return a.label < b;
+  });
+  return arc != end && arc->label == label && arc->target < stateCount_ ? arc : nullptr;
+}
+
+std::optional<uint32_t> Fst::keyIdOf(std::string_view key) const {
+  if (stateCount_ == 0) {  // neither built nor loaded
+    return std::nullopt;
+  }
+  uint32_t state = static_cast<uint32_t>(stateCount_ - 1);
+  uint32_t id = 0;
+  for (const char ch : key) {
+    const FstArc* arc = arcOf(states_[state], static_cast<unsigned char>(ch));
+    if (arc == nullptr) {
+      return std::nullopt;
+    }
+    id += arc->output;
+    state = arc->target;
+  }
+  if (states_[state].final == 0 || id >= keyCount_) {
+    return std::nullopt;
+  }
+  return id;
+}
+
+template <typename Visitor>
+void Fst::walkDown(std::vector<Frame>& stack, std::string& key, Visitor&& visitor) const {
+  while (!stack.empty()) {
+    Frame& frame = stack.back();
+    const FstState& state = states_[frame.state];
+    key.resize(frame.length);
+    if (!frame.visited) {
+      frame.visited = true;
+      if (state.final != 0 && frame.id < keyCount_ && !visitor(key, frame.id)) {
+        return;
+      }
+      continue;
+    }
+    if (frame.nextArc >= state.arcCount ||
+        static_cast<size_t>(state.firstArc) + frame.nextArc >= arcCount_) {
+      stack.pop_back();
+      continue;
+    }
+    const FstArc& arc = arcs_[state.firstArc + frame.nextArc++];
+    if (arc.target >= stateCount_) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    key.push_back(static_cast<char>(arc.label));
+    const Frame child{arc.target, 0, frame.id + arc.output, key.length(), false};
+    stack.push_back(child);
+  }
+}
+
+template <typename Walk>
+std::vector<std::pair<std::string, std::string_view>> Fst::collect(
+    const PrefixSearchOptions& options,
+    Walk&& walk) const {
+  std::vector<std::pair<std::string, std::string_view>> results;
+  size_t skipped = 0;
+  const auto isFull = [&] { return options.limit > 0 && results.size() >= options.limit; };
+  // a result per item of the concatenated values, the same as `Trie::prefixSearchView`
+  walk([&](const std::string& key, uint32_t id) {
+    forEachItem(valueAt(id), concatSeparator_, [&](std::string_view item) {
+      if (skipped < options.offset) {
+        ++skipped;
+      } else if (!isFull()) {
+        results.emplace_back(key, item);
+      }
+    });
+    return !isFull();
+  });
+  return results;
+}
+
+std::optional<std::string> Fst::find(const std::string& key) const {
+  const auto pin = values_.pin();
+  auto value = findView(key);
+  return value.has_value() ? std::optional<std::string>(value.value()) : std::nullopt;
+}
+
+std::optional<std::string_view> Fst::findView(std::string_view key) const {
+  const auto pin = values_.pin();  // the decoded values are kept until the next lookup
+  auto id = keyIdOf(key);
+  return id.has_value() ? std::optional<std::string_view>(valueAt(id.value())) : std::nullopt;
+}
+
+bool Fst::contains(std::string_view key) const {
+  return keyIdOf(key).has_value();
+}
+
+std::vector<std::string> Fst::findAll(const std::string& key) const {
+  const auto pin = values_.pin();
+  auto items = findAllView(key);
+  return {items.begin(), items.end()};
+}
+
+std::vector<std::string_view> Fst::findAllView(std::string_view key) const {
+  const auto pin = values_.pin();
+  std::vector<std::string_view> results;
+  if (auto value = findView(key)) {
+    forEachItem(value.value(), concatSeparator_,
+                [&](std::string_view item) { results.push_back(item); });
+  }
+  return results;
+}
+
+std::vector<std::optional<std::string>> Fst::findMany(const std::vector<std::string>& keys) const {
+  const auto pin = values_.pin();
+  std::vector<std::optional<std::string>> values;
+  values.reserve(keys.size());
+  for (const auto& key : keys) {
+    auto value = findView(key);
+    values.push_back(value.has_value() ? std::optional<std::string>(value.value()) : std::nullopt);
+  }
+  return values;
+}
+
+std::vector<std::pair<std::string, std::string>> Fst::prefixSearch(
+    const std::string& prefix) const {
+  return prefixSearch(prefix, {});
+}
+
+std::vector<std::pair<std::string, std::string>> Fst::prefixSearch(
+    const std::string& prefix,
+    const PrefixSearchOptions& options) const {
+  const auto pin = values_.pin();
+  auto matches = prefixSearchView(prefix, options);
+  std::vector<std::pair<std::string, std::string>> results;
+  results.reserve(matches.size());
+  for (auto& [key, value] : matches) {
+    results.emplace_back(std::move(key), value);
+  }
+  return results;
+}
+
+std::vector<std::pair<std::string, std::string>> Fst::range(
+    const std::string& from,
+    const std::string& to,
+    const PrefixSearchOptions& options) const {
+  const auto pin = values_.pin();
+  auto matches = rangeView(from, to, options);
+  std::vector<std::pair<std::string, std::string>> results;
+  results.reserve(matches.size());
+  for (auto& [key, value] : matches) {
+    results.emplace_back(std::move(key), value);
+  }
+  return results;
+}
+
+std::vector<std::pair<std::string, std::string_view>> Fst::prefixSearchView(
+    std::string_view prefix,
+    const PrefixSearchOptions& options) const {
+  const auto pin = values_.pin();
+  if (stateCount_ == 0) {
+    return {};
+  }
+  // the id of the first key starting with the prefix is the sum of the outputs along the prefix
+  uint32_t state = static_cast<uint32_t>(stateCount_ - 1);
+  uint32_t id = 0;
+  for (const char ch : prefix) {
+    const FstArc* arc = arcOf(states_[state], static_cast<unsigned char>(ch));
+    if (arc == nullptr) {
+      return {};
+    }
+    id += arc->output;
+    state = arc->target;
+  }
+
+  std::string key(prefix);
+  std::vector<Frame> stack{{state, 0, id, key.length(), false}};
+  return collect(options, [&](auto&& visitor) { walkDown(stack, key, visitor); });
+}
+
+std::vector<std::pair<std::string, std::string_view>> Fst::rangeView(
+    std::string_view from,
+    std::string_view to,
+    const PrefixSearchOptions& options) const {
+  const auto pin = values_.pin();
+  if (stateCount_ == 0 || (!to.empty() && from >= to)) {
+    return {};
+  }
+  // Walks down along `from`, leaving the arcs after its bytes on the stack to be taken later, as
+  // the keys through them are greater than it, and the keys ending on the way are less than it.
+  std::vector<Frame> stack;
+  uint32_t state = static_cast<uint32_t>(stateCount_ - 1);
+  uint32_t id = 0;
+  bool reached = true;
+  for (size_t depth = 0; depth < from.length(); ++depth) {
+    const FstState& current = states_[state];
+    const auto label = static_cast<unsigned char>(from[depth]);
+    const FstArc* arc = arcOf(current, label);  // which checks the arcs of the state
+    const FstArc* begin = arcs_ + current.firstArc;
+    const FstArc* end = begin + current.arcCount;
+    const FstArc* after = std::upper_bound(begin, end, label, [](unsigned char a, const FstArc& b) {
+      return a < b.label;
+    });
+    stack.push_back({state, static_cast<uint32_t>(after - begin), id, depth, true});
+    if (arc == nullptr) {
+      reached = false;
+      break;
+    }
+    id += arc->output;
+    state = arc->target;
+  }
+  if (reached) {
+    stack.push_back({state, 0, id, from.length(), false});
+  }
+
+  std::string key(from);
+  return collect(options, [&](auto&& visitor) {
+    walkDown(stack, key, [&](const std::string& matched, uint32_t matchedId) {
+      return (to.empty() || matched < to) && visitor(matched, matchedId);
+    });
+  });
+}
+
+}  // namespace rime
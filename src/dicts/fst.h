@@ -0,0 +1,117 @@
+#pragma once
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dicts/binary_format.h"
+#include "dicts/dictionary.h"
+#include "dicts/trie.h"
+#include "dicts/value_pool.h"
+
+namespace rime {
+
+// A dictionary on a minimal acyclic finite state transducer, in the style of the FSTs of Lucene.
+// The keys sharing a suffix share the states of it as well as the ones of their common prefix,
+// which suits the dictionaries of many inflected or compound keys, e.g. pinyin syllables. It's
+// built from the keys in the byte order in one pass, and maps the keys to their ids in that order,
+// by which the values are stored in the value pool of the binary file (see
+// `ParseTextFileOptions::deduplicateValues` and `compressValues` for the values sharing their
+// texts). The states and the arcs of a loaded binary file are mapped in place.
+class Fst : public Dictionary {
+public:
+  void loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) override;
+  void loadBinaryFile(const std::string& filePath) override;
+  // The mode and the advice of the options are ignored, as the transducer is always mapped.
+  void loadBinaryFile(const std::string& filePath, const TrieLoadOptions& options);
+  void saveToBinaryFile(const std::string& filePath) override;
+  void build(const std::unordered_map<std::string, std::string>& map);
+
+  [[nodiscard]] std::optional<std::string> find(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::string> findAll(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::optional<std::string>> findMany(
+      const std::vector<std::string>& keys) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix,
+      const PrefixSearchOptions& options) const;
+  // Returns the entries of the keys in [from, to) in the byte order, or of all the keys since
+  // `from` if `to` is empty.
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> range(
+      const std::string& from,
+      const std::string& to,
+      const PrefixSearchOptions& options = {}) const;
+
+  // Zero-copy variants of find/prefixSearch/range, valid as long as the ones of `Trie`.
+  [[nodiscard]] std::optional<std::string_view> findView(std::string_view key) const;
+  [[nodiscard]] std::vector<std::string_view> findAllView(std::string_view key) const;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string_view>> prefixSearchView(
+      std::string_view prefix,
+      const PrefixSearchOptions& options = {}) const;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string_view>> rangeView(
+      std::string_view from,
+      std::string_view to,
+      const PrefixSearchOptions& options = {}) const;
+
+  [[nodiscard]] bool contains(std::string_view key) const;
+  [[nodiscard]] size_t size() const { return keyCount_; }
+  [[nodiscard]] size_t stateCount() const { return stateCount_; }
+  [[nodiscard]] size_t arcCount() const { return arcCount_; }
+  // the bytes of the states and the arcs, to compare the footprint with the other dictionaries
+  [[nodiscard]] size_t transducerSize() const {
+    return stateCount_ * sizeof(FstState) + arcCount_ * sizeof(FstArc);
+  }
+
+private:
+  // keeps the loaded binary file mapped, the transducer and the value pool below point into it
+  std::unique_ptr<boost::interprocess::mapped_region> region_;
+  const FstState* states_ = nullptr;
+  size_t stateCount_ = 0;
+  const FstArc* arcs_ = nullptr;
+  size_t arcCount_ = 0;
+  std::vector<FstState> ownedStates_;  // if built in memory
+  std::vector<FstArc> ownedArcs_;
+  size_t keyCount_ = 0;
+  std::vector<std::string> data_;        // the values of the keys built in memory, by the key ids
+  ValuePool values_;                     // of the loaded binary file
+  ValuePool::Options valuePoolOptions_;  // how the values are stored in the saved binary file
+  std::string concatSeparator_;
+
+  // a state on the way down the transducer, with the arcs after `nextArc` not taken yet
+  struct Frame {
+    uint32_t state;
+    uint32_t nextArc;  // counted from the first arc of the state
+    uint32_t id;       // the id of the first key reached from the state
+    size_t length;     // of the key of the state
+    bool visited;      // whether the key ending at the state has been visited
+  };
+
+  [[nodiscard]] std::string_view valueAt(size_t id) const;
+  // the arc of the state labeled by the byte, or nullptr
+  [[nodiscard]] const FstArc* arcOf(const FstState& state, unsigned char label) const;
+  // the id of the key, or std::nullopt if it's not in the transducer
+  [[nodiscard]] std::optional<uint32_t> keyIdOf(std::string_view key) const;
+  void setTransducer(const FstState* states,
+                     size_t stateCount,
+                     const FstArc* arcs,
+                     size_t arcCount);
+  // Visits the keys reached from the frames on the stack in the byte order of the keys, i.e. from
+  // the top of the stack, with their ids, until the visitor returns false. `key` holds the bytes
+  // of the frames.
+  template <typename Visitor>
+  void walkDown(std::vector<Frame>& stack, std::string& key, Visitor&& visitor) const;
+  // collects the visited entries, following the offset and the limit of the options
+  template <typename Walk>
+  std::vector<std::pair<std::string, std::string_view>> collect(const PrefixSearchOptions& options,
+                                                                Walk&& walk) const;
+};
+
+}  // namespace rime
@@ -0,0 +1,77 @@
+#include "dicts/fuzzy_matcher.h"
+
+#include <algorithm>
+
+// beyond the max code point 0x10FFFF, to tell the invalid bytes from the valid code points
+constexpr uint32_t INVALID_BYTE_BASE = 0x110000;
+
+size_t decodeUtf8(std::string_view text, size_t pos, uint32_t& codePoint) {
+  const auto lead = static_cast<unsigned char>(text[pos]);
+  size_t length = 0;
+  if (lead < 0x80) {
+    codePoint = lead;
+    return 1;
+  }
+  if ((lead & 0xE0) == 0xC0) {
+    length = 2;
+    codePoint = lead & 0x1F;
+  } else if ((lead & 0xF0) == 0xE0) {
+    length = 3;
+    codePoint = lead & 0x0F;
+  } else if ((lead & 0xF8) == 0xF0) {
+    length = 4;
+    codePoint = lead & 0x07;
+  }
+  if (length == 0 || pos + length > text.size()) {
+    codePoint = INVALID_BYTE_BASE + lead;
+    return 1;
+  }
+  for (size_t i = 1; i < length; ++i) {
+    const auto byte = static_cast<unsigned char>(text[pos + i]);
+    if ((byte & 0xC0) != 0x80) {
+      codePoint = INVALID_BYTE_BASE + lead;
+      return 1;
+    }
+    codePoint = (codePoint << 6) | (byte & 0x3F);
+  }
+  return length;
+}
+
+LevenshteinMatcher::LevenshteinMatcher(std::string_view query, size_t maxDistance)
+    : maxDistance_(maxDistance) {
+  for (size_t pos = 0; pos < query.size();) {
+    uint32_t codePoint = 0;
+    pos += decodeUtf8(query, pos, codePoint);
+    query_.push_back(codePoint);
+  }
+  width_ = query_.size() + 1;
+  rows_.resize(width_);
+  for (size_t i = 0; i < width_; ++i) {
+    rows_[i] = i;  // the distances of the empty key to the prefixes of the query
+  }
+}
+
+bool LevenshteinMatcher::push(uint32_t codePoint) {
+  const size_t previous = rows_.size() - width_;
+  rows_.resize(rows_.size() + width_);
+  const size_t* above = rows_.data() + previous;
+  size_t* row = rows_.data() + previous + width_;
+
+  row[0] = above[0] + 1;
+  size_t minDistance = row[0];
+  for (size_t i = 1; i < width_; ++i) {
+    const size_t substitution = above[i - 1] + (query_[i - 1] == codePoint ? 0 : 1);
+    row[i] = std::min({above[i] + 1, row[i - 1] + 1, substitution});
+    minDistance = std::min(minDistance, row[i]);
+  }
+  return minDistance <= maxDistance_;
+}
+
+void LevenshteinMatcher::truncate(size_t depth) {
+  rows_.resize(std::min(rows_.size(), (depth + 1) * width_));
+}
+
+std::optional<size_t> LevenshteinMatcher::distance() const {
+  const size_t distance = rows_.back();
+  return distance <= maxDistance_ ? std::make_optional(distance) : std::nullopt;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Decodes the code point at the position of a UTF-8 text, and returns its length in bytes. An
+// invalid byte is decoded as a code point of its own, beyond the Unicode range.
+size_t decodeUtf8(std::string_view text, size_t pos, uint32_t& codePoint);
+
+// Computes the Levenshtein distance between a query and a key growing one code point at a time, a
+// row of the dynamic programming table per code point. The rows of a key prefix are kept to be
+// shared by the keys starting with it, as walking down a trie.
+class LevenshteinMatcher {
+public:
+  LevenshteinMatcher(std::string_view query, size_t maxDistance);
+
+  // Appends a code point to the key, and returns false if neither the key nor any key starting
+  // with it is within the max distance, i.e. the branch could be pruned.
+  bool push(uint32_t codePoint);
+  // Keeps the rows of the first `depth` code points of the key.
+  void truncate(size_t depth);
+  [[nodiscard]] size_t depth() const { return rows_.size() / width_ - 1; }
+  // Returns the distance between the query and the key, or std::nullopt beyond the max distance.
+  [[nodiscard]] std::optional<size_t> distance() const;
+
+private:
+  std::vector<uint32_t> query_;
+  size_t maxDistance_;
+  size_t width_;              // query_.size() + 1
+  std::vector<size_t> rows_;  // (depth() + 1) rows of width_ cells
+};
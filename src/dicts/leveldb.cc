@@ -1,39 +1,88 @@
 #include "dicts/leveldb.h"
 
+#include <leveldb/cache.h>
+#include <leveldb/filter_policy.h>
 #include <leveldb/write_batch.h>
+#include <algorithm>
 #include <stdexcept>
 
-LevelDb::~LevelDb() {
-  if (ptr_ != nullptr) {
-    delete ptr_;
-    ptr_ = nullptr;
+#include "thread_pool.hpp"
+
+constexpr size_t MAX_WRITE_BATCH_SIZE = 4 * 1024 * 1024;
+// the keys looked up by a thread of findMany, fewer than the ones of `Trie` as a lookup in the
+// db takes microseconds, walking the memtable and the table blocks and copying the value
+constexpr size_t FIND_MANY_KEYS_PER_THREAD = 1024;
+
+// throws the status of a failed write, e.g. of a full disk, as the db would miss the entries
+static void checkWritten(const leveldb::Status& status, const std::string& filePath) {
+  if (!status.ok()) {
+    throw std::runtime_error("Failed to write LevelDb " + filePath + ": " + status.ToString());
   }
 }
 
+LevelDb::~LevelDb() {
+  // the db is deleted when the prefix iterators opened on it are deleted too
+  ptr_.reset();
+}
+
 void LevelDb::close() {
-  if (ptr_ != nullptr) {
-    delete ptr_;
-    ptr_ = nullptr;
+  if (!shared_) {
+    ptr_.reset();
   }
 }
 
+void LevelDb::open(leveldb::Options options,
+                   const std::string& filePath,
+                   const LevelDbOptions& tuning) {
+  std::shared_ptr<leveldb::Cache> cache;
+  if (tuning.blockCacheSize > 0) {
+    cache.reset(leveldb::NewLRUCache(tuning.blockCacheSize));
+    options.block_cache = cache.get();
+  }
+  std::shared_ptr<const leveldb::FilterPolicy> filterPolicy;
+  if (tuning.bloomFilterBitsPerKey > 0) {
+    filterPolicy.reset(leveldb::NewBloomFilterPolicy(tuning.bloomFilterBitsPerKey));
+    options.filter_policy = filterPolicy.get();
+  }
+  options.compression = tuning.compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+
+  leveldb::DB* db = nullptr;
+  const auto status = leveldb::DB::Open(options, filePath, &db);
+  if (!status.ok()) {
+    throw std::runtime_error("Failed to open LevelDb " + filePath + ": " + status.ToString());
+  }
+  // the db might outlive this object in the prefix iterators, and the cache and the filter policy
+  // should be deleted after it
+  ptr_.reset(db, [cache, filterPolicy](leveldb::DB* db) { delete db; });
+  readOptions_ = leveldb::ReadOptions();
+  readOptions_.fill_cache = tuning.fillCache;
+}
+
 void LevelDb::loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) {
   txtPath_ = txtPath;
   textFileOptions_ = options;
 }
 
 void LevelDb::loadBinaryFile(const std::string& filePath) {
+  loadBinaryFile(filePath, LevelDbOptions{});
+}
+
+void LevelDb::loadBinaryFile(const std::string& filePath, const LevelDbOptions& tuning) {
   leveldb::Options options;
   options.create_if_missing = false;
   options.paranoid_checks = false;  // Disable expensive checks
   options.reuse_logs = true;        // Reuse existing log files
-  leveldb::DB::Open(options, filePath, &ptr_);
+  open(options, filePath, tuning);
 
   auto optSeparator = find(MAGIC_KEY_TO_STORE_CONCAT_SEPARATOR);
   concatSeparator_ = optSeparator.has_value() ? optSeparator.value() : "";
 }
 
 void LevelDb::saveToBinaryFile(const std::string& filePath) {
+  saveToBinaryFile(filePath, LevelDbOptions{});
+}
+
+void LevelDb::saveToBinaryFile(const std::string& filePath, const LevelDbOptions& tuning) {
   if (txtPath_.empty()) {
     throw std::runtime_error("No text file loaded.");
   }
@@ -41,23 +90,41 @@ void LevelDb::saveToBinaryFile(const std::string& filePath) {
     throw std::runtime_error("LevelDb already loaded.");
   }
 
-  std::unordered_map<std::string, std::string> map = parseTextFile(txtPath_, textFileOptions_);
+  leveldb::Options options;
+  options.create_if_missing = true;
+  options.error_if_exists = false;
+  open(options, filePath, tuning);
 
+  writeSortedEntries(filePath);
   if (textFileOptions_.onDuplicatedKey == OnDuplicatedKey::Concat) {
-    map[MAGIC_KEY_TO_STORE_CONCAT_SEPARATOR] = textFileOptions_.concatSeparator;
+    checkWritten(ptr_->Put(leveldb::WriteOptions(), MAGIC_KEY_TO_STORE_CONCAT_SEPARATOR,
+                           textFileOptions_.concatSeparator),
+                 filePath);
   }
+  // merges the tables flushed from the memtables into the sorted levels, so that a lookup reads
+  // one table per level instead of every overlapping table of level 0
+  ptr_->CompactRange(nullptr, nullptr);
+}
 
-  leveldb::WriteBatch batch;
-  for (const auto& entry : map) {
-    batch.Put(entry.first, entry.second);
+void LevelDb::writeSortedEntries(const std::string& filePath) {
+  ParseTextFileOptions options = textFileOptions_;
+  if (options.memoryBudget == 0) {
+    options.memoryBudget = DEFAULT_MEMORY_BUDGET;
   }
-
-  leveldb::Options options;
-  options.create_if_missing = true;
-  options.error_if_exists = false;
-  leveldb::DB::Open(options, filePath, &ptr_);
-  ptr_->Write(leveldb::WriteOptions(), &batch);
-  batch.Clear();
+  // the entries are written in the key order, in batches bounded by the memory budget, so that the
+  // memtables are flushed to the tables without overlapping keys
+  const size_t batchSize = std::min(MAX_WRITE_BATCH_SIZE, options.memoryBudget / 4);
+  leveldb::WriteBatch batch;
+  spilledRuns_ = parseSortedTextFile(txtPath_, options, filePath + ".sort",
+                                     [&](const std::string& key, const std::string& value) {
+                                       batch.Put(key, value);
+                                       if (batch.ApproximateSize() >= batchSize) {
+                                         checkWritten(ptr_->Write(leveldb::WriteOptions(), &batch),
+                                                      filePath);
+                                         batch.Clear();
+                                       }
+                                     });
+  checkWritten(ptr_->Write(leveldb::WriteOptions(), &batch), filePath);
 }
 
 std::optional<std::string> LevelDb::find(const std::string& key) const {
@@ -65,34 +132,120 @@ std::optional<std::string> LevelDb::find(const std::string& key) const {
     throw std::runtime_error("LevelDb not loaded.");
   }
   std::string value;
-  auto status = ptr_->Get(leveldb::ReadOptions(), key, &value);
+  auto status = ptr_->Get(readOptions_, key, &value);
   return status.ok() ? std::make_optional(value) : std::nullopt;
 }
 
-std::vector<std::pair<std::string, std::string>> LevelDb::prefixSearch(
-    const std::string& prefix) const {
+std::vector<std::string> LevelDb::findAll(const std::string& key) const {
+  std::vector<std::string> results;
+  auto value = find(key);
+  if (value.has_value()) {
+    forEachItem(value.value(), concatSeparator_,
+                [&](std::string_view item) { results.emplace_back(item); });
+  }
+  return results;
+}
+
+std::vector<std::optional<std::string>> LevelDb::findMany(
+    const std::vector<std::string>& keys) const {
+  return findMany(keys, FindManyOptions{});
+}
+
+std::vector<std::optional<std::string>> LevelDb::findMany(const std::vector<std::string>& keys,
+                                                          const FindManyOptions& options) const {
   if (ptr_ == nullptr) {
     throw std::runtime_error("LevelDb not loaded.");
   }
+  // the same snapshot for all the keys, even if the db is written meanwhile
+  std::shared_ptr<const leveldb::Snapshot> snapshot(
+      ptr_->GetSnapshot(), [db = ptr_](const leveldb::Snapshot* ptr) { db->ReleaseSnapshot(ptr); });
+  leveldb::ReadOptions readOptions = readOptions_;
+  readOptions.snapshot = snapshot.get();
+
+  std::vector<std::optional<std::string>> values(keys.size());
+  ThreadPool::forEachRange(keys.size(), options.threads, FIND_MANY_KEYS_PER_THREAD,
+                           [&](size_t begin, size_t end) {
+                             std::string value;
+                             for (size_t i = begin; i < end; ++i) {
+                               if (ptr_->Get(readOptions, keys[i], &value).ok()) {
+                                 values[i] = value;
+                               }
+                             }
+                           });
+  return values;
+}
 
+std::vector<std::pair<std::string, std::string>> LevelDb::prefixSearch(
+    const std::string& prefix) const {
+  return prefixSearch(prefix, PrefixSearchOptions{});
+}
+
+std::vector<std::pair<std::string, std::string>> LevelDb::prefixSearch(
+    const std::string& prefix,
+    const PrefixSearchOptions& options) const {
   std::vector<std::pair<std::string, std::string>> results;
-  leveldb::Iterator* it = ptr_->NewIterator(leveldb::ReadOptions());
-  for (it->Seek(prefix); it->Valid(); it->Next()) {
-    std::string key = it->key().ToString();
-    if (key.find(prefix) != 0) {
-      break;
-    }
-    std::string value = it->value().ToString();
+  forEachPrefixMatch(prefix, options, [&](std::string_view key, std::string_view item) {
+    results.emplace_back(key, item);
+  });
+  return results;
+}
 
-    if (!concatSeparator_.empty()) {
-      auto arr = split(value, concatSeparator_);
-      for (auto& item : arr) {
-        results.emplace_back(key, item);
+void LevelDb::forEachPrefixMatch(
+    std::string_view prefix,
+    const PrefixSearchOptions& options,
+    const std::function<void(std::string_view key, std::string_view item)>& visitor) const {
+  if (ptr_ == nullptr) {
+    throw std::runtime_error("LevelDb not loaded.");
+  }
+  std::unique_ptr<leveldb::Iterator> iterator(ptr_->NewIterator(readOptions_));
+  const leveldb::Slice target(prefix.data(), prefix.length());
+  size_t skipped = 0;
+  size_t visited = 0;
+  const auto isFull = [&] { return options.limit > 0 && visited >= options.limit; };
+  for (iterator->Seek(target);
+       !isFull() && iterator->Valid() && iterator->key().starts_with(target); iterator->Next()) {
+    const std::string_view key(iterator->key().data(), iterator->key().size());
+    const std::string_view value(iterator->value().data(), iterator->value().size());
+    forEachItem(value, concatSeparator_, [&](std::string_view item) {
+      if (skipped < options.offset) {
+        ++skipped;
+      } else if (!isFull()) {
+        visitor(key, item);
+        ++visited;
       }
-    } else {
-      results.emplace_back(key, value);
+    });
+  }
+}
+
+std::shared_ptr<LevelDbPrefixIterator> LevelDb::prefixIterator(const std::string& prefix) const {
+  return std::make_shared<LevelDbPrefixIterator>(ptr_, prefix, concatSeparator_, readOptions_);
+}
+
+LevelDbPrefixIterator::LevelDbPrefixIterator(std::shared_ptr<leveldb::DB> db,
+                                             std::string prefix,
+                                             std::string concatSeparator,
+                                             const leveldb::ReadOptions& readOptions)
+    : db_(std::move(db)), prefix_(std::move(prefix)), concatSeparator_(std::move(concatSeparator)) {
+  if (db_ == nullptr) {
+    throw std::runtime_error("LevelDb not loaded.");
+  }
+  iterator_.reset(db_->NewIterator(readOptions));
+  iterator_->Seek(prefix_);
+}
+
+std::optional<std::pair<std::string, std::string>> LevelDbPrefixIterator::next() {
+  while (itemIndex_ >= items_.size()) {
+    if (!iterator_->Valid() || !iterator_->key().starts_with(prefix_)) {
+      return std::nullopt;
     }
+    key_.assign(iterator_->key().data(), iterator_->key().size());
+    value_.assign(iterator_->value().data(), iterator_->value().size());
+    iterator_->Next();
+
+    items_.clear();
+    itemIndex_ = 0;
+    Dictionary::forEachItem(value_, concatSeparator_,
+                            [this](std::string_view item) { items_.push_back(item); });
   }
-  delete it;
-  return results;
+  return std::make_pair(key_, std::string(items_[itemIndex_++]));
 }
@@ -1,14 +1,53 @@
 #pragma once
 
 #include <leveldb/db.h>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "dicts/dictionary.h"
 
+struct LevelDbOptions {
+  // the bytes of the LRU cache of the uncompressed blocks, 0 for the default cache of leveldb (8MB)
+  size_t blockCacheSize = 0;
+  // the bits per key of the bloom filters of the tables, to skip the blocks without a key on the
+  // lookups. 0 for no filters. It should be the same when the db is written and opened.
+  int bloomFilterBitsPerKey = 0;
+  bool compression = true;  // compresses the blocks with snappy when the db is written
+  bool fillCache = true;    // whether the blocks read by the lookups and searches are cached
+};
+
+// Iterates the matches of a prefix search lazily, it keeps the db open until it's deleted.
+class LevelDbPrefixIterator {
+public:
+  LevelDbPrefixIterator(std::shared_ptr<leveldb::DB> db,
+                        std::string prefix,
+                        std::string concatSeparator,
+                        const leveldb::ReadOptions& readOptions = {});
+
+  // Returns the next key and value item, or std::nullopt at the end.
+  std::optional<std::pair<std::string, std::string>> next();
+
+private:
+  std::shared_ptr<leveldb::DB> db_;
+  std::unique_ptr<leveldb::Iterator> iterator_;  // to be deleted before the db
+  std::string prefix_;
+  std::string concatSeparator_;
+  std::string key_;
+  std::string value_;
+  std::vector<std::string_view> items_;  // of value_
+  size_t itemIndex_ = 0;
+};
+
 class LevelDb : public Dictionary {
 public:
+  // the memory to sort the entries of the text file in, if `ParseTextFileOptions::memoryBudget` is
+  // 0, so that a large db is built in bounded memory by default
+  static constexpr size_t DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
   LevelDb() = default;
   LevelDb(const LevelDb&) = delete;
   LevelDb(LevelDb&&) = delete;
@@ -17,17 +56,54 @@ public:
   ~LevelDb() override;
 
   void close();
+  // makes `close` do nothing, for the db shared by DictionaryRegistry, which is closed when its
+  // last user releases it rather than when any of them closes it
+  void markShared() { shared_ = true; }
+  [[nodiscard]] bool isLoaded() const { return ptr_ != nullptr; }
   void loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) override;
   void loadBinaryFile(const std::string& filePath) override;
+  void loadBinaryFile(const std::string& filePath, const LevelDbOptions& options);
   void saveToBinaryFile(const std::string& filePath) override;
+  void saveToBinaryFile(const std::string& filePath, const LevelDbOptions& options);
   [[nodiscard]] std::optional<std::string> find(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::string> findAll(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::optional<std::string>> findMany(
+      const std::vector<std::string>& keys) const override;
+  // Looks up the keys in one snapshot of the db, see `FindManyOptions::threads`.
+  [[nodiscard]] std::vector<std::optional<std::string>> findMany(
+      const std::vector<std::string>& keys,
+      const FindManyOptions& options) const;
   [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
       const std::string& prefix) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix,
+      const PrefixSearchOptions& options) const;
+  // Visits the matches of a prefix search without copying them, the key and the value item point
+  // into the blocks of the db and are only valid in the visitor.
+  void forEachPrefixMatch(
+      std::string_view prefix,
+      const PrefixSearchOptions& options,
+      const std::function<void(std::string_view key, std::string_view item)>& visitor) const;
+  [[nodiscard]] std::shared_ptr<LevelDbPrefixIterator> prefixIterator(
+      const std::string& prefix) const;
+  // the sorted runs spilled to the temporary files by the last `saveToBinaryFile`
+  [[nodiscard]] size_t spilledRuns() const { return spilledRuns_; }
 
 private:
-  leveldb::DB* ptr_ = nullptr;
+  // Opens the db with the cache and the filter policy of the options, which live as long as the
+  // db. Throws std::runtime_error with the status of leveldb if it fails, e.g. of a missing db.
+  void open(leveldb::Options options, const std::string& filePath, const LevelDbOptions& tuning);
+
+  // Bulk loads the entries of the text file, sorted within `ParseTextFileOptions::memoryBudget` or
+  // `DEFAULT_MEMORY_BUDGET`. Throws std::runtime_error with the status of leveldb if a write fails.
+  void writeSortedEntries(const std::string& filePath);
+
+  std::shared_ptr<leveldb::DB> ptr_;
   std::string txtPath_;
   ParseTextFileOptions textFileOptions_;
+  size_t spilledRuns_ = 0;
+  bool shared_ = false;
 
   std::string concatSeparator_;
+  leveldb::ReadOptions readOptions_;
 };
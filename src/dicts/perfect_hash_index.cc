@@ -0,0 +1,229 @@
+#include "dicts/perfect_hash_index.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace rime {
+
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+constexpr uint64_t GOLDEN_RATIO = 0x9e3779b97f4a7c15ULL;
+constexpr uint64_t FINGERPRINT_SEED = 0x5bd1e9955bd1e995ULL;
+constexpr uint64_t BITS_PER_WORD = 64;
+
+// the finalizer of splitmix64, to spread the bits of the hashes of the similar keys
+static uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static uint64_t popcount(uint64_t x) {
+  x -= (x >> 1) & 0x5555555555555555ULL;
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (x * 0x0101010101010101ULL) >> 56;
+}
+
+static bool testBit(const uint64_t* words, uint64_t position) {
+  return ((words[position / BITS_PER_WORD] >> (position % BITS_PER_WORD)) & 1) != 0;
+}
+
+static void setBit(std::vector<uint64_t>& words, uint64_t position) {
+  words[position / BITS_PER_WORD] |= uint64_t{1} << (position % BITS_PER_WORD);
+}
+
+uint64_t PerfectHashIndex::hashOf(std::string_view key) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (const char c : key) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= FNV_PRIME;
+  }
+  return mix(hash);
+}
+
+uint64_t PerfectHashIndex::bitOf(uint64_t hash, size_t level, uint64_t bits) {
+  return mix(hash + (level + 1) * GOLDEN_RATIO) % bits;
+}
+
+uint32_t PerfectHashIndex::fingerprintOf(uint64_t hash) {
+  return static_cast<uint32_t>(mix(hash ^ FINGERPRINT_SEED) >> 32);
+}
+
+void PerfectHashIndex::build(const std::vector<std::pair<uint64_t, uint32_t>>& keys) {
+  clear();
+  if (keys.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Too many keys to be perfect hashed");
+  }
+  std::vector<uint64_t> positions(keys.size());  // of the bits of the keys, once placed
+  std::vector<size_t> remaining(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    remaining[i] = i;
+  }
+  std::vector<size_t> collidedKeys;
+  std::vector<uint64_t> seen;
+  std::vector<uint64_t> collided;
+  ownedLevels_.push_back(0);
+  for (size_t level = 0; !remaining.empty(); ++level) {
+    if (level == MAX_LEVELS) {
+      clear();
+      return;
+    }
+    const auto wanted = static_cast<uint64_t>(GAMMA * static_cast<double>(remaining.size()));
+    const uint64_t words = (std::max(wanted, BITS_PER_WORD) + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    const uint64_t bits = words * BITS_PER_WORD;
+    seen.assign(words, 0);
+    collided.assign(words, 0);
+    for (const size_t i : remaining) {
+      const uint64_t bit = bitOf(keys[i].first, level, bits);
+      if (testBit(seen.data(), bit)) {
+        setBit(collided, bit);
+      } else {
+        setBit(seen, bit);
+      }
+    }
+
+    const uint64_t levelBegin = ownedLevels_.back();
+    collidedKeys.clear();
+    for (const size_t i : remaining) {
+      const uint64_t bit = bitOf(keys[i].first, level, bits);
+      if (testBit(collided.data(), bit)) {
+        collidedKeys.push_back(i);
+      } else {
+        positions[i] = levelBegin + bit;
+      }
+    }
+    for (uint64_t word = 0; word < words; ++word) {
+      ownedWords_.push_back(seen[word] & ~collided[word]);
+    }
+    ownedLevels_.push_back(levelBegin + bits);
+    remaining.swap(collidedKeys);
+  }
+
+  ownedRanks_.reserve(ownedWords_.size());
+  uint64_t rank = 0;
+  for (const uint64_t word : ownedWords_) {
+    ownedRanks_.push_back(static_cast<uint32_t>(rank));
+    rank += popcount(word);
+  }
+  setPointers();  // to rank the bits of the keys
+  ownedSlots_.resize(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ownedSlots_[rankOf(positions[i])] = {keys[i].second, fingerprintOf(keys[i].first)};
+  }
+  setPointers();
+  built_ = true;
+}
+
+void PerfectHashIndex::setPointers() {
+  levels_ = ownedLevels_.data();
+  levelCount_ = ownedLevels_.empty() ? 0 : ownedLevels_.size() - 1;
+  words_ = ownedWords_.data();
+  ranks_ = ownedRanks_.data();
+  wordCount_ = ownedWords_.size();
+  slots_ = ownedSlots_.data();
+  slotCount_ = ownedSlots_.size();
+}
+
+void PerfectHashIndex::clear() {
+  built_ = false;
+  ownedLevels_.clear();
+  ownedWords_.clear();
+  ownedRanks_.clear();
+  ownedSlots_.clear();
+  setPointers();
+}
+
+void PerfectHashIndex::addSections(BinaryFileWriter& writer) const {
+  if (!built_) {
+    return;
+  }
+  writer.requireVersion(binary_format::VALUE_ENCODING_VERSION);
+  writer.addSection(binary_format::SectionType::PerfectHashLevels,
+                    binary_format::DEFAULT_ALIGNMENT, [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(levels_),
+                                      (levelCount_ + 1) * sizeof(uint64_t)});
+                    });
+  writer.addSection(binary_format::SectionType::PerfectHashBits, binary_format::DEFAULT_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(words_),
+                                      wordCount_ * sizeof(uint64_t)});
+                    });
+  writer.addSection(binary_format::SectionType::PerfectHashRanks,
+                    binary_format::DEFAULT_ALIGNMENT, [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(ranks_),
+                                      wordCount_ * sizeof(uint32_t)});
+                    });
+  writer.addSection(binary_format::SectionType::PerfectHashSlots,
+                    binary_format::DEFAULT_ALIGNMENT, [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(slots_),
+                                      slotCount_ * sizeof(PerfectHashSlot)});
+                    });
+}
+
+void PerfectHashIndex::load(const BinaryFileReader& reader, size_t keyCount) {
+  clear();
+  auto levels = reader.findSection(binary_format::SectionType::PerfectHashLevels);
+  if (!levels.has_value()) {
+    return;
+  }
+  auto words = reader.section(binary_format::SectionType::PerfectHashBits);
+  auto ranks = reader.section(binary_format::SectionType::PerfectHashRanks);
+  auto slots = reader.section(binary_format::SectionType::PerfectHashSlots);
+  if (levels->size() < sizeof(uint64_t) || levels->size() % sizeof(uint64_t) != 0 ||
+      words.size() % sizeof(uint64_t) != 0 ||
+      ranks.size() != words.size() / sizeof(uint64_t) * sizeof(uint32_t) ||
+      slots.size() != keyCount * sizeof(PerfectHashSlot)) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  const auto* offsets = reinterpret_cast<const uint64_t*>(levels->data());
+  const size_t levelCount = levels->size() / sizeof(uint64_t) - 1;
+  const size_t wordCount = words.size() / sizeof(uint64_t);
+  // every level is a nonempty run of whole words, ending at the last word
+  if (offsets[0] != 0 || offsets[levelCount] != wordCount * BITS_PER_WORD) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  for (size_t level = 0; level < levelCount; ++level) {
+    if (offsets[level + 1] <= offsets[level] || offsets[level + 1] % BITS_PER_WORD != 0) {
+      throw std::runtime_error("Corrupted data file");
+    }
+  }
+
+  levels_ = offsets;
+  levelCount_ = levelCount;
+  words_ = reinterpret_cast<const uint64_t*>(words.data());
+  ranks_ = reinterpret_cast<const uint32_t*>(ranks.data());
+  wordCount_ = wordCount;
+  slots_ = reinterpret_cast<const PerfectHashSlot*>(slots.data());
+  slotCount_ = keyCount;
+  built_ = true;
+}
+
+uint64_t PerfectHashIndex::rankOf(uint64_t position) const {
+  const uint64_t word = position / BITS_PER_WORD;
+  const uint64_t below = (uint64_t{1} << (position % BITS_PER_WORD)) - 1;
+  return ranks_[word] + popcount(words_[word] & below);
+}
+
+std::optional<uint32_t> PerfectHashIndex::find(std::string_view key) const {
+  const uint64_t hash = hashOf(key);
+  for (size_t level = 0; level < levelCount_; ++level) {
+    const uint64_t position =
+        levels_[level] + bitOf(hash, level, levels_[level + 1] - levels_[level]);
+    if (!testBit(words_, position)) {
+      continue;  // no key or the colliding keys, which are placed in the next levels
+    }
+    const uint64_t rank = rankOf(position);
+    if (rank >= slotCount_ || slots_[rank].fingerprint != fingerprintOf(hash)) {
+      return std::nullopt;
+    }
+    return slots_[rank].keyId;
+  }
+  return std::nullopt;
+}
+
+}  // namespace rime
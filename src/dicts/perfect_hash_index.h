@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "dicts/binary_format.h"
+
+namespace rime {
+
+// A minimal perfect hash of the keys of a trie to their ids, in the style of BBHash, to find a key
+// in O(1) without walking the trie. Each level is a bit array of `GAMMA` bits per key left to it,
+// where a key hashed to a bit of its own sets it, and the keys colliding on a bit are left to the
+// next level. The rank of the set bit of a key among all the levels is its slot, holding its id
+// and a fingerprint of its hash to reject the keys not in the trie, which are mistaken for a key
+// with the probability of 1 / 2^32. The levels and their ranks take about 5 bits per key besides
+// the 8-byte slots.
+class PerfectHashIndex {
+public:
+  static constexpr double GAMMA = 2.0;
+  // the keys still colliding after the levels are too many for the hash, e.g. of the same hash
+  static constexpr size_t MAX_LEVELS = 32;
+
+  [[nodiscard]] static uint64_t hashOf(std::string_view key);
+
+  // Builds the index from the hashes of the keys and their ids. The index is left unbuilt if some
+  // keys could not be placed, e.g. the ones of the same hash, so that the keys are found in the
+  // trie as if it's built without the index.
+  void build(const std::vector<std::pair<uint64_t, uint32_t>>& keys);
+  void clear();
+
+  void addSections(BinaryFileWriter& writer) const;
+  // Points to the sections in the mapped file, or clears the index if the file has no such
+  // sections. Throws std::runtime_error if the sections are corrupted.
+  void load(const BinaryFileReader& reader, size_t keyCount);
+
+  [[nodiscard]] bool isBuilt() const { return built_; }
+  [[nodiscard]] size_t size() const { return slotCount_; }
+  // the bytes of the levels, the ranks and the slots
+  [[nodiscard]] size_t byteSize() const {
+    return (levelCount_ + 1) * sizeof(uint64_t) +
+           wordCount_ * (sizeof(uint64_t) + sizeof(uint32_t)) +
+           slotCount_ * sizeof(PerfectHashSlot);
+  }
+  // Returns the id of the key, or std::nullopt if it's not one of the keys.
+  [[nodiscard]] std::optional<uint32_t> find(std::string_view key) const;
+
+private:
+  // the bit of the hash in a level of the bits, counted from the first bit of the level
+  [[nodiscard]] static uint64_t bitOf(uint64_t hash, size_t level, uint64_t bits);
+  [[nodiscard]] static uint32_t fingerprintOf(uint64_t hash);
+  // the set bits before the position, counted from the first bit of the first level
+  [[nodiscard]] uint64_t rankOf(uint64_t position) const;
+  void setPointers();
+
+  bool built_ = false;
+  const uint64_t* levels_ = nullptr;  // levelCount_ + 1 bit offsets of the levels
+  size_t levelCount_ = 0;
+  const uint64_t* words_ = nullptr;  // the bits of all the levels
+  const uint32_t* ranks_ = nullptr;  // the set bits before each word
+  size_t wordCount_ = 0;
+  const PerfectHashSlot* slots_ = nullptr;  // in the ranks of the set bits of the keys
+  size_t slotCount_ = 0;
+  std::vector<uint64_t> ownedLevels_;
+  std::vector<uint64_t> ownedWords_;
+  std::vector<uint32_t> ownedRanks_;
+  std::vector<PerfectHashSlot> ownedSlots_;
+};
+
+}  // namespace rime
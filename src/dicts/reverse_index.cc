@@ -0,0 +1,64 @@
+#include "dicts/reverse_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rime {
+
+void ReverseIndex::build(std::vector<ReverseEntry> entries, const ItemAt& itemAt) {
+  std::sort(entries.begin(), entries.end(), [&](const ReverseEntry& a, const ReverseEntry& b) {
+    const int order = itemAt(a).compare(itemAt(b));
+    return order != 0 ? order < 0 : a.keyId < b.keyId;
+  });
+  ownedEntries_ = std::move(entries);
+  entries_ = ownedEntries_.data();
+  size_ = ownedEntries_.size();
+  built_ = true;
+}
+
+void ReverseIndex::clear() {
+  built_ = false;
+  entries_ = nullptr;
+  size_ = 0;
+  ownedEntries_.clear();
+}
+
+void ReverseIndex::addSections(BinaryFileWriter& writer) const {
+  if (!built_) {
+    return;
+  }
+  writer.addSection(binary_format::SectionType::ReverseIndex, binary_format::DEFAULT_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(entries_),
+                                      size_ * sizeof(ReverseEntry)});
+                    });
+}
+
+void ReverseIndex::load(const BinaryFileReader& reader) {
+  clear();
+  auto entries = reader.findSection(binary_format::SectionType::ReverseIndex);
+  if (!entries.has_value()) {
+    return;
+  }
+  if (entries->size() % sizeof(ReverseEntry) != 0) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  entries_ = reinterpret_cast<const ReverseEntry*>(entries->data());
+  size_ = entries->size() / sizeof(ReverseEntry);
+  built_ = true;
+}
+
+std::vector<ReverseEntry> ReverseIndex::find(std::string_view text, const ItemAt& itemAt) const {
+  const auto* end = entries_ + size_;
+  const auto* first = std::lower_bound(
+      entries_, end, text, [&](const ReverseEntry& entry, std::string_view value) {
+        return itemAt(entry) < value;
+      });
+  std::vector<ReverseEntry> results;
+  for (const auto* it = first; it != end && itemAt(*it) == text; ++it) {
+    results.push_back(*it);
+  }
+  return results;
+}
+
+}  // namespace rime
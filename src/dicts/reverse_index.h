@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "dicts/binary_format.h"
+
+namespace rime {
+
+// Maps the value items of a trie back to their keys, e.g. a Hanzi to its pinyin in a pinyin to
+// Hanzi dictionary, without loading the reversed text file into another trie. The entries only
+// refer to the key ids and the items of the values, sorted by the texts of the items, so the texts
+// are shared with the value pool and the keys with the trie, and an item is found by a binary
+// search.
+class ReverseIndex {
+public:
+  // the text of the value item referred to by an entry
+  using ItemAt = std::function<std::string_view(const ReverseEntry&)>;
+
+  // Builds the index from the entries of all the value items.
+  void build(std::vector<ReverseEntry> entries, const ItemAt& itemAt);
+  void clear();
+
+  void addSections(BinaryFileWriter& writer) const;
+  // Points to the section in the mapped file, or clears the index if the file has no such section.
+  // Throws std::runtime_error if the section is corrupted.
+  void load(const BinaryFileReader& reader);
+
+  [[nodiscard]] bool isBuilt() const { return built_; }
+  // Returns the entries of the items equal to the text, in the ascending order of the key ids.
+  [[nodiscard]] std::vector<ReverseEntry> find(std::string_view text, const ItemAt& itemAt) const;
+
+private:
+  bool built_ = false;
+  const ReverseEntry* entries_ = nullptr;
+  size_t size_ = 0;
+  std::vector<ReverseEntry> ownedEntries_;
+};
+
+}  // namespace rime
@@ -0,0 +1,248 @@
+#include "dicts/sharded_trie.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "dicts/binary_format.h"
+#include "dicts/perfect_hash_index.h"
+
+namespace rime {
+
+// by the same hash as the perfect hash index, which is stable across the platforms, as the keys
+// are looked up in the shards they're saved to
+static size_t shardIndexOf(std::string_view key, size_t shards) {
+  return static_cast<size_t>(PerfectHashIndex::hashOf(key) % shards);
+}
+
+ShardedTrie::ShardedTrie(const ShardedTrieOptions& options)
+    : shardsToBuild_(std::max<size_t>(options.shards, 1)), threads_(options.threads) {
+  resizePool(shardsToBuild_);
+}
+
+void ShardedTrie::resizePool(size_t shards) {
+  const size_t threads = std::min(ThreadPool::resolveThreadCount(threads_), shards);
+  if (threads <= 1) {
+    pool_.reset();
+  } else if (!pool_ || pool_->size() != threads) {
+    pool_ = std::make_unique<ThreadPool>(threads);
+  }
+}
+
+template <typename Task>
+void ShardedTrie::forEachShard(size_t shards, Task&& task) const {
+  if (!pool_ || shards <= 1) {
+    for (size_t i = 0; i < shards; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(shards);
+  for (size_t i = 0; i < shards; ++i) {
+    futures.push_back(pool_->submit([&task, i] { task(i); }));
+  }
+  // all the tasks are waited for, as they refer to the task
+  std::exception_ptr error;
+  for (auto& future : futures) {
+    try {
+      future.get();
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ShardedTrie::loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) {
+  auto map = parseTextFile(txtPath, options);
+  const size_t keyCount = map.size();
+  std::vector<std::unordered_map<std::string, std::string>> parts(shardsToBuild_);
+  while (!map.empty()) {
+    auto node = map.extract(map.begin());
+    parts[shardIndexOf(node.key(), parts.size())].insert(std::move(node));
+  }
+
+  std::vector<std::unique_ptr<Trie>> shards(parts.size());
+  resizePool(shards.size());
+  forEachShard(shards.size(), [&](size_t i) {
+    shards[i] = std::make_unique<Trie>();
+    shards[i]->build(parts[i], options);
+  });
+  shards_ = std::move(shards);
+  keyCount_ = keyCount;
+}
+
+void ShardedTrie::loadBinaryFile(const std::string& filePath) {
+  loadBinaryFile(filePath, TrieLoadOptions{});
+}
+
+void ShardedTrie::loadBinaryFile(const std::string& filePath, const TrieLoadOptions& options) {
+  std::string manifest;
+  {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Failed to open file " + filePath);
+    }
+    manifest.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  if (!BinaryFileReader::isBinaryFile(manifest.data(), manifest.size())) {
+    throw std::runtime_error("Not a sharded trie file: " + filePath);
+  }
+  BinaryFileReader reader(manifest.data(), manifest.size());
+  if (reader.header().layout != binary_format::Layout::ShardedTrie) {
+    throw std::runtime_error("Not a sharded trie file: " + filePath);
+  }
+  auto section = reader.section(binary_format::SectionType::ShardCount);
+  uint64_t shardCount = 0;
+  if (section.size() != sizeof(shardCount)) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  std::memcpy(&shardCount, section.data(), sizeof(shardCount));
+  if (shardCount == 0) {
+    throw std::runtime_error("Corrupted data file");
+  }
+
+  std::vector<std::unique_ptr<Trie>> shards(shardCount);
+  resizePool(shards.size());
+  forEachShard(shards.size(), [&](size_t i) {
+    shards[i] = std::make_unique<Trie>();
+    shards[i]->loadBinaryFile(shardPathOf(filePath, i), options);
+  });
+  shards_ = std::move(shards);
+  keyCount_ = reader.header().entryCount;
+}
+
+void ShardedTrie::saveToBinaryFile(const std::string& filePath) {
+  if (shards_.empty()) {
+    throw std::runtime_error("No trie loaded.");
+  }
+  forEachShard(shards_.size(),
+               [&](size_t i) { shards_[i]->saveToBinaryFile(shardPathOf(filePath, i)); });
+  // the shards of a previous file with more shards
+  std::error_code error;
+  for (size_t i = shards_.size(); std::filesystem::exists(shardPathOf(filePath, i)); ++i) {
+    std::filesystem::remove(shardPathOf(filePath, i), error);
+  }
+
+  BinaryFileWriter writer(binary_format::Layout::ShardedTrie, keyCount_, keyCount_);
+  const uint64_t shardCount = shards_.size();
+  writer.addSection(binary_format::SectionType::ShardCount, binary_format::DEFAULT_ALIGNMENT,
+                    [shardCount](auto& out) { out.writeValue(shardCount); });
+  // written last, so that the file is replaced after all the shards
+  writer.writeFile(filePath);
+}
+
+const Trie* ShardedTrie::shardOf(std::string_view key) const {
+  return shards_.empty() ? nullptr : shards_[shardIndexOf(key, shards_.size())].get();
+}
+
+std::optional<std::string> ShardedTrie::find(const std::string& key) const {
+  const auto* shard = shardOf(key);
+  return shard != nullptr ? shard->find(key) : std::nullopt;
+}
+
+std::vector<std::string> ShardedTrie::findAll(const std::string& key) const {
+  const auto* shard = shardOf(key);
+  return shard != nullptr ? shard->findAll(key) : std::vector<std::string>{};
+}
+
+std::vector<std::optional<std::string>> ShardedTrie::findMany(
+    const std::vector<std::string>& keys) const {
+  std::vector<std::optional<std::string>> values;
+  values.reserve(keys.size());
+  for (const auto& key : keys) {
+    values.push_back(find(key));
+  }
+  return values;
+}
+
+bool ShardedTrie::contains(std::string_view key) const {
+  const auto* shard = shardOf(key);
+  return shard != nullptr && shard->contains(key);
+}
+
+std::vector<std::pair<std::string, std::string>> ShardedTrie::prefixSearch(
+    const std::string& prefix) const {
+  return prefixSearch(prefix, {});
+}
+
+std::vector<std::pair<std::string, std::string>> ShardedTrie::prefixSearch(
+    const std::string& prefix,
+    const PrefixSearchOptions& options) const {
+  // the first offset + limit matches of every shard are enough for the merged ones, in the byte
+  // order of the keys with the items of a key kept in order
+  const bool unlimited =
+      options.limit == 0 || options.offset > std::numeric_limits<size_t>::max() - options.limit;
+  const size_t limit = unlimited ? 0 : options.offset + options.limit;
+  std::vector<std::vector<std::pair<std::string, std::string>>> matches(shards_.size());
+  forEachShard(shards_.size(),
+               [&](size_t i) { matches[i] = shards_[i]->prefixSearchInKeyOrder(prefix, limit); });
+
+  // merged by the next match of every shard, and a key is in only one of the shards
+  using Cursor = std::pair<size_t, size_t>;  // the shard and the match in it
+  const auto after = [&](const Cursor& a, const Cursor& b) {
+    const auto& keyA = matches[a.first][a.second].first;
+    const auto& keyB = matches[b.first][b.second].first;
+    return keyA > keyB || (keyA == keyB && a.first > b.first);
+  };
+  std::priority_queue<Cursor, std::vector<Cursor>, decltype(after)> cursors(after);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    if (!matches[i].empty()) {
+      cursors.emplace(i, 0);
+    }
+  }
+  std::vector<std::pair<std::string, std::string>> results;
+  size_t skipped = 0;
+  while (!cursors.empty() && (options.limit == 0 || results.size() < options.limit)) {
+    const auto [shard, index] = cursors.top();
+    cursors.pop();
+    if (skipped < options.offset) {
+      ++skipped;
+    } else {
+      results.push_back(std::move(matches[shard][index]));
+    }
+    if (index + 1 < matches[shard].size()) {
+      cursors.emplace(shard, index + 1);
+    }
+  }
+  return results;
+}
+
+std::vector<ShardedWeightedMatch> ShardedTrie::topK(std::string_view prefix, size_t k) const {
+  std::vector<std::vector<ShardedWeightedMatch>> matches(shards_.size());
+  forEachShard(shards_.size(), [&](size_t i) {
+    // the values are copied before another search of the shard may evict them
+    const auto pin = shards_[i]->pinValues();
+    for (auto& match : shards_[i]->topK(prefix, k)) {
+      matches[i].push_back({std::move(match.key), std::string(match.value), match.weight});
+    }
+  });
+
+  std::vector<ShardedWeightedMatch> results;
+  for (auto& shardMatches : matches) {
+    std::move(shardMatches.begin(), shardMatches.end(), std::back_inserter(results));
+  }
+  std::stable_sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+    return a.weight > b.weight || (a.weight == b.weight && a.key < b.key);
+  });
+  if (results.size() > k) {
+    results.resize(k);
+  }
+  return results;
+}
+
+}  // namespace rime
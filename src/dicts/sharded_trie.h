@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "dicts/dictionary.h"
+#include "dicts/trie.h"
+#include "thread_pool.hpp"
+
+namespace rime {
+
+struct ShardedTrieOptions {
+  // the sub-tries the keys are hashed into when built from a text file, a loaded binary file keeps
+  // the shards it's saved with
+  size_t shards = 4;
+  // the threads to search the shards concurrently, 0 for a thread per shard up to the hardware
+  // threads, 1 to search them in the calling thread
+  size_t threads = 0;
+};
+
+// the same as `WeightedMatch`, with the value copied out of its shard
+struct ShardedWeightedMatch {
+  std::string key;
+  std::string value;  // the whole value of the key
+  double weight = 0;
+};
+
+// A dictionary of the keys partitioned into several tries by the hashes of the keys, so that the
+// keys of any prefix are spread evenly over the shards, and the long prefix searches, e.g. of a
+// single letter in a dictionary of millions of keys, walk the shards concurrently on a small
+// thread pool. The exact lookups only walk the shard of the key. The results of the shards are
+// merged in a deterministic order regardless of the shards and the threads. The shards are saved
+// to the files `<path>.<index>` beside the file of the path, which records the shard count.
+class ShardedTrie : public Dictionary {
+public:
+  explicit ShardedTrie(const ShardedTrieOptions& options = {});
+
+  void loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) override;
+  void loadBinaryFile(const std::string& filePath) override;
+  void loadBinaryFile(const std::string& filePath, const TrieLoadOptions& options);
+  void saveToBinaryFile(const std::string& filePath) override;
+
+  [[nodiscard]] std::optional<std::string> find(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::string> findAll(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::optional<std::string>> findMany(
+      const std::vector<std::string>& keys) const override;
+  // Returns the matches in the byte order of the keys, and the items of a concatenated value in
+  // their order. The offset and the limit apply to the merged matches, so every shard collects its
+  // first offset + limit matches of the prefix in the key order, or all of them without a limit.
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix,
+      const PrefixSearchOptions& options) const;
+  // the same as `Trie::topK`, of the k heaviest keys of every shard
+  [[nodiscard]] std::vector<ShardedWeightedMatch> topK(std::string_view prefix, size_t k) const;
+
+  [[nodiscard]] bool contains(std::string_view key) const;
+  [[nodiscard]] size_t size() const { return keyCount_; }
+  [[nodiscard]] size_t shardCount() const { return shards_.size(); }
+  [[nodiscard]] size_t threadCount() const { return pool_ ? pool_->size() : 1; }
+
+  [[nodiscard]] static std::string shardPathOf(const std::string& filePath, size_t index) {
+    return filePath + "." + std::to_string(index);
+  }
+
+private:
+  size_t shardsToBuild_;
+  size_t threads_;
+  std::vector<std::unique_ptr<Trie>> shards_;  // empty until loaded
+  size_t keyCount_ = 0;
+  // shared by the searches of all the shards, or nullptr to search them in the calling thread
+  std::unique_ptr<ThreadPool> pool_;
+
+  // the shard of the key, or nullptr if nothing is loaded
+  [[nodiscard]] const Trie* shardOf(std::string_view key) const;
+  // resizes the pool to search the shards, with a thread per shard at most
+  void resizePool(size_t shards);
+  // Runs the task on every shard index concurrently, and waits for all of them. The first
+  // exception of the tasks is rethrown.
+  template <typename Task>
+  void forEachShard(size_t shards, Task&& task) const;
+};
+
+}  // namespace rime
@@ -0,0 +1,312 @@
+#include "dicts/sorted_text_dictionary.h"
+
+#include <boost/crc.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace rime {
+
+void SortedTextDictionary::loadTextFile(const std::string& txtPath,
+                                        const ParseTextFileOptions& options) {
+  if (options.isReversed) {
+    throw std::runtime_error("The reversed text file is not sorted by the keys: " + txtPath);
+  }
+  // loaded aside, so that the loaded file is kept if it fails
+  SortedTextDictionary loaded;
+  loaded.path_ = txtPath;
+  loaded.options_ = options;
+  loaded.charsToRemove_ = ByteSetScanner(options.charsToRemove);
+  if (std::filesystem::file_size(txtPath) > 0) {  // an empty file could not be mapped
+    loaded.textMapping_ = std::make_unique<boost::interprocess::file_mapping>(
+        txtPath.c_str(), boost::interprocess::read_only);
+    loaded.textRegion_ = std::make_unique<boost::interprocess::mapped_region>(
+        *loaded.textMapping_, boost::interprocess::read_only);
+    loaded.text_ = std::string_view(static_cast<const char*>(loaded.textRegion_->get_address()),
+                                    loaded.textRegion_->get_size());
+  }
+
+  const SortedTextSource source = loaded.sourceOf(txtPath);
+  if (source.size != loaded.text_.size()) {
+    throw std::runtime_error("The text file was modified while being loaded: " + txtPath);
+  }
+  const std::string indexPath = indexPathOf(txtPath);
+  if (!loaded.loadIndex(indexPath, source)) {
+    loaded.buildIndex(indexPath, source);
+  }
+  *this = std::move(loaded);
+}
+
+void SortedTextDictionary::loadBinaryFile(const std::string& filePath) {
+  loadTextFile(filePath, ParseTextFileOptions{});
+}
+
+void SortedTextDictionary::saveToBinaryFile(const std::string& filePath) {
+  if (path_.empty()) {
+    throw std::runtime_error("No text file loaded.");
+  }
+  if (std::filesystem::exists(filePath) && std::filesystem::equivalent(path_, filePath)) {
+    return;
+  }
+  // copy to a temporary file and rename it, so that the existing mappings of the file stay valid
+  const std::string tempPath = filePath + ".temp";
+  std::filesystem::copy_file(path_, tempPath, std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::rename(tempPath, filePath);
+}
+
+SortedTextSource SortedTextDictionary::sourceOf(const std::string& txtPath) const {
+  boost::crc_32_type crc;
+  for (const auto* option : {&options_.delimiter, &options_.comment, &options_.charsToRemove}) {
+    crc.process_bytes(option->c_str(), option->length() + 1);  // with the terminating null
+  }
+  return {
+      static_cast<uint64_t>(std::filesystem::file_size(txtPath)),
+      static_cast<int64_t>(std::filesystem::last_write_time(txtPath).time_since_epoch().count()),
+      INDEX_STRIDE,
+      crc.checksum(),
+  };
+}
+
+bool SortedTextDictionary::loadIndex(const std::string& indexPath,
+                                     const SortedTextSource& source) {
+  if (!std::filesystem::exists(indexPath)) {
+    return false;
+  }
+  try {
+    boost::interprocess::file_mapping mapping(indexPath.c_str(), boost::interprocess::read_only);
+    auto region = std::make_unique<boost::interprocess::mapped_region>(
+        mapping, boost::interprocess::read_only);
+    BinaryFileReader reader(region->get_address(), region->get_size());
+    if (reader.header().layout != binary_format::Layout::SortedTextIndex) {
+      return false;
+    }
+    auto indexed = reader.section(binary_format::SectionType::SortedTextSource);
+    auto lines = reader.section(binary_format::SectionType::SortedTextLines);
+    if (indexed.size() != sizeof(SortedTextSource) ||
+        std::memcmp(indexed.data(), &source, sizeof(SortedTextSource)) != 0 ||
+        lines.size() % sizeof(uint64_t) != 0) {
+      return false;  // stale
+    }
+    keyCount_ = reader.header().entryCount;
+    indexRegion_ = std::move(region);
+    lines_ = reinterpret_cast<const uint64_t*>(lines.data());
+    lineCount_ = lines.size() / sizeof(uint64_t);
+    ownedLines_.clear();
+    return true;
+  } catch (const std::exception&) {
+    return false;  // corrupted, to be rebuilt
+  }
+}
+
+void SortedTextDictionary::buildIndex(const std::string& indexPath,
+                                      const SortedTextSource& source) {
+  TextLineScanner scanner(text_, options_.delimiter, charsToRemove_);
+  TextLine line;
+  std::string buffer;
+  std::string key;
+  std::string value;
+  std::string previous;
+  size_t entries = 0;
+  ownedLines_.clear();
+  keyCount_ = 0;
+  while (scanner.next(line)) {
+    if (!parseLine(line, options_, charsToRemove_, buffer, key, value)) {
+      continue;
+    }
+    if (entries > 0 && key < previous) {
+      throw std::runtime_error("The text file is not sorted by the keys: " + path_ + ", at " +
+                               key);
+    }
+    if (entries == 0 || key != previous) {
+      ++keyCount_;
+      previous.swap(key);
+    }
+    if (entries++ % INDEX_STRIDE == 0) {
+      ownedLines_.push_back(static_cast<uint64_t>(line.text.data() - text_.data()));
+    }
+  }
+  indexRegion_.reset();
+  lines_ = ownedLines_.data();
+  lineCount_ = ownedLines_.size();
+
+  BinaryFileWriter writer(binary_format::Layout::SortedTextIndex, keyCount_, entries);
+  writer.addSection(binary_format::SectionType::SortedTextSource,
+                    binary_format::DEFAULT_ALIGNMENT,
+                    [&source](auto& out) { out.writeValue(source); });
+  writer.addSection(binary_format::SectionType::SortedTextLines, binary_format::DEFAULT_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(lines_),
+                                      lineCount_ * sizeof(uint64_t)});
+                    });
+  // the index is only kept in memory if it could not be cached, e.g. in a read-only folder
+  const std::string tempPath = indexPath + ".temp";
+  std::error_code error;
+  {
+    std::ofstream file(tempPath, std::ios::binary);
+    if (!file) {
+      return;
+    }
+    writer.write(file);
+    if (!file) {
+      file.close();
+      std::filesystem::remove(tempPath, error);
+      return;
+    }
+  }
+  std::filesystem::rename(tempPath, indexPath, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+  }
+}
+
+void SortedTextDictionary::scanFrom(
+    std::string_view key,
+    const std::function<bool(const std::string&, std::string&&)>& visitor) const {
+  if (lineCount_ == 0) {
+    return;
+  }
+#ifndef _WIN32
+  // the mapped pages beyond the end of a file truncated in place could not be read, while a mapped
+  // file could not be truncated on Windows
+  struct stat status {};
+  if (!textMapping_ || ::fstat(textMapping_->get_mapping_handle().handle, &status) != 0 ||
+      static_cast<size_t>(status.st_size) != text_.size()) {
+    throw std::runtime_error("The text file has been modified since it was loaded: " + path_);
+  }
+#endif
+  std::string buffer;
+  std::string lineKey;
+  std::string value;
+  TextLine line;
+  const auto parseLineAt = [&](size_t index) {
+    if (lines_[index] >= text_.size()) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    TextLineScanner scanner(text_.substr(lines_[index]), options_.delimiter, charsToRemove_);
+    if (!scanner.next(line) ||
+        !parseLine(line, options_, charsToRemove_, buffer, lineKey, value)) {
+      throw std::runtime_error("Corrupted data file");
+    }
+  };
+
+  // the last sampled line before the key, as the lines of the key could start before the next one
+  size_t low = 0;
+  size_t high = lineCount_;
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    parseLineAt(middle);
+    if (lineKey < key) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  const size_t start = low > 0 ? low - 1 : 0;
+
+  TextLineScanner scanner(text_.substr(lines_[start]), options_.delimiter, charsToRemove_);
+  while (scanner.next(line)) {
+    if (!parseLine(line, options_, charsToRemove_, buffer, lineKey, value) || lineKey < key) {
+      continue;
+    }
+    if (!visitor(lineKey, std::move(value))) {
+      return;
+    }
+  }
+}
+
+std::optional<std::string> SortedTextDictionary::find(const std::string& key) const {
+  std::optional<std::string> result;
+  scanFrom(key, [&](const std::string& lineKey, std::string&& value) {
+    if (lineKey != key) {
+      return false;
+    }
+    if (result.has_value()) {
+      mergeDuplicatedValue(result.value(), std::move(value), options_);
+    } else {
+      result = std::move(value);
+    }
+    return true;
+  });
+  return result;
+}
+
+bool SortedTextDictionary::contains(const std::string& key) const {
+  bool found = false;
+  scanFrom(key, [&](const std::string& lineKey, std::string&&) {
+    found = lineKey == key;
+    return false;
+  });
+  return found;
+}
+
+std::vector<std::string> SortedTextDictionary::findAll(const std::string& key) const {
+  std::vector<std::string> results;
+  if (auto value = find(key)) {
+    forEachItem(value.value(), concatSeparator(),
+                [&](std::string_view item) { results.emplace_back(item); });
+  }
+  return results;
+}
+
+std::vector<std::optional<std::string>> SortedTextDictionary::findMany(
+    const std::vector<std::string>& keys) const {
+  std::vector<std::optional<std::string>> values;
+  values.reserve(keys.size());
+  for (const auto& key : keys) {
+    values.push_back(find(key));
+  }
+  return values;
+}
+
+std::vector<std::pair<std::string, std::string>> SortedTextDictionary::prefixSearch(
+    const std::string& prefix) const {
+  return prefixSearch(prefix, {});
+}
+
+std::vector<std::pair<std::string, std::string>> SortedTextDictionary::prefixSearch(
+    const std::string& prefix,
+    const PrefixSearchOptions& options) const {
+  std::vector<std::pair<std::string, std::string>> results;
+  // the entry of the last key, to merge the values of the following lines of it
+  std::optional<std::pair<std::string, std::string>> pending;
+  size_t skipped = 0;
+  const auto isFull = [&] { return options.limit > 0 && results.size() >= options.limit; };
+  // a result per item of the concatenated values, the same as `Trie::prefixSearch`
+  const auto flush = [&]() {
+    if (pending.has_value()) {
+      forEachItem(pending->second, concatSeparator(), [&](std::string_view item) {
+        if (skipped < options.offset) {
+          ++skipped;
+        } else if (!isFull()) {
+          results.emplace_back(pending->first, item);
+        }
+      });
+      pending.reset();
+    }
+    return !isFull();
+  };
+  scanFrom(prefix, [&](const std::string& key, std::string&& value) {
+    if (key.compare(0, prefix.length(), prefix) != 0) {
+      return false;
+    }
+    if (pending.has_value() && pending->first == key) {
+      mergeDuplicatedValue(pending->second, std::move(value), options_);
+      return true;
+    }
+    if (!flush()) {
+      return false;
+    }
+    pending.emplace(key, std::move(value));
+    return true;
+  });
+  flush();
+  return results;
+}
+
+}  // namespace rime
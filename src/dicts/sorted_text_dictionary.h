@@ -0,0 +1,93 @@
+#pragma once
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "dicts/binary_format.h"
+#include "dicts/dictionary.h"
+#include "dicts/text_scanner.h"
+
+namespace rime {
+
+// A dictionary served from a text file sorted by the keys in the byte order (e.g. by
+// `LC_ALL=C sort`), without building a binary file. The text file is mapped as-is, and the keys are
+// binary searched on a sparse index of the offsets of every `INDEX_STRIDE` entry lines, which is
+// cached in the `.idx` file beside the text file and rebuilt once the text file is modified. The
+// text file should be replaced by renaming a new one over it rather than rewritten in place, as it
+// stays mapped until it's reloaded.
+class SortedTextDictionary : public Dictionary {
+public:
+  static constexpr uint32_t INDEX_STRIDE = 16;
+  static constexpr const char* INDEX_FILE_SUFFIX = ".idx";
+
+  // Maps the text file, and loads or builds its index. The duplicated keys should be on adjacent
+  // lines, and their values are merged on lookups following `onDuplicatedKey`. Throws
+  // std::runtime_error if the keys are not sorted, or the options are `isReversed`, for the lines
+  // are not sorted by the values. `lines` and the options of building binary files are ignored.
+  void loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) override;
+  // the same as `loadTextFile` with the default options, as the text file is the dictionary file
+  void loadBinaryFile(const std::string& filePath) override;
+  // copies the text file as-is, the index is built when the copy is loaded
+  void saveToBinaryFile(const std::string& filePath) override;
+
+  [[nodiscard]] std::optional<std::string> find(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::string> findAll(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::optional<std::string>> findMany(
+      const std::vector<std::string>& keys) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix,
+      const PrefixSearchOptions& options) const;
+
+  [[nodiscard]] bool contains(const std::string& key) const;
+  [[nodiscard]] size_t size() const { return keyCount_; }
+  // the bytes of the index in memory, besides the mapped text file
+  [[nodiscard]] size_t indexSize() const { return lineCount_ * sizeof(uint64_t); }
+
+  [[nodiscard]] static std::string indexPathOf(const std::string& txtPath) {
+    return txtPath + INDEX_FILE_SUFFIX;
+  }
+
+private:
+  std::string path_;
+  ParseTextFileOptions options_;
+  ByteSetScanner charsToRemove_{""};
+  // kept open to check the size of the mapped file, rather than of the one renamed over it
+  std::unique_ptr<boost::interprocess::file_mapping> textMapping_;
+  std::unique_ptr<boost::interprocess::mapped_region> textRegion_;
+  std::string_view text_;  // the mapped text file
+  std::unique_ptr<boost::interprocess::mapped_region> indexRegion_;
+  const uint64_t* lines_ = nullptr;  // the offsets of the sampled entry lines, in the text file
+  size_t lineCount_ = 0;
+  std::vector<uint64_t> ownedLines_;  // if the index could not be cached
+  size_t keyCount_ = 0;
+
+  [[nodiscard]] std::string_view concatSeparator() const {
+    return options_.onDuplicatedKey == OnDuplicatedKey::Concat
+               ? std::string_view(options_.concatSeparator)
+               : std::string_view();
+  }
+  [[nodiscard]] SortedTextSource sourceOf(const std::string& txtPath) const;
+  // maps the cached index if it's built from the same text file with the same options
+  bool loadIndex(const std::string& indexPath, const SortedTextSource& source);
+  // scans the text file to build the index, and caches it unless the folder is read-only
+  void buildIndex(const std::string& indexPath, const SortedTextSource& source);
+
+  // Visits the entries with the keys not less than the key in the order of the lines, until the
+  // visitor returns false, starting from the sampled line before the first of them. Throws
+  // std::runtime_error if the mapped file is rewritten in place to another size.
+  void scanFrom(std::string_view key,
+                const std::function<bool(const std::string&, std::string&&)>& visitor) const;
+};
+
+}  // namespace rime
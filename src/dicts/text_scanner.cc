@@ -0,0 +1,148 @@
+#include "dicts/text_scanner.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCANNER_USE_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+[[maybe_unused]] static unsigned countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+  unsigned long index = 0;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+ByteSetScanner::ByteSetScanner(std::string_view bytes) {
+  for (char ch : bytes) {
+    if (!contains(ch)) {
+      table_[static_cast<unsigned char>(ch)] = true;
+      bytes_.push_back(ch);
+    }
+  }
+}
+
+size_t ByteSetScanner::find(std::string_view text, size_t from) const {
+  if (bytes_.empty() || from >= text.size()) {
+    return std::string_view::npos;
+  }
+  if (bytes_.size() == 1) {  // memchr is vectorized by the libc
+    const void* found = std::memchr(text.data() + from, bytes_[0], text.size() - from);
+    return found == nullptr ? std::string_view::npos
+                            : static_cast<const char*>(found) - text.data();
+  }
+  if (bytes_.size() > MAX_SIMD_BYTES) {
+    return findScalar(text, from);
+  }
+
+#if defined(__AVX2__)
+  constexpr size_t WIDTH = sizeof(__m256i);
+  __m256i needles[MAX_SIMD_BYTES];  // NOLINT(modernize-avoid-c-arrays)
+  for (size_t i = 0; i < bytes_.size(); ++i) {
+    needles[i] = _mm256_set1_epi8(bytes_[i]);
+  }
+  for (; from + WIDTH <= text.size(); from += WIDTH) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + from));
+    __m256i hits = _mm256_cmpeq_epi8(chunk, needles[0]);
+    for (size_t i = 1; i < bytes_.size(); ++i) {
+      hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, needles[i]));
+    }
+    const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+    if (mask != 0) {
+      return from + countTrailingZeros(mask);
+    }
+  }
+#elif defined(SCANNER_USE_SSE2)
+  constexpr size_t WIDTH = sizeof(__m128i);
+  __m128i needles[MAX_SIMD_BYTES];  // NOLINT(modernize-avoid-c-arrays)
+  for (size_t i = 0; i < bytes_.size(); ++i) {
+    needles[i] = _mm_set1_epi8(bytes_[i]);
+  }
+  for (; from + WIDTH <= text.size(); from += WIDTH) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + from));
+    __m128i hits = _mm_cmpeq_epi8(chunk, needles[0]);
+    for (size_t i = 1; i < bytes_.size(); ++i) {
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, needles[i]));
+    }
+    const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+    if (mask != 0) {
+      return from + countTrailingZeros(mask);
+    }
+  }
+#endif
+
+  // the tail shorter than a vector, or the architectures without SSE2
+  return findScalar(text, from);
+}
+
+size_t ByteSetScanner::findScalar(std::string_view text, size_t from) const {
+  for (; from < text.size(); ++from) {
+    if (contains(text[from])) {
+      return from;
+    }
+  }
+  return std::string_view::npos;
+}
+
+// the delimiter never matches if it contains a line break, like searching it in a line
+static std::string_view usableDelimiter(std::string_view delimiter) {
+  return delimiter.find('\n') == std::string_view::npos ? delimiter : std::string_view();
+}
+
+static std::string stopBytes(std::string_view delimiter, const ByteSetScanner& charsToRemove) {
+  std::string bytes = "\n";
+  if (!delimiter.empty()) {
+    bytes.push_back(delimiter.front());
+  }
+  return bytes + charsToRemove.bytes();
+}
+
+TextLineScanner::TextLineScanner(std::string_view text,
+                                 std::string_view delimiter,
+                                 const ByteSetScanner& charsToRemove)
+    : text_(text),
+      delimiter_(usableDelimiter(delimiter)),
+      charsToRemove_(charsToRemove),
+      stops_(stopBytes(delimiter_, charsToRemove)) {}
+
+bool TextLineScanner::next(TextLine& line) {
+  if (pos_ >= text_.size()) {
+    return false;
+  }
+
+  line.delimiterPos = std::string_view::npos;
+  line.hasCharsToRemove = false;
+  const size_t start = pos_;
+  size_t end = text_.size();
+  for (size_t pos = stops_.find(text_, pos_); pos != std::string_view::npos;
+       pos = stops_.find(text_, pos + 1)) {
+    const char ch = text_[pos];
+    if (ch == '\n') {
+      end = pos;
+      break;
+    }
+    if (charsToRemove_.contains(ch)) {
+      line.hasCharsToRemove = true;
+    }
+    if (line.delimiterPos == std::string_view::npos && !delimiter_.empty() &&
+        ch == delimiter_.front() && text_.compare(pos, delimiter_.size(), delimiter_) == 0) {
+      line.delimiterPos = pos - start;
+    }
+  }
+
+  line.text = text_.substr(start, end - start);
+  pos_ = end + 1;
+  return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Finds the bytes of a small set in a buffer, 32 or 16 bytes at a time with AVX2 or SSE2, and one
+// byte at a time with a lookup table on the other architectures or for a larger set.
+class ByteSetScanner {
+public:
+  static constexpr size_t MAX_SIMD_BYTES = 8;
+
+  explicit ByteSetScanner(std::string_view bytes);
+
+  [[nodiscard]] bool contains(char ch) const { return table_[static_cast<unsigned char>(ch)]; }
+  [[nodiscard]] bool empty() const { return bytes_.empty(); }
+  [[nodiscard]] const std::string& bytes() const { return bytes_; }
+
+  // Returns the position of the first byte in the set at or after `from`, or npos.
+  [[nodiscard]] size_t find(std::string_view text, size_t from) const;
+
+private:
+  [[nodiscard]] size_t findScalar(std::string_view text, size_t from) const;
+
+  std::array<bool, 256> table_{};
+  std::string bytes_;  // distinct
+};
+
+struct TextLine {
+  std::string_view text;                          // without the line break
+  size_t delimiterPos = std::string_view::npos;  // of the first delimiter in the line
+  bool hasCharsToRemove = false;
+};
+
+// Splits a text buffer into lines like std::getline, and locates the first delimiter and the chars
+// to remove of each line in the same pass.
+class TextLineScanner {
+public:
+  TextLineScanner(std::string_view text,
+                  std::string_view delimiter,
+                  const ByteSetScanner& charsToRemove);
+
+  // Returns false at the end of the buffer.
+  bool next(TextLine& line);
+
+private:
+  std::string_view text_;
+  size_t pos_ = 0;
+  std::string_view delimiter_;
+  const ByteSetScanner& charsToRemove_;
+  ByteSetScanner stops_;  // the line break, the first byte of the delimiter and the chars to remove
+};
@@ -2,9 +2,16 @@
 
 #include <boost/interprocess/file_mapping.hpp>
 #include <boost/interprocess/mapped_region.hpp>
-#include <filesystem>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <queue>
 #include <unordered_map>
+
+#include "dicts/binary_format.h"
+#include "dicts/fuzzy_matcher.h"
+#include "thread_pool.hpp"
 #ifdef _WIN32
 #include <fcntl.h>
 #include <io.h>
@@ -13,20 +20,219 @@
 
 namespace rime {
 
+// the keys looked up by a thread of findMany, as a lookup in the trie takes about 100ns, fewer
+// keys are not worth handing over to a thread, see the one of `LevelDb`
+constexpr size_t FIND_MANY_KEYS_PER_THREAD = 16 * 1024;
+
+// indexes the items of the values of the key ids, split the same way as the items of a trie
+static ReverseIndex buildReverseIndex(size_t valueCount,
+                                      const std::function<std::string_view(size_t)>& valueAt,
+                                      const std::string& concatSeparator) {
+  if (valueCount > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Too many keys to be reverse indexed");
+  }
+  std::vector<uint64_t> itemBegins;
+  std::vector<ValueItem> items;
+  std::vector<ReverseEntry> entries;
+  entries.reserve(valueCount);
+  for (size_t id = 0; id < valueCount; ++id) {
+    itemBegins.push_back(items.size());
+    if (concatSeparator.empty()) {
+      entries.push_back({static_cast<uint32_t>(id), 0});
+      continue;
+    }
+    const auto value = valueAt(id);
+    Dictionary::forEachItem(value, concatSeparator, [&](std::string_view item) {
+      entries.push_back({static_cast<uint32_t>(id),
+                         static_cast<uint32_t>(items.size() - itemBegins.back())});
+      items.push_back({static_cast<uint32_t>(item.data() - value.data()),
+                       static_cast<uint32_t>(item.length())});
+    });
+  }
+
+  ReverseIndex index;
+  index.build(std::move(entries), [&](const ReverseEntry& entry) {
+    const auto value = valueAt(entry.keyId);
+    if (concatSeparator.empty()) {
+      return value;
+    }
+    const auto& item = items[itemBegins[entry.keyId] + entry.item];
+    return value.substr(item.offset, item.length);
+  });
+  return index;
+}
+
+// hashes the keys of the trie to their ids
+static PerfectHashIndex buildPerfectHashIndex(const marisa::Trie& trie, size_t valueCount) {
+  std::vector<std::pair<uint64_t, uint32_t>> keys;
+  keys.reserve(valueCount);
+  marisa::Agent agent;
+  agent.set_query("", 0);
+  while (trie.predictive_search(agent)) {
+    const std::size_t id = agent.key().id();
+    if (id < valueCount) {
+      keys.emplace_back(
+          PerfectHashIndex::hashOf({agent.key().ptr(), agent.key().length()}),
+          static_cast<uint32_t>(id));
+    }
+  }
+  PerfectHashIndex index;
+  index.build(keys);
+  return index;
+}
+
+static boost::interprocess::mapped_region::advice_types toAdviceType(MemoryAdvice advice) {
+  switch (advice) {
+    case MemoryAdvice::Random:
+      return boost::interprocess::mapped_region::advice_random;
+    case MemoryAdvice::Sequential:
+      return boost::interprocess::mapped_region::advice_sequential;
+    case MemoryAdvice::WillNeed:
+      return boost::interprocess::mapped_region::advice_willneed;
+    default:
+      return boost::interprocess::mapped_region::advice_normal;
+  }
+}
+
 void Trie::loadBinaryFile(const std::string& filePath) {
+  loadBinaryFile(filePath, TrieLoadOptions{});
+}
+
+void Trie::loadBinaryFile(const std::string& filePath, const TrieLoadOptions& options) {
   boost::interprocess::file_mapping mapping(std::string(filePath).c_str(),
                                             boost::interprocess::read_only);
-  boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+  auto region =
+      std::make_unique<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_only);
+  if (options.advice != MemoryAdvice::Normal) {
+    // it's only a hint, and not supported on every platform
+    region->advise(toAdviceType(options.advice));
+  }
+
+  const char* base = static_cast<const char*>(region->get_address());
+  if (!BinaryFileReader::isBinaryFile(base, region->get_size())) {
+    loadLegacyBinaryFile(mapping, *region);
+    return;
+  }
+
+  BinaryFileReader reader(base, region->get_size());
+  if (reader.header().layout != binary_format::Layout::MarisaTrie) {
+    throw std::runtime_error("Not a binary trie file: " + filePath);
+  }
+  if (options.verifyChecksums) {
+    reader.verifyChecksums();
+  }
+
+  // the values are kept in the mapped string pool
+  const uint64_t valueCount = reader.header().valueCount;
+  ValuePool values;
+  values.load(reader, valueCount, options.cachedValueBlocks);
+
+  auto itemBegins = reader.findSection(binary_format::SectionType::ValueItemBegins);
+  auto items = reader.findSection(binary_format::SectionType::ValueItems);
+  const bool hasItems = itemBegins.has_value() && items.has_value();
+  if (hasItems && (itemBegins->size() != (valueCount + 1) * sizeof(uint64_t) ||
+                   items->size() % sizeof(ValueItem) != 0)) {
+    throw std::runtime_error("Corrupted data file");
+  }
+
+  if (hasItems) {
+    // the items of each key follow the ones of the previous key, and each item is checked against
+    // its value when it's read
+    const auto* begins = reinterpret_cast<const uint64_t*>(itemBegins->data());
+    const uint64_t itemCount = items->size() / sizeof(ValueItem);
+    if (begins[0] != 0 || begins[valueCount] != itemCount) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    for (uint64_t id = 0; id < valueCount; ++id) {
+      if (begins[id + 1] < begins[id]) {
+        throw std::runtime_error("Corrupted data file");
+      }
+    }
+  }
+
+  auto keyOrder = reader.findSection(binary_format::SectionType::KeyOrder);
+  if (keyOrder.has_value()) {
+    if (keyOrder->size() != valueCount * sizeof(uint32_t)) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    const auto* ids = reinterpret_cast<const uint32_t*>(keyOrder->data());
+    if (std::any_of(ids, ids + valueCount, [&](uint32_t id) { return id >= valueCount; })) {
+      throw std::runtime_error("Corrupted data file");
+    }
+  }
+  WeightIndex weightIndex;
+  weightIndex.load(reader, valueCount);
+  ReverseIndex reverseIndex;
+  reverseIndex.load(reader);
+  PerfectHashIndex perfectHashIndex;
+  perfectHashIndex.load(reader, valueCount);
+
+  auto trie = reader.section(binary_format::SectionType::MarisaTrie);
+  if (options.mode == TrieLoadMode::Map) {
+    trie_.map(trie.data(), trie.size());
+  } else {
+    readTrie(mapping, trie.data() - base);
+  }
+
+  ++generation_;
+  loaded_ = true;
+  delta_.clear();
+  data_.clear();
+  region_ = std::move(region);
+  values_ = std::move(values);
+  valuePoolOptions_ = values_.options();
+  weightIndex_ = std::move(weightIndex);
+  reverseIndex_ = std::move(reverseIndex);
+  perfectHashIndex_ = std::move(perfectHashIndex);
+  if (keyOrder.has_value()) {
+    ownedKeyOrder_.clear();
+    keyOrder_ = reinterpret_cast<const uint32_t*>(keyOrder->data());
+  } else {  // written before the key order was introduced
+    indexKeyOrder();
+  }
+
+  auto separator = reader.findSection(binary_format::SectionType::ConcatSeparator);
+  concatSeparator_ = separator.has_value() ? std::string(separator.value()) : "";
+
+  if (hasItems) {
+    ownedItemBegins_.clear();
+    ownedItems_.clear();
+    itemBegins_ = reinterpret_cast<const uint64_t*>(itemBegins->data());
+    items_ = reinterpret_cast<const ValueItem*>(items->data());
+    itemCount_ = items->size() / sizeof(ValueItem);
+  } else {  // written before the items were introduced
+    indexValueItems();
+  }
+}
 
-  const char* current = static_cast<const char*>(region.get_address());
+void Trie::readTrie(const boost::interprocess::file_mapping& mapping, size_t offset) {
+#ifdef _WIN32
+  auto native_handle = mapping.get_mapping_handle().handle;
+  SetFilePointer(reinterpret_cast<HANDLE>(native_handle), offset, nullptr, FILE_BEGIN);
+  int fd = _open_osfhandle(reinterpret_cast<intptr_t>(native_handle), _O_RDONLY);
+  trie_.read(fd);
+  _close(fd);
+#else
+  ::lseek(mapping.get_mapping_handle().handle, static_cast<off_t>(offset), SEEK_SET);
+  trie_.read(mapping.get_mapping_handle().handle);
+#endif
+}
+
+void Trie::loadLegacyBinaryFile(const boost::interprocess::file_mapping& mapping,
+                                const boost::interprocess::mapped_region& region) {
+  const char* base = static_cast<const char*>(region.get_address());
+  const char* current = base;
   const char* end = current + region.get_size();
 
   // Read data vector size
   size_t dataSize = 0;
+  if (current + sizeof(dataSize) > end) {
+    throw std::runtime_error("Corrupted data file");
+  }
   std::memcpy(&dataSize, current, sizeof(dataSize));
   current += sizeof(dataSize);
 
-  data_.resize(dataSize);
+  std::vector<std::string> data(dataSize);
 
   // Read strings
   for (size_t i = 0; i < dataSize && current < end; ++i) {
@@ -38,86 +244,263 @@ void Trie::loadBinaryFile(const std::string& filePath) {
       throw std::runtime_error("Corrupted data file");
     }
 
-    data_[i].assign(current, strLen);
+    data[i].assign(current, strLen);
     current += strLen;
   }
 
-  // Read and load trie
-  size_t trieSize = 0;
-  std::memcpy(&trieSize, current, sizeof(trieSize));
-  current += sizeof(trieSize);
+  // Read and load trie, which is not aligned to be mapped
+  current += sizeof(size_t);
+  readTrie(mapping, current - base);
 
-  off_t offset = current - static_cast<const char*>(region.get_address());
-#ifdef _WIN32
-  auto native_handle = mapping.get_mapping_handle().handle;
-  SetFilePointer(reinterpret_cast<HANDLE>(native_handle), offset, nullptr, FILE_BEGIN);
-  int fd = _open_osfhandle(reinterpret_cast<intptr_t>(native_handle), _O_RDONLY);
-  trie_.read(fd);
-  _close(fd);
-#else
-  ::lseek(mapping.get_mapping_handle().handle, offset, SEEK_SET);
-  trie_.read(mapping.get_mapping_handle().handle);
-#endif
+  ++generation_;
+  loaded_ = true;
+  delta_.clear();
+  weightIndex_.clear();
+  reverseIndex_.clear();
+  perfectHashIndex_.clear();
+  region_.reset();
+  values_.clear();
+  valuePoolOptions_ = {};
+  data_ = std::move(data);
+  indexKeyOrder();
 
   auto optSeparator = find(MAGIC_KEY_TO_STORE_CONCAT_SEPARATOR);
   concatSeparator_ = optSeparator.has_value() ? optSeparator.value() : "";
+  indexValueItems();
 }
 
 void Trie::loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) {
-  std::unordered_map<std::string, std::string> map = parseTextFile(txtPath, options);
-  if (options.onDuplicatedKey == OnDuplicatedKey::Concat) {
-    map[MAGIC_KEY_TO_STORE_CONCAT_SEPARATOR] = options.concatSeparator;
-    concatSeparator_ = options.concatSeparator;
-  }
+  build(parseTextFile(txtPath, options), options);
+}
+
+void Trie::build(const std::unordered_map<std::string, std::string>& map,
+                 const ParseTextFileOptions& options) {
+  concatSeparator_ =
+      options.onDuplicatedKey == OnDuplicatedKey::Concat ? options.concatSeparator : "";
   build(map);
+  valuePoolOptions_ = {options.deduplicateValues, options.compressValues};
+  if (options.weightColumn > 0) {
+    indexWeights({options.weightColumn, options.delimiter});
+  }
+  if (options.reverseIndex) {
+    indexReverse();
+  }
+  if (options.perfectHashIndex) {
+    indexPerfectHash();
+  }
 }
 
 void Trie::saveToBinaryFile(const std::string& filePath) {
-  std::ofstream file(filePath, std::ios::binary);
-  if (!file) {
-    throw std::runtime_error("Failed to open file for writing " + filePath);
+  if (!loaded_) {
+    throw std::runtime_error("No trie loaded.");
+  }
+  compact();
+  writeBinaryFile(filePath, trie_, valueCount(),
+                  values_.pinInBatches([this](size_t id) { return valueAt(id); }),
+                  concatSeparator_, keyOrder_, weightIndex_, reverseIndex_, perfectHashIndex_,
+                  valuePoolOptions_);
+}
+
+void Trie::buildBinaryFile(const std::string& txtPath,
+                           const ParseTextFileOptions& options,
+                           const std::string& binaryPath) {
+  // the values are spilled in the key order, and copied in the id order of the built trie at last
+  ScopedTempFile valuesFile{binaryPath + ".values"};
+  const std::string concatSeparator =
+      options.onDuplicatedKey == OnDuplicatedKey::Concat ? options.concatSeparator : "";
+  const WeightIndex::Column weightColumn{options.weightColumn, options.delimiter};
+  marisa::Keyset keyset;
+  std::vector<uint64_t> sortedOffsets{0};
+  std::vector<double> sortedWeights;
+  {
+    std::ofstream values(valuesFile.path(), std::ios::binary);
+    if (!values) {
+      throw std::runtime_error("Failed to open file for writing " + valuesFile.path().string());
+    }
+    parseSortedTextFile(txtPath, options, binaryPath,
+                        [&](const std::string& key, const std::string& value) {
+                          keyset.push_back(key.c_str(), key.length());
+                          values.write(value.data(), static_cast<std::streamsize>(value.length()));
+                          sortedOffsets.push_back(sortedOffsets.back() + value.length());
+                          if (weightColumn.index > 0) {
+                            sortedWeights.push_back(
+                                WeightIndex::parseWeight(value, weightColumn, concatSeparator));
+                          }
+                        });
+    if (!values) {
+      throw std::runtime_error("Failed to write file " + valuesFile.path().string());
+    }
   }
 
-  IOUtil::writeVectorData(file, data_);
+  marisa::Trie trie;
+  trie.build(keyset, MARISA_BINARY_TAIL);  // UTF-8 support
+  std::vector<size_t> sortedIndexes(keyset.size());  // of the key ids
+  for (size_t i = 0; i < keyset.size(); ++i) {
+    sortedIndexes[keyset[i].id()] = i;
+  }
+  keyset.clear();
 
-  // Handle trie data
-  ScopedTempFile tempFile{filePath};
-  trie_.save(tempFile.path().string().c_str());
+  // the keys are visited in the byte order
+  std::vector<uint32_t> keyOrder(sortedIndexes.size());
+  for (size_t id = 0; id < sortedIndexes.size(); ++id) {
+    keyOrder[sortedIndexes[id]] = static_cast<uint32_t>(id);
+  }
+  WeightIndex weightIndex;
+  if (weightColumn.index > 0) {
+    weightIndex.build(weightColumn, std::move(sortedWeights));
+  }
 
-  std::ifstream trieFile(tempFile.path(), std::ios::binary | std::ios::ate);
-  const size_t trieSize = trieFile.tellg();
-  trieFile.seekg(0);
+  std::unique_ptr<boost::interprocess::mapped_region> region;
+  const char* pool = nullptr;
+  if (sortedOffsets.back() > 0) {
+    boost::interprocess::file_mapping mapping(valuesFile.path().string().c_str(),
+                                              boost::interprocess::read_only);
+    region = std::make_unique<boost::interprocess::mapped_region>(mapping,
+                                                                  boost::interprocess::read_only);
+    pool = static_cast<const char*>(region->get_address());
+  }
+  const auto valueAt = [&](size_t id) {
+    const size_t index = sortedIndexes[id];
+    return std::string_view(pool + sortedOffsets[index],
+                            sortedOffsets[index + 1] - sortedOffsets[index]);
+  };
+  const ReverseIndex reverseIndex = options.reverseIndex
+                                        ? buildReverseIndex(sortedIndexes.size(), valueAt,
+                                                            concatSeparator)
+                                        : ReverseIndex{};
+  const PerfectHashIndex perfectHashIndex = options.perfectHashIndex
+                                                ? buildPerfectHashIndex(trie, sortedIndexes.size())
+                                                : PerfectHashIndex{};
+  writeBinaryFile(binaryPath, trie, sortedIndexes.size(), valueAt, concatSeparator,
+                  keyOrder.data(), weightIndex, reverseIndex, perfectHashIndex,
+                  {options.deduplicateValues, options.compressValues});
+  region.reset();
 
-  file.write(reinterpret_cast<const char*>(&trieSize), sizeof(trieSize));
-  file << trieFile.rdbuf();
+  loadBinaryFile(binaryPath);
 }
 
-void Trie::add(const std::string& key, const std::string& value) {
-  marisa::Keyset keyset;
-  keyset.push_back(key.c_str(), key.length());
+void Trie::writeBinaryFile(const std::string& filePath,
+                           const marisa::Trie& trie,
+                           size_t valueCount,
+                           const std::function<std::string_view(size_t)>& valueAt,
+                           const std::string& concatSeparator,
+                           const uint32_t* keyOrder,
+                           const WeightIndex& weightIndex,
+                           const ReverseIndex& reverseIndex,
+                           const PerfectHashIndex& perfectHashIndex,
+                           const ValuePool::Options& valuePoolOptions) {
+  BinaryFileWriter writer(binary_format::Layout::MarisaTrie, trie.num_keys(), valueCount);
 
-  // Build the trie
-  trie_.build(keyset, MARISA_BINARY_TAIL);  // UTF-8 support
+  if (!concatSeparator.empty()) {
+    writer.addSection(binary_format::SectionType::ConcatSeparator,
+                      binary_format::DEFAULT_ALIGNMENT,
+                      [&](auto& out) { out.writeBytes(concatSeparator); });
 
-  // Get the ID for the key
-  marisa::Agent agent;
-  agent.set_query(key.c_str(), key.length());
+    // the items of the concatenated values, to be iterated without splitting them on queries
+    writer.addSection(binary_format::SectionType::ValueItemBegins,
+                      binary_format::DEFAULT_ALIGNMENT, [&](auto& out) {
+                        std::vector<ValueItem> items;
+                        uint64_t begin = 0;
+                        out.writeValue(begin);
+                        for (size_t id = 0; id < valueCount; ++id) {
+                          items.clear();
+                          splitValueItems(valueAt(id), concatSeparator, items);
+                          begin += items.size();
+                          out.writeValue(begin);
+                        }
+                      });
+    writer.addSection(binary_format::SectionType::ValueItems, binary_format::DEFAULT_ALIGNMENT,
+                      [&](auto& out) {
+                        std::vector<ValueItem> items;
+                        for (size_t id = 0; id < valueCount; ++id) {
+                          items.clear();
+                          splitValueItems(valueAt(id), concatSeparator, items);
+                          for (const auto& item : items) {
+                            out.writeValue(item);
+                          }
+                        }
+                      });
+  }
+  writer.addSection(binary_format::SectionType::KeyOrder, binary_format::DEFAULT_ALIGNMENT,
+                    [&](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(keyOrder),
+                                      valueCount * sizeof(uint32_t)});
+                    });
+  weightIndex.addSections(writer);
+  reverseIndex.addSections(writer);
+  perfectHashIndex.addSections(writer);
+  ValuePool::addSections(writer, valueCount, valueAt, valuePoolOptions);
+  // page-aligned to be mapped in place
+  writer.addSection(binary_format::SectionType::MarisaTrie, binary_format::PAGE_ALIGNMENT,
+                    [&](auto& out) { marisa::write(out.stream(), trie); });
 
-  if (trie_.lookup(agent)) {
-    std::size_t id = agent.key().id();
+  writer.writeFile(filePath);
+}
 
-    // Resize data vector if necessary
-    if (id >= data_.size()) {
-      data_.resize(id + 1);
-    }
+void Trie::add(const std::string& key, const std::string& value) {
+  if (!loaded_) {  // never built nor loaded, the added keys are searched alongside it
+    build({});
+  }
+  delta_.insert_or_assign(key, value);
+  ++generation_;
+}
 
-    // Store the associated data
-    data_[id] = value;
-  } else {
-    throw std::runtime_error("Failed to add key-value pair");
+void Trie::compact() {
+  if (delta_.empty()) {
+    return;
+  }
+
+  std::unordered_map<std::string, std::string> map(valueCount() + delta_.size());
+  const auto readValue = values_.pinInBatches([this](size_t id) { return valueAt(id); });
+  marisa::Agent agent;
+  agent.set_query("", 0);
+  while (trie_.predictive_search(agent)) {
+    const std::size_t id = agent.key().id();
+    if (id < valueCount()) {
+      map.emplace(std::string(agent.key().ptr(), agent.key().length()), readValue(id));
+    }
+  }
+  for (const auto& [key, value] : delta_) {
+    map.insert_or_assign(key, value);
+  }
+  auto weightColumn = weightIndex_.column();
+  const bool reverseIndexed = reverseIndex_.isBuilt();
+  const bool perfectHashed = perfectHashIndex_.isBuilt();
+  build(map);
+  if (weightColumn.index > 0) {
+    indexWeights(std::move(weightColumn));
+  }
+  if (reverseIndexed) {
+    indexReverse();
+  }
+  if (perfectHashed) {
+    indexPerfectHash();
   }
 }
 
+void Trie::swap(Trie& other) noexcept {
+  std::swap(region_, other.region_);
+  trie_.swap(other.trie_);
+  std::swap(data_, other.data_);
+  std::swap(values_, other.values_);
+  std::swap(valuePoolOptions_, other.valuePoolOptions_);
+  std::swap(concatSeparator_, other.concatSeparator_);
+  std::swap(itemBegins_, other.itemBegins_);
+  std::swap(items_, other.items_);
+  std::swap(itemCount_, other.itemCount_);
+  std::swap(ownedItemBegins_, other.ownedItemBegins_);
+  std::swap(ownedItems_, other.ownedItems_);
+  std::swap(keyOrder_, other.keyOrder_);
+  std::swap(ownedKeyOrder_, other.ownedKeyOrder_);
+  std::swap(weightIndex_, other.weightIndex_);
+  std::swap(reverseIndex_, other.reverseIndex_);
+  std::swap(perfectHashIndex_, other.perfectHashIndex_);
+  std::swap(delta_, other.delta_);
+  std::swap(loaded_, other.loaded_);
+  // above the generations of both tries, to invalidate the iterators of both
+  generation_ = other.generation_ = std::max(generation_, other.generation_) + 1;
+}
+
 void Trie::build(const std::unordered_map<std::string, std::string>& map) {
   marisa::Keyset keyset;
 
@@ -128,6 +511,14 @@ void Trie::build(const std::unordered_map<std::string, std::string>& map) {
 
   // Build the trie
   trie_.build(keyset, MARISA_BINARY_TAIL);  // UTF-8 support
+  region_.reset();  // the previous trie and values might be mapped from it
+  values_.clear();
+  ++generation_;
+  loaded_ = true;
+  delta_.clear();
+  weightIndex_.clear();
+  reverseIndex_.clear();
+  perfectHashIndex_.clear();
 
   // Resize data vector to accommodate all values
   data_.resize(map.size());
@@ -143,49 +534,592 @@ void Trie::build(const std::unordered_map<std::string, std::string>& map) {
       throw std::runtime_error("Failed to add key-value pair");
     }
   }
+  indexKeyOrder();
+  indexValueItems();
 }
 
-std::optional<std::string> Trie::find(const std::string& key) const {
+void Trie::indexKeyOrder() {
+  if (valueCount() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Too many keys to be ordered");
+  }
+  std::vector<std::pair<std::string, uint32_t>> keys;
+  keys.reserve(valueCount());
   marisa::Agent agent;
-  agent.set_query(key.data(), key.length());
+  agent.set_query("", 0);
+  while (trie_.predictive_search(agent)) {
+    const std::size_t id = agent.key().id();
+    if (id < valueCount()) {
+      keys.emplace_back(std::string(agent.key().ptr(), agent.key().length()),
+                        static_cast<uint32_t>(id));
+    }
+  }
+  std::sort(keys.begin(), keys.end());
 
-  if (trie_.lookup(agent)) {
-    std::size_t id = agent.key().id();
-    if (id < data_.size()) {
-      return data_[id];
+  ownedKeyOrder_.clear();
+  ownedKeyOrder_.reserve(keys.size());
+  for (const auto& [key, id] : keys) {
+    ownedKeyOrder_.push_back(id);
+  }
+  keyOrder_ = ownedKeyOrder_.data();
+}
+
+void Trie::indexWeights(WeightIndex::Column column) {
+  std::vector<double> weights(valueCount());
+  for (size_t position = 0; position < weights.size(); ++position) {
+    weights[position] =
+        WeightIndex::parseWeight(valueAt(keyOrder_[position]), column, concatSeparator_);
+  }
+  weightIndex_.build(std::move(column), std::move(weights));
+}
+
+void Trie::indexReverse() {
+  reverseIndex_ = buildReverseIndex(
+      valueCount(), [this](size_t id) { return valueAt(id); }, concatSeparator_);
+}
+
+void Trie::indexPerfectHash() {
+  perfectHashIndex_ = buildPerfectHashIndex(trie_, valueCount());
+}
+
+std::string_view Trie::itemAt(const ReverseEntry& entry) const {
+  if (entry.keyId >= valueCount()) {
+    return {};
+  }
+  const auto value = valueAt(entry.keyId);
+  if (itemBegins_ == nullptr) {
+    return value;
+  }
+  const uint64_t index = itemBegins_[entry.keyId] + entry.item;
+  if (index >= std::min<uint64_t>(itemBegins_[entry.keyId + 1], itemCount_)) {
+    return {};
+  }
+  return itemOf(value, items_[index]);
+}
+
+std::string_view Trie::itemOf(std::string_view value, const ValueItem& item) {
+  if (item.offset > value.length() || item.length > value.length() - item.offset) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  return value.substr(item.offset, item.length);
+}
+
+std::vector<std::string> Trie::reverseFind(std::string_view value) const {
+  if (!reverseIndex_.isBuilt()) {
+    throw std::runtime_error("The trie is built without the reverse index");
+  }
+  const auto pin = values_.pin();
+  std::vector<std::string> keys;
+  marisa::Agent agent;
+  const auto entries =
+      reverseIndex_.find(value, [this](const ReverseEntry& entry) { return itemAt(entry); });
+  for (const auto& entry : entries) {
+    agent.set_query(entry.keyId);
+    trie_.reverse_lookup(agent);
+    std::string key(agent.key().ptr(), agent.key().length());
+    if (!findInDelta(key).has_value()) {  // overridden by the added value
+      keys.push_back(std::move(key));
+    }
+  }
+  for (const auto& [key, deltaValue] : delta_) {
+    bool matched = false;
+    forEachItem(deltaValue, concatSeparator_,
+                [&](std::string_view item) { matched = matched || item == value; });
+    if (matched) {
+      keys.push_back(key);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  return keys;
+}
+
+std::string_view Trie::keyAt(marisa::Agent& agent, size_t position) const {
+  agent.set_query(keyOrder_[position]);
+  trie_.reverse_lookup(agent);
+  return {agent.key().ptr(), agent.key().length()};
+}
+
+std::pair<size_t, size_t> Trie::prefixRange(marisa::Agent& agent,
+                                            std::string_view prefix,
+                                            size_t from) const {
+  const auto firstPosition = [&](size_t low, auto&& isAfter) {
+    for (size_t high = valueCount(); low < high;) {
+      const size_t middle = low + (high - low) / 2;
+      if (isAfter(keyAt(agent, middle))) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
     }
+    return low;
+  };
+  const size_t begin = firstPosition(from, [&](std::string_view key) { return key >= prefix; });
+  const size_t end = firstPosition(
+      begin, [&](std::string_view key) { return key.substr(0, prefix.length()) != prefix; });
+  return {begin, end};
+}
+
+void Trie::indexValueItems() {
+  ownedItemBegins_.clear();
+  ownedItems_.clear();
+  itemBegins_ = nullptr;
+  items_ = nullptr;
+  itemCount_ = 0;
+  if (concatSeparator_.empty()) {
+    return;
+  }
+
+  ownedItemBegins_.reserve(valueCount() + 1);
+  for (size_t id = 0; id < valueCount(); ++id) {
+    ownedItemBegins_.push_back(ownedItems_.size());
+    splitValueItems(valueAt(id), concatSeparator_, ownedItems_);
+  }
+  ownedItemBegins_.push_back(ownedItems_.size());
+  itemBegins_ = ownedItemBegins_.data();
+  items_ = ownedItems_.data();
+  itemCount_ = ownedItems_.size();
+}
+
+void Trie::splitValueItems(std::string_view value,
+                           std::string_view separator,
+                           std::vector<ValueItem>& items) {
+  if (value.length() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("The value is too long to be split into items");
+  }
+  forEachItem(value, separator, [&](std::string_view item) {
+    items.push_back({static_cast<uint32_t>(item.data() - value.data()),
+                     static_cast<uint32_t>(item.length())});
+  });
+}
+
+std::string_view Trie::valueAt(size_t id) const {
+  if (region_) {
+    return values_.at(id);
+  }
+  return data_[id];
+}
+
+std::optional<std::string> Trie::find(const std::string& key) const {
+  auto value = findView(key);
+  if (value.has_value()) {
+    return std::string(value.value());
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string_view> Trie::findInDelta(std::string_view key) const {
+  if (delta_.empty()) {
+    return std::nullopt;
+  }
+  auto it = delta_.find(key);
+  return it != delta_.end() ? std::make_optional<std::string_view>(it->second) : std::nullopt;
+}
+
+std::optional<size_t> Trie::keyIdOf(marisa::Agent& agent, std::string_view key) const {
+  if (perfectHashIndex_.isBuilt()) {
+    auto id = perfectHashIndex_.find(key);
+    return id.has_value() && id.value() < valueCount() ? std::make_optional<size_t>(id.value())
+                                                       : std::nullopt;
+  }
+  if (!loaded_) {
+    return std::nullopt;
+  }
+  agent.set_query(key.data(), key.length());
+  if (trie_.lookup(agent) && agent.key().id() < valueCount()) {
+    return agent.key().id();
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string_view> Trie::lookup(marisa::Agent& agent, std::string_view key) const {
+  if (auto value = findInDelta(key)) {
+    return value;
+  }
+  if (auto id = keyIdOf(agent, key)) {
+    return valueAt(id.value());
   }
   return std::nullopt;
 }
 
+std::optional<std::string_view> Trie::findView(std::string_view key) const {
+  const auto pin = values_.pin();  // the decoded values are kept until the next lookup
+  marisa::Agent agent;
+  return lookup(agent, key);
+}
+
+std::vector<std::optional<std::string>> Trie::findMany(const std::vector<std::string>& keys) const {
+  auto values = findManyView(keys);
+  return {values.begin(), values.end()};
+}
+
+std::vector<std::optional<std::string_view>> Trie::findManyView(
+    const std::vector<std::string>& keys,
+    const FindManyOptions& options) const {
+  const auto pin = values_.pin();
+  std::vector<std::optional<std::string_view>> values(keys.size());
+  ThreadPool::forEachRange(keys.size(), options.threads, FIND_MANY_KEYS_PER_THREAD,
+                           [&](size_t begin, size_t end) {
+                             marisa::Agent agent;
+                             for (size_t i = begin; i < end; ++i) {
+                               values[i] = lookup(agent, keys[i]);
+                             }
+                           });
+  return values;
+}
+
 bool Trie::contains(std::string_view key) const {
+  if (findInDelta(key).has_value()) {
+    return true;
+  }
   marisa::Agent agent;
-  agent.set_query(key.data(), key.length());
-  return trie_.lookup(agent);
+  return keyIdOf(agent, key).has_value();
+}
+
+std::vector<std::string> Trie::findAll(const std::string& key) const {
+  auto items = findAllView(key);
+  return {items.begin(), items.end()};
+}
+
+std::vector<std::string_view> Trie::findAllView(std::string_view key) const {
+  const auto pin = values_.pin();
+  std::vector<std::string_view> results;
+  if (auto value = findInDelta(key)) {
+    forEachItem(value.value(), concatSeparator_,
+                [&](std::string_view item) { results.push_back(item); });
+    return results;
+  }
+  marisa::Agent agent;
+  if (auto id = keyIdOf(agent, key)) {
+    forEachValueItem(id.value(), [&](std::string_view item) { results.push_back(item); });
+  }
+  return results;
 }
 
 std::vector<std::pair<std::string, std::string>> Trie::prefixSearch(
     const std::string& prefix) const {
   std::vector<std::pair<std::string, std::string>> results;
+  for (auto& [key, value] : prefixSearchView(prefix)) {
+    results.emplace_back(std::move(key), value);
+  }
+  return results;
+}
+
+std::vector<std::pair<std::string, std::string>> Trie::prefixSearch(
+    const std::string& prefix,
+    const PrefixSearchOptions& options) const {
+  std::vector<std::pair<std::string, std::string>> results;
+  for (auto& [key, value] : prefixSearchView(prefix, options)) {
+    results.emplace_back(std::move(key), value);
+  }
+  return results;
+}
+
+std::vector<std::pair<std::string, std::string_view>> Trie::prefixSearchView(
+    std::string_view prefix,
+    const PrefixSearchOptions& options) const {
+  std::vector<std::pair<std::string, std::string_view>> results;
+  const auto pin = values_.pin();
   marisa::Agent agent;
   agent.set_query(prefix.data(), prefix.length());
 
-  while (trie_.predictive_search(agent)) {
-    std::string key(agent.key().ptr(), agent.key().length());
+  size_t skipped = 0;
+  const auto isFull = [&] { return options.limit > 0 && results.size() >= options.limit; };
+  std::string_view key;
+  const auto visitItem = [&](std::string_view item) {
+    if (skipped < options.offset) {
+      ++skipped;
+    } else if (!isFull()) {
+      results.emplace_back(key, item);
+    }
+  };
+  while (!isFull() && loaded_ && trie_.predictive_search(agent)) {
     std::size_t id = agent.key().id();
-    if (id < data_.size()) {
-      auto value = data_[id];
-      if (!concatSeparator_.empty()) {
-        auto arr = split(value, concatSeparator_);
-        for (auto& item : arr) {
-          results.emplace_back(key, item);
-        }
-      } else {
-        results.emplace_back(key, value);
+    key = std::string_view(agent.key().ptr(), agent.key().length());
+    if (id >= valueCount() || findInDelta(key).has_value()) {  // overridden by the added key
+      continue;
+    }
+    forEachValueItem(id, visitItem);
+  }
+  for (auto it = delta_.lower_bound(prefix);
+       !isFull() && it != delta_.end() && it->first.compare(0, prefix.length(), prefix) == 0;
+       ++it) {
+    key = it->first;
+    forEachItem(it->second, concatSeparator_, visitItem);
+  }
+  return results;
+}
+
+std::vector<std::pair<std::string, std::string>> Trie::prefixSearchInKeyOrder(
+    std::string_view prefix,
+    size_t limit) const {
+  std::vector<std::pair<std::string, std::string>> results;
+  const auto pin = values_.pin();
+  marisa::Agent agent;
+  auto [position, end] = prefixRange(agent, prefix);
+  auto deltaIt = delta_.lower_bound(prefix);
+  const auto deltaEnd = std::find_if(deltaIt, delta_.end(), [&](const auto& entry) {
+    return entry.first.compare(0, prefix.length(), prefix) != 0;
+  });
+
+  const auto isFull = [&] { return limit > 0 && results.size() >= limit; };
+  std::string key;
+  const auto visitItem = [&](std::string_view item) {
+    if (!isFull()) {
+      results.emplace_back(key, item);
+    }
+  };
+  while (!isFull() && (position < end || deltaIt != deltaEnd)) {
+    if (position < end) {
+      key.assign(keyAt(agent, position));
+      if (deltaIt == deltaEnd || key < deltaIt->first) {
+        forEachValueItem(keyOrder_[position++], visitItem);
+        continue;
+      }
+      if (key == deltaIt->first) {  // overridden by the added key
+        ++position;
+      }
+    }
+    key = deltaIt->first;
+    forEachItem(deltaIt->second, concatSeparator_, visitItem);
+    ++deltaIt;
+  }
+  return results;
+}
+
+std::vector<WeightedMatch> Trie::topK(std::string_view prefix, size_t k) const {
+  if (weightIndex_.empty()) {
+    throw std::runtime_error("The trie is built without weights.");
+  }
+  const auto pin = values_.pin();
+  std::vector<WeightedMatch> results;
+  if (k == 0) {
+    return results;
+  }
+
+  marisa::Agent agent;
+  const auto [begin, end] = prefixRange(agent, prefix);
+
+  // split the ranges at their heaviest keys, the heaviest range on the top
+  struct Range {
+    size_t heaviest;
+    size_t begin;
+    size_t end;
+  };
+  const auto lighter = [this](const Range& a, const Range& b) {
+    const double weightA = weightIndex_.weightAt(a.heaviest);
+    const double weightB = weightIndex_.weightAt(b.heaviest);
+    return weightA < weightB || (weightA == weightB && a.heaviest > b.heaviest);
+  };
+  std::priority_queue<Range, std::vector<Range>, decltype(lighter)> ranges(lighter);
+  const auto pushRange = [&](size_t rangeBegin, size_t rangeEnd) {
+    if (rangeBegin < rangeEnd) {
+      ranges.push({weightIndex_.heaviest(rangeBegin, rangeEnd), rangeBegin, rangeEnd});
+    }
+  };
+  pushRange(begin, end);
+  while (results.size() < k && !ranges.empty()) {
+    const Range range = ranges.top();
+    ranges.pop();
+    pushRange(range.begin, range.heaviest);
+    pushRange(range.heaviest + 1, range.end);
+
+    auto key = keyAt(agent, range.heaviest);
+    if (!findInDelta(key).has_value()) {  // or overridden by the added key
+      results.push_back({std::string(key), valueAt(keyOrder_[range.heaviest]),
+                         weightIndex_.weightAt(range.heaviest)});
+    }
+  }
+
+  // the added keys are few, and their weights are parsed on the fly
+  for (auto it = delta_.lower_bound(prefix);
+       it != delta_.end() && it->first.compare(0, prefix.length(), prefix) == 0; ++it) {
+    const double weight =
+        WeightIndex::parseWeight(it->second, weightIndex_.column(), concatSeparator_);
+    results.push_back({it->first, it->second, weight});
+  }
+  std::stable_sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+    return a.weight > b.weight || (a.weight == b.weight && a.key < b.key);
+  });
+  if (results.size() > k) {
+    results.resize(k);
+  }
+  return results;
+}
+
+std::vector<PrefixMatch> Trie::commonPrefixSearch(std::string_view text) const {
+  const auto pin = values_.pin();
+  std::vector<PrefixMatch> results;
+  marisa::Agent agent;
+  agent.set_query(text.data(), text.length());
+  while (loaded_ && trie_.common_prefix_search(agent)) {
+    const std::size_t id = agent.key().id();
+    if (id < valueCount()) {
+      results.push_back({agent.key().length(), valueAt(id)});
+    }
+  }
+  if (delta_.empty()) {
+    return results;
+  }
+
+  // The added keys override the keys of the same lengths. The first added key not less than a
+  // prefix of the text is the prefix itself if it's added, and the walk stops at the first prefix
+  // that no added key starts with, as no longer prefix could be added either.
+  for (size_t length = 0; length <= text.length(); ++length) {
+    const auto prefix = text.substr(0, length);
+    auto deltaIt = delta_.lower_bound(prefix);
+    if (deltaIt == delta_.end() || deltaIt->first.compare(0, length, prefix) != 0) {
+      break;
+    }
+    if (deltaIt->first.length() != length) {
+      continue;
+    }
+    auto it = std::find_if(results.begin(), results.end(),
+                           [length](const PrefixMatch& match) { return match.length == length; });
+    if (it != results.end()) {
+      it->value = deltaIt->second;
+    } else {
+      results.push_back({length, deltaIt->second});
+    }
+  }
+  std::sort(results.begin(), results.end(),
+            [](const PrefixMatch& a, const PrefixMatch& b) { return a.length < b.length; });
+  return results;
+}
+
+std::vector<TextSegment> Trie::longestMatchSegmentation(std::string_view text) const {
+  const auto pin = values_.pin();
+  std::vector<TextSegment> segments;
+  for (size_t pos = 0; pos < text.length();) {
+    const auto rest = text.substr(pos);
+    auto matches = commonPrefixSearch(rest);
+    if (!matches.empty() && matches.back().length > 0) {
+      segments.push_back({rest.substr(0, matches.back().length), matches.back().value});
+      pos += matches.back().length;
+      continue;
+    }
+    uint32_t codePoint = 0;
+    const size_t length = decodeUtf8(rest, 0, codePoint);
+    segments.push_back({rest.substr(0, length), std::nullopt});
+    pos += length;
+  }
+  return segments;
+}
+
+std::vector<FuzzyMatch> Trie::fuzzySearch(std::string_view query,
+                                          size_t maxDistance,
+                                          size_t limit) const {
+  const auto pin = values_.pin();
+  std::vector<FuzzyMatch> results;
+  LevenshteinMatcher matcher(query, maxDistance);
+  const auto matchKey = [&](std::string_view key, size_t sharedDepth,
+                            std::vector<size_t>& boundaries) {
+    matcher.truncate(sharedDepth);
+    boundaries.resize(sharedDepth + 1);
+    for (size_t pos = boundaries.back(); pos < key.size();) {
+      uint32_t codePoint = 0;
+      pos += decodeUtf8(key, pos, codePoint);
+      boundaries.push_back(pos);
+      if (!matcher.push(codePoint)) {
+        return false;
       }
     }
+    return true;
+  };
+
+  marisa::Agent agent;
+  std::string previous;  // the last visited key
+  // the byte offsets of the code points of the last visited key, as far as it's matched
+  std::vector<size_t> boundaries{0};
+  for (size_t position = 0; position < valueCount();) {
+    std::string_view key = keyAt(agent, position);
+    size_t shared = 0;
+    while (shared < key.size() && shared < previous.size() && key[shared] == previous[shared]) {
+      ++shared;
+    }
+    // the code points in the common prefix with the previous key keep their rows
+    const size_t sharedDepth =
+        std::upper_bound(boundaries.begin(), boundaries.end(), shared) - boundaries.begin() - 1;
+    previous.assign(key);
+
+    if (!matchKey(previous, sharedDepth, boundaries)) {
+      // none of the keys starting with the matched prefix is within the distance
+      const std::string_view prefix = std::string_view(previous).substr(0, boundaries.back());
+      position = prefixRange(agent, prefix, position).second;
+      continue;
+    }
+    auto distance = matcher.distance();
+    if (distance.has_value() && !findInDelta(previous).has_value()) {
+      results.push_back({previous, valueAt(keyOrder_[position]), distance.value()});
+    }
+    ++position;
+  }
+
+  // the added keys are few, and matched one by one
+  for (const auto& [key, value] : delta_) {
+    boundaries.assign(1, 0);
+    if (matchKey(key, 0, boundaries) && matcher.distance().has_value()) {
+      results.push_back({key, value, matcher.distance().value()});
+    }
+  }
+
+  std::stable_sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+    return a.distance < b.distance || (a.distance == b.distance && a.key < b.key);
+  });
+  if (limit > 0 && results.size() > limit) {
+    results.resize(limit);
   }
   return results;
 }
 
+TriePrefixIterator::TriePrefixIterator(std::shared_ptr<const Trie> trie, std::string prefix)
+    : trie_(std::move(trie)),
+      generation_(trie_->generation_),
+      prefix_(std::move(prefix)),
+      deltaIt_(trie_->delta_.lower_bound(prefix_)) {
+  agent_.set_query(prefix_.data(), prefix_.length());
+}
+
+std::optional<std::pair<std::string, std::string_view>> TriePrefixIterator::next() {
+  if (generation_ != trie_->generation_) {
+    throw std::runtime_error("The trie has been reloaded during the prefix iteration.");
+  }
+
+  const auto pin = trie_->values_.pin();
+  const auto currentValue = [this] {
+    return valueId_.has_value() ? trie_->valueAt(valueId_.value()) : deltaValue_;
+  };
+  const auto pushItem = [&](std::string_view item) {
+    items_.push_back({static_cast<uint32_t>(item.data() - currentValue().data()),
+                      static_cast<uint32_t>(item.length())});
+  };
+  while (itemIndex_ >= items_.size()) {
+    items_.clear();
+    itemIndex_ = 0;
+    if (!exhausted_ && trie_->loaded_ && trie_->trie_.predictive_search(agent_)) {
+      const std::size_t id = agent_.key().id();
+      const std::string_view key(agent_.key().ptr(), agent_.key().length());
+      if (id >= trie_->valueCount() || trie_->findInDelta(key).has_value()) {
+        continue;
+      }
+      key_.assign(key);
+      valueId_ = id;
+      trie_->forEachValueItem(id, pushItem);
+      continue;
+    }
+
+    exhausted_ = true;
+    const auto& delta = trie_->delta_;
+    if (deltaIt_ == delta.end() || deltaIt_->first.compare(0, prefix_.length(), prefix_) != 0) {
+      return std::nullopt;
+    }
+    key_ = deltaIt_->first;
+    valueId_.reset();
+    deltaValue_ = deltaIt_->second;
+    Dictionary::forEachItem(deltaValue_, trie_->concatSeparator_, pushItem);
+    ++deltaIt_;
+  }
+  const ValueItem& item = items_[itemIndex_++];
+  return std::make_pair(key_, currentValue().substr(item.offset, item.length));
+}
+
 }  // namespace rime
@@ -2,25 +2,166 @@
 
 #include <marisa.h>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
 #include <cstddef>
-#include <filesystem>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "dicts/binary_format.h"
 #include "dicts/dictionary.h"
+#include "dicts/perfect_hash_index.h"
+#include "dicts/reverse_index.h"
+#include "dicts/value_pool.h"
+#include "dicts/weight_index.h"
 
 namespace rime {
 
+enum class TrieLoadMode : std::uint8_t {
+  Map,   // map the trie structure in place, sharing the file pages between processes
+  Read,  // read the trie structure into private heap memory
+};
+
+enum class MemoryAdvice : std::uint8_t {
+  Normal,
+  Random,
+  Sequential,
+  WillNeed,
+};
+
+struct TrieLoadOptions {
+  TrieLoadMode mode = TrieLoadMode::Map;
+  MemoryAdvice advice = MemoryAdvice::Normal;
+  bool verifyChecksums = false;  // reads the whole file to verify the checksum of every section
+  // the decoded blocks of the compressed values to keep, see `ParseTextFileOptions::compressValues`
+  size_t cachedValueBlocks = 64;
+};
+
+struct WeightedMatch {
+  std::string key;
+  std::string_view value;  // the whole value of the key
+  double weight = 0;
+};
+
+struct PrefixMatch {
+  size_t length;           // in bytes, the key is the prefix of the text of this length
+  std::string_view value;  // the whole value of the key
+};
+
+struct TextSegment {
+  std::string_view text;                 // a view into the segmented text
+  std::optional<std::string_view> value;  // std::nullopt if the segment is not a key
+};
+
+struct FuzzyMatch {
+  std::string key;
+  std::string_view value;  // the whole value of the key
+  size_t distance = 0;     // the Levenshtein distance in code points to the query
+};
+
 class Trie : public Dictionary {
+  friend class TriePrefixIterator;
+
 private:
+  // keeps the loaded binary file mapped, the value pool below points into it
+  std::unique_ptr<boost::interprocess::mapped_region> region_;
   marisa::Trie trie_;
   std::vector<std::string> data_;
+  ValuePool values_;                     // of the loaded binary file
+  ValuePool::Options valuePoolOptions_;  // how the values are stored in the saved binary file
   std::string concatSeparator_;
 
+  // the items of the concatenated values, mapped from the binary file or split from the values
+  const uint64_t* itemBegins_ = nullptr;  // valueCount() + 1 indexes into items_, if concatenated
+  const ValueItem* items_ = nullptr;
+  size_t itemCount_ = 0;
+  std::vector<uint64_t> ownedItemBegins_;
+  std::vector<ValueItem> ownedItems_;
+  // the key ids in the byte order of the keys, mapped from the binary file or sorted when built
+  const uint32_t* keyOrder_ = nullptr;
+  std::vector<uint32_t> ownedKeyOrder_;
+  WeightIndex weightIndex_;  // in the key order, empty if the trie is built without weights
+  ReverseIndex reverseIndex_;  // from the value items to the keys, if built with it
+  PerfectHashIndex perfectHashIndex_;  // from the keys to their ids, if built with it
+  // the keys added after the trie is built, sorted to be prefix searched, overriding the values of
+  // the same keys in the trie until they're compacted into it
+  std::map<std::string, std::string, std::less<>> delta_;
+  // increased whenever the trie is rebuilt, reloaded or added to, to invalidate the iterators
+  uint64_t generation_ = 0;
+  // whether the marisa trie is built or loaded, as its searches throw before then
+  bool loaded_ = false;
+
+  [[nodiscard]] size_t valueCount() const { return region_ ? values_.size() : data_.size(); }
+  [[nodiscard]] std::string_view valueAt(size_t id) const;
+  [[nodiscard]] std::optional<std::string_view> lookup(marisa::Agent& agent,
+                                                       std::string_view key) const;
+  [[nodiscard]] std::optional<std::string_view> findInDelta(std::string_view key) const;
+
+  // sorts the key ids in the byte order of the keys, for the tries built or loaded without it
+  void indexKeyOrder();
+  // indexes the weights parsed from the values of the built trie, in the key order
+  void indexWeights(WeightIndex::Column column);
+  [[nodiscard]] std::string_view keyAt(marisa::Agent& agent, size_t position) const;
+  // indexes the value items of the built trie to be reverse looked up
+  void indexReverse();
+  // hashes the keys of the built trie to be found without walking the trie
+  void indexPerfectHash();
+  // the id of the key in the trie, by the perfect hash if it's built
+  [[nodiscard]] std::optional<size_t> keyIdOf(marisa::Agent& agent, std::string_view key) const;
+  // the text of the value item referred to by an entry of the reverse index
+  [[nodiscard]] std::string_view itemAt(const ReverseEntry& entry) const;
+  // Returns the positions [begin, end) in the key order of the keys starting with the prefix,
+  // searching the positions since `from`.
+  [[nodiscard]] std::pair<size_t, size_t> prefixRange(marisa::Agent& agent,
+                                                      std::string_view prefix,
+                                                      size_t from = 0) const;
+  // splits the values by the concat separator, for the values built or loaded without the items
+  void indexValueItems();
+  static void splitValueItems(std::string_view value,
+                              std::string_view separator,
+                              std::vector<ValueItem>& items);
+
+  // the text of an item of the value, throws std::runtime_error if it's out of the value
+  [[nodiscard]] static std::string_view itemOf(std::string_view value, const ValueItem& item);
+
+  template <typename Visitor>
+  void forEachValueItem(size_t id, Visitor&& visitor) const {
+    auto value = valueAt(id);
+    if (itemBegins_ == nullptr) {
+      visitor(value);
+      return;
+    }
+    const uint64_t end = std::min<uint64_t>(itemBegins_[id + 1], itemCount_);
+    for (uint64_t i = itemBegins_[id]; i < end; ++i) {
+      visitor(itemOf(value, items_[i]));
+    }
+  }
+
+  void readTrie(const boost::interprocess::file_mapping& mapping, size_t offset);
+  // writes the trie and its values to a binary file, `valueAt` returns the value of a key id
+  static void writeBinaryFile(const std::string& filePath,
+                              const marisa::Trie& trie,
+                              size_t valueCount,
+                              const std::function<std::string_view(size_t)>& valueAt,
+                              const std::string& concatSeparator,
+                              const uint32_t* keyOrder,
+                              const WeightIndex& weightIndex,
+                              const ReverseIndex& reverseIndex,
+                              const PerfectHashIndex& perfectHashIndex,
+                              const ValuePool::Options& valuePoolOptions);
+  // loads the unversioned files written before the binary format header was introduced
+  void loadLegacyBinaryFile(const boost::interprocess::file_mapping& mapping,
+                            const boost::interprocess::mapped_region& region);
+
 protected:
   marisa::Trie& getTrie() { return trie_; }
   std::vector<std::string>& getData() { return data_; }
@@ -59,32 +200,126 @@ protected:
     }
   };
 
-  class ScopedTempFile {
-    std::filesystem::path path_;
-
-  public:
-    explicit ScopedTempFile(const std::filesystem::path& base) : path_(base.string() + ".temp") {}
-    ~ScopedTempFile() { std::filesystem::remove(path_); }
-
-    ScopedTempFile(const ScopedTempFile&) = delete;
-    ScopedTempFile& operator=(const ScopedTempFile&) = delete;
-    ScopedTempFile(ScopedTempFile&&) = delete;
-    ScopedTempFile& operator=(ScopedTempFile&&) = delete;
-
-    [[nodiscard]] const std::filesystem::path& path() const { return path_; }
-  };
-
 public:
   void loadBinaryFile(const std::string& filePath) override;
+  void loadBinaryFile(const std::string& filePath, const TrieLoadOptions& options);
   void loadTextFile(const std::string& txtPath, const ParseTextFileOptions& options) override;
   void saveToBinaryFile(const std::string& filePath) override;
+  // Builds the binary file from the text file in the key order, without keeping all the values in
+  // memory (see `ParseTextFileOptions::memoryBudget`), and then loads it.
+  void buildBinaryFile(const std::string& txtPath,
+                       const ParseTextFileOptions& options,
+                       const std::string& binaryPath);
   [[nodiscard]] std::optional<std::string> find(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::string> findAll(const std::string& key) const override;
+  [[nodiscard]] std::vector<std::optional<std::string>> findMany(
+      const std::vector<std::string>& keys) const override;
   [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
       const std::string& prefix) const override;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearch(
+      const std::string& prefix,
+      const PrefixSearchOptions& options) const;
+
+  // Zero-copy variants of find/prefixSearch. The returned values point into the loaded binary file
+  // (or the built data), and stay valid until this trie is reloaded or destroyed. If the values
+  // are compressed, they point into the cached blocks instead, and stay valid only until the next
+  // lookup of this trie that starts while no other lookup is running, from any thread. The same
+  // goes for the values of topK, commonPrefixSearch, longestMatchSegmentation and fuzzySearch.
+  // Copy the values, or use the variants returning std::string, to keep them longer, or hold
+  // `pinValues()` while copying them if other threads look up this trie meanwhile.
+  [[nodiscard]] std::optional<std::string_view> findView(std::string_view key) const;
+  [[nodiscard]] std::vector<std::string_view> findAllView(std::string_view key) const;
+  // Looks up the keys with one agent per thread, see `FindManyOptions::threads`.
+  [[nodiscard]] std::vector<std::optional<std::string_view>> findManyView(
+      const std::vector<std::string>& keys,
+      const FindManyOptions& options = {}) const;
+  [[nodiscard]] std::vector<std::pair<std::string, std::string_view>> prefixSearchView(
+      std::string_view prefix,
+      const PrefixSearchOptions& options = {}) const;
+  // Keeps the values viewed by the lookups in its lifetime valid, see `ValuePool::pin`.
+  [[nodiscard]] ValuePool::Pin pinValues() const { return values_.pin(); }
+
+  // Returns the first `limit` matches of the prefix, or all of them if it's 0, in the byte order of
+  // the keys with the added keys merged in, and the items of a concatenated value in their order.
+  // Only the returned keys are visited, walking the key order from the first key of the prefix.
+  [[nodiscard]] std::vector<std::pair<std::string, std::string>> prefixSearchInKeyOrder(
+      std::string_view prefix,
+      size_t limit) const;
 
+  // Returns the k heaviest keys starting with the prefix, in the descending order of the weights
+  // parsed from `ParseTextFileOptions::weightColumn`. Only the returned keys of the trie are
+  // visited. Throws std::runtime_error if the trie is built without weights.
+  [[nodiscard]] std::vector<WeightedMatch> topK(std::string_view prefix, size_t k) const;
+
+  // Returns the keys with a value item equal to the value, in the byte order, e.g. the pinyin of a
+  // Hanzi in a pinyin to Hanzi dictionary. Throws std::runtime_error if the trie is built without
+  // `ParseTextFileOptions::reverseIndex`.
+  [[nodiscard]] std::vector<std::string> reverseFind(std::string_view value) const;
+
+  // Returns the keys that are prefixes of the text, from the shortest to the longest, in one walk
+  // down the trie.
+  [[nodiscard]] std::vector<PrefixMatch> commonPrefixSearch(std::string_view text) const;
+  // Splits the text into the longest keys from the left greedily, i.e. forward maximal matching.
+  // A character that does not start any key becomes a segment of its own without a value.
+  [[nodiscard]] std::vector<TextSegment> longestMatchSegmentation(std::string_view text) const;
+
+  // Returns the keys within the Levenshtein distance of the query, in the ascending order of the
+  // distances, and at most `limit` of them unless it's 0. The keys are walked in the byte order
+  // with the distance rows of their common prefixes shared, and the keys starting with a prefix
+  // beyond the distance are skipped at once, like pruning the branches of a trie.
+  [[nodiscard]] std::vector<FuzzyMatch> fuzzySearch(std::string_view query,
+                                                    size_t maxDistance,
+                                                    size_t limit = 0) const;
+
+  // Adds or overrides a key in O(log n), without rebuilding the trie. The added keys are looked up
+  // alongside the trie, and prefix searched after the keys of the trie.
   void add(const std::string& key, const std::string& value);
+  // Rebuilds the trie in memory with the added keys merged, to be saved or searched faster.
+  void compact();
+  [[nodiscard]] size_t deltaSize() const { return delta_.size(); }
+  // Exchanges the contents with another trie, e.g. one loaded in the background, and invalidates
+  // the iterators of both of them.
+  void swap(Trie& other) noexcept;
+  // false until the trie is loaded or built
+  [[nodiscard]] bool isLoaded() const { return loaded_; }
   void build(const std::unordered_map<std::string, std::string>& map);
+  // Builds the trie of the entries parsed aside, with the indexes and the value storage of the
+  // options, the same as `loadTextFile`.
+  void build(const std::unordered_map<std::string, std::string>& map,
+             const ParseTextFileOptions& options);
   [[nodiscard]] bool contains(std::string_view key) const;
 };
 
+// Iterates the matches of a prefix search lazily, with a persistent marisa agent. The matches are
+// the same as Trie::prefixSearchView, and the trie is kept alive by the iterator.
+class TriePrefixIterator {
+public:
+  TriePrefixIterator(std::shared_ptr<const Trie> trie, std::string prefix);
+  TriePrefixIterator(const TriePrefixIterator&) = delete;
+  TriePrefixIterator(TriePrefixIterator&&) = delete;  // the agent points to the prefix
+  TriePrefixIterator& operator=(const TriePrefixIterator&) = delete;
+  TriePrefixIterator& operator=(TriePrefixIterator&&) = delete;
+  ~TriePrefixIterator() = default;
+
+  // Returns the next key and value item, or std::nullopt at the end. The value stays valid until
+  // the trie is reloaded or added to, and it throws std::runtime_error if it has been. If the
+  // values are compressed, the value stays valid until the next lookup, like the zero-copy lookups.
+  std::optional<std::pair<std::string, std::string_view>> next();
+
+private:
+  std::shared_ptr<const Trie> trie_;
+  uint64_t generation_;
+  std::string prefix_;
+  marisa::Agent agent_;
+  bool exhausted_ = false;  // of the keys in the trie, to continue with the added keys
+  std::map<std::string, std::string, std::less<>>::const_iterator deltaIt_;
+  std::string key_;
+  // the value of the current key is got again for each item, as the compressed values might have
+  // been evicted from the cache since the previous item
+  std::optional<size_t> valueId_;  // of the current key in the trie, or std::nullopt if added
+  std::string_view deltaValue_;    // of the current added key
+  std::vector<ValueItem> items_;   // of the current value
+  size_t itemIndex_ = 0;
+};
+
 }  // namespace rime
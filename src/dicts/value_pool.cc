@@ -0,0 +1,338 @@
+#include "dicts/value_pool.h"
+
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dicts/block_codec.h"
+
+namespace rime {
+
+// the decoded size of a compressed block, small to decode a value fast, and cut at the boundaries
+// of the values so that a value is always in one block
+constexpr size_t VALUE_BLOCK_SIZE = 4 * 1024;
+constexpr size_t DICTIONARY_CAPACITY = 16 * 1024;
+// the values sampled evenly to train the dictionary
+constexpr size_t MAX_DICTIONARY_SAMPLES = 16 * 1024;
+constexpr size_t MAX_DICTIONARY_SAMPLE_SIZE = 1024 * 1024;
+// the values read under a pin by `ValuePool::pinInBatches`
+constexpr size_t VALUES_PER_PIN = 1024;
+
+class ValueBlockCache {
+public:
+  ValueBlockCache(const ValueBlock* blocks,
+                  size_t blockCount,
+                  std::string_view compressed,
+                  std::string_view dictionary,
+                  size_t capacity)
+      : blocks_(blocks),
+        blockCount_(blockCount),
+        compressed_(compressed),
+        dictionary_(dictionary),
+        capacity_(capacity) {}
+
+  // the view into the decoded block of the value in [begin, end) of the decoded pool
+  std::string_view read(uint64_t begin, uint64_t end) {
+    if (begin == end) {
+      return {};
+    }
+    const auto* found = std::upper_bound(
+        blocks_, blocks_ + blockCount_, begin,
+        [](uint64_t offset, const ValueBlock& block) { return offset < block.begin; });
+    if (found == blocks_ || end < begin || end > found->begin) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    const size_t index = found - blocks_ - 1;
+    const std::string& text = decoded(index);
+    return std::string_view(text).substr(begin - blocks_[index].begin, end - begin);
+  }
+
+  void pin() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pins_ == 0) {  // no views of the values are being collected
+      while (decoded_.size() > capacity_) {
+        positions_.erase(decoded_.back().first);
+        decoded_.pop_back();
+      }
+    }
+    ++pins_;
+  }
+
+  void unpin() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --pins_;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return decoded_.size();
+  }
+
+private:
+  const std::string& decoded(size_t index) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto found = positions_.find(index);
+      if (found != positions_.end()) {
+        decoded_.splice(decoded_.begin(), decoded_, found->second);
+        return found->second->second;
+      }
+    }
+
+    // decoded without the lock, and the block decoded by another thread meanwhile is kept instead
+    const ValueBlock& block = blocks_[index];
+    const ValueBlock& next = blocks_[index + 1];
+    if (next.begin < block.begin || next.compressed < block.compressed ||
+        next.compressed > compressed_.size()) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    std::string text;
+    block_codec::decompress(
+        compressed_.substr(block.compressed, next.compressed - block.compressed), dictionary_,
+        next.begin - block.begin, text);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [found, inserted] = positions_.try_emplace(index);
+    if (inserted) {
+      decoded_.emplace_front(index, std::move(text));
+      found->second = decoded_.begin();
+    }
+    return found->second->second;
+  }
+
+  const ValueBlock* blocks_;
+  size_t blockCount_;
+  std::string_view compressed_;
+  std::string_view dictionary_;
+  size_t capacity_;
+
+  std::mutex mutex_;
+  size_t pins_ = 0;
+  // the decoded blocks by their indexes, the most recently used first
+  std::list<std::pair<size_t, std::string>> decoded_;
+  std::unordered_map<size_t, std::list<std::pair<size_t, std::string>>::iterator> positions_;
+};
+
+ValuePool::Pin::Pin(const ValuePool& pool) : cache_(pool.cache_.get()) {
+  if (cache_ != nullptr) {
+    cache_->pin();
+  }
+}
+
+ValuePool::Pin::~Pin() {
+  if (cache_ != nullptr) {
+    cache_->unpin();
+  }
+}
+
+ValuePool::ValueAt ValuePool::pinInBatches(ValueAt valueAt) const {
+  // the pin is released and taken again every batch, which evicts the blocks of the previous
+  // batches unless a lookup holds a pin meanwhile
+  struct State {
+    std::optional<Pin> pin;
+    size_t reads = 0;
+  };
+  auto state = std::make_shared<State>();
+  return [this, state, valueAt = std::move(valueAt)](size_t id) {
+    if (state->reads++ % VALUES_PER_PIN == 0) {
+      state->pin.reset();
+      state->pin.emplace(*this);
+    }
+    return valueAt(id);
+  };
+}
+
+ValuePool::ValuePool() = default;
+ValuePool::~ValuePool() = default;
+ValuePool::ValuePool(ValuePool&&) noexcept = default;
+ValuePool& ValuePool::operator=(ValuePool&&) noexcept = default;
+
+void ValuePool::addSections(BinaryFileWriter& writer,
+                            size_t valueCount,
+                            const ValueAt& valueAt,
+                            const Options& options) {
+  // the state shared by the section writers, which are called in the order of the sections
+  struct State {
+    std::vector<uint32_t> indexes;    // the unique value of each key id, if deduplicated
+    std::vector<uint32_t> uniqueIds;  // the first key id of each unique value, if deduplicated
+    std::string dictionary;
+    std::vector<ValueBlock> blocks;
+  };
+  auto state = std::make_shared<State>();
+  if (options.deduplicate || options.compress) {
+    writer.requireVersion(binary_format::VALUE_ENCODING_VERSION);
+  }
+
+  if (options.deduplicate) {
+    if (valueCount > std::numeric_limits<uint32_t>::max()) {
+      throw std::runtime_error("Too many keys to deduplicate the values");
+    }
+    // the unique values are copied, as a view of a value is only valid until the next one is read
+    std::unordered_map<std::string, uint32_t> uniqueIndexes;
+    state->indexes.reserve(valueCount);
+    for (size_t id = 0; id < valueCount; ++id) {
+      auto [found, inserted] = uniqueIndexes.try_emplace(
+          std::string(valueAt(id)), static_cast<uint32_t>(state->uniqueIds.size()));
+      if (inserted) {
+        state->uniqueIds.push_back(static_cast<uint32_t>(id));
+      }
+      state->indexes.push_back(found->second);
+    }
+    writer.addSection(binary_format::SectionType::ValueIndexes, binary_format::DEFAULT_ALIGNMENT,
+                      [state](auto& out) {
+                        out.writeBytes({reinterpret_cast<const char*>(state->indexes.data()),
+                                        state->indexes.size() * sizeof(uint32_t)});
+                      });
+  }
+
+  const size_t uniqueCount = options.deduplicate ? state->uniqueIds.size() : valueCount;
+  // copies the accessor, as the section writers are called after it returns
+  const auto uniqueAt = [state, valueAt](size_t index) {
+    return valueAt(state->uniqueIds.empty() ? index : state->uniqueIds[index]);
+  };
+  writer.addSection(binary_format::SectionType::ValueOffsets, binary_format::DEFAULT_ALIGNMENT,
+                    [=](auto& out) {
+                      uint64_t offset = 0;
+                      out.writeValue(offset);
+                      for (size_t index = 0; index < uniqueCount; ++index) {
+                        offset += uniqueAt(index).length();
+                        out.writeValue(offset);
+                      }
+                    });
+
+  if (!options.compress) {
+    writer.addSection(binary_format::SectionType::ValuePool, binary_format::DEFAULT_ALIGNMENT,
+                      [=](auto& out) {
+                        for (size_t index = 0; index < uniqueCount; ++index) {
+                          out.writeBytes(uniqueAt(index));
+                        }
+                      });
+    return;
+  }
+
+  std::vector<std::string> samples;
+  size_t sampleSize = 0;
+  const size_t step = std::max<size_t>(uniqueCount / MAX_DICTIONARY_SAMPLES, 1);
+  for (size_t index = 0; index < uniqueCount && sampleSize < MAX_DICTIONARY_SAMPLE_SIZE;
+       index += step) {
+    samples.emplace_back(uniqueAt(index));
+    sampleSize += samples.back().length();
+  }
+  state->dictionary = block_codec::trainDictionary({samples.begin(), samples.end()},
+                                                   DICTIONARY_CAPACITY);
+  writer.addSection(binary_format::SectionType::CompressionDictionary,
+                    binary_format::DEFAULT_ALIGNMENT,
+                    [state](auto& out) { out.writeBytes(state->dictionary); });
+
+  writer.addSection(binary_format::SectionType::CompressedValuePool,
+                    binary_format::DEFAULT_ALIGNMENT, [=](auto& out) {
+                      BlockCompressor compressor(state->dictionary);
+                      std::string block;
+                      std::string compressed;
+                      uint64_t begin = 0;
+                      uint64_t compressedSize = 0;
+                      const auto flush = [&]() {
+                        state->blocks.push_back({begin, compressedSize});
+                        compressed.clear();
+                        compressor.compress(block, compressed);
+                        out.writeBytes(compressed);
+                        begin += block.size();
+                        compressedSize += compressed.size();
+                        block.clear();
+                      };
+                      for (size_t index = 0; index < uniqueCount; ++index) {
+                        block.append(uniqueAt(index));
+                        if (block.size() >= VALUE_BLOCK_SIZE) {
+                          flush();
+                        }
+                      }
+                      if (!block.empty()) {
+                        flush();
+                      }
+                      state->blocks.push_back({begin, compressedSize});  // the end
+                    });
+  writer.addSection(binary_format::SectionType::ValueBlocks, binary_format::DEFAULT_ALIGNMENT,
+                    [state](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(state->blocks.data()),
+                                      state->blocks.size() * sizeof(ValueBlock)});
+                    });
+}
+
+void ValuePool::load(const BinaryFileReader& reader, size_t valueCount, size_t cachedBlocks) {
+  clear();
+  auto offsets = reader.section(binary_format::SectionType::ValueOffsets);
+  auto indexes = reader.findSection(binary_format::SectionType::ValueIndexes);
+  if (offsets.size() < sizeof(uint64_t) || offsets.size() % sizeof(uint64_t) != 0 ||
+      (indexes.has_value() && indexes->size() != valueCount * sizeof(uint32_t))) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  const size_t uniqueCount = offsets.size() / sizeof(uint64_t) - 1;
+  if (!indexes.has_value() && uniqueCount != valueCount) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  const auto* valueOffsets = reinterpret_cast<const uint64_t*>(offsets.data());
+
+  std::unique_ptr<ValueBlockCache> cache;
+  const char* pool = nullptr;
+  if (auto compressed = reader.findSection(binary_format::SectionType::CompressedValuePool)) {
+    auto blocks = reader.section(binary_format::SectionType::ValueBlocks);
+    auto dictionary = reader.section(binary_format::SectionType::CompressionDictionary);
+    if (blocks.empty() || blocks.size() % sizeof(ValueBlock) != 0) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    const auto* valueBlocks = reinterpret_cast<const ValueBlock*>(blocks.data());
+    const size_t blockCount = blocks.size() / sizeof(ValueBlock) - 1;
+    if (valueBlocks[blockCount].begin != valueOffsets[uniqueCount] ||
+        valueBlocks[blockCount].compressed != compressed->size()) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    cache = std::make_unique<ValueBlockCache>(valueBlocks, blockCount, compressed.value(),
+                                              dictionary, cachedBlocks);
+  } else {
+    auto values = reader.section(binary_format::SectionType::ValuePool);
+    if (valueOffsets[uniqueCount] != values.size()) {
+      throw std::runtime_error("Corrupted data file");
+    }
+    pool = values.data();
+  }
+
+  size_ = valueCount;
+  indexes_ = indexes.has_value() ? reinterpret_cast<const uint32_t*>(indexes->data()) : nullptr;
+  uniqueCount_ = uniqueCount;
+  offsets_ = valueOffsets;
+  pool_ = pool;
+  cache_ = std::move(cache);
+}
+
+void ValuePool::clear() {
+  size_ = 0;
+  indexes_ = nullptr;
+  uniqueCount_ = 0;
+  offsets_ = nullptr;
+  pool_ = nullptr;
+  cache_.reset();
+}
+
+size_t ValuePool::decodedBlocks() const {
+  return cache_ != nullptr ? cache_->size() : 0;
+}
+
+std::string_view ValuePool::at(size_t id) const {
+  const size_t index = indexes_ != nullptr ? indexes_[id] : id;
+  if (index >= uniqueCount_) {
+    throw std::runtime_error("Corrupted data file");
+  }
+  if (cache_ != nullptr) {
+    return cache_->read(offsets_[index], offsets_[index + 1]);
+  }
+  return {pool_ + offsets_[index], offsets_[index + 1] - offsets_[index]};
+}
+
+}  // namespace rime
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#include "dicts/binary_format.h"
+
+namespace rime {
+
+class ValueBlockCache;
+
+// The values of the keys of a binary trie file by the key ids, mapped in place. The identical
+// values could be stored once, and the pool of the values could be compressed in small blocks,
+// which are decoded on demand and kept in a small LRU cache, see `ParseTextFileOptions`.
+class ValuePool {
+public:
+  using ValueAt = std::function<std::string_view(size_t)>;
+
+  struct Options {
+    bool deduplicate = false;
+    bool compress = false;
+  };
+
+  // Keeps the values decoded during its lifetime, see `pin()`.
+  class Pin {
+  public:
+    explicit Pin(const ValuePool& pool);
+    ~Pin();
+
+    Pin(const Pin&) = delete;
+    Pin(Pin&&) = delete;
+    Pin& operator=(const Pin&) = delete;
+    Pin& operator=(Pin&&) = delete;
+
+  private:
+    ValueBlockCache* cache_;
+  };
+
+  ValuePool();
+  ~ValuePool();
+  ValuePool(ValuePool&&) noexcept;
+  ValuePool& operator=(ValuePool&&) noexcept;
+  ValuePool(const ValuePool&) = delete;
+  ValuePool& operator=(const ValuePool&) = delete;
+
+  // Adds the sections of the values of the key ids, which are read by `valueAt` when the file is
+  // written, so `valueAt` should outlive the writing. The view of a value is only used until the
+  // next value is read, see `pinInBatches`.
+  static void addSections(BinaryFileWriter& writer,
+                          size_t valueCount,
+                          const ValueAt& valueAt,
+                          const Options& options);
+  // Points to the sections in the mapped file, keeping up to `cachedBlocks` decoded blocks if the
+  // values are compressed. Throws std::runtime_error if the sections are corrupted.
+  void load(const BinaryFileReader& reader, size_t valueCount, size_t cachedBlocks);
+  void clear();
+
+  [[nodiscard]] size_t size() const { return size_; }
+  // the blocks of the compressed values decoded and kept in the cache, 0 if not compressed
+  [[nodiscard]] size_t decodedBlocks() const;
+  // how the loaded values are stored, to be saved the same way
+  [[nodiscard]] Options options() const { return {indexes_ != nullptr, cache_ != nullptr}; }
+  // Returns the value of the key id, a view into the mapped file, or into a decoded block if the
+  // values are compressed. Throws std::runtime_error if the block is corrupted.
+  [[nodiscard]] std::string_view at(size_t id) const;
+
+  // The decoded blocks are evicted from the cache only when a pin is taken without any other pin
+  // alive, i.e. at the beginning of a lookup, so that the views of the values returned by the
+  // previous lookup stay valid until the next one.
+  [[nodiscard]] Pin pin() const { return Pin(*this); }
+  // Returns the accessor reading the values one after another, e.g. to rebuild or save them, under
+  // a new pin for every batch of the values. The cache then keeps the blocks of the recent values
+  // only, instead of decoding and keeping all of them. The view of a value is valid until the
+  // next value is read.
+  [[nodiscard]] ValueAt pinInBatches(ValueAt valueAt) const;
+
+private:
+  size_t size_ = 0;
+  const uint32_t* indexes_ = nullptr;  // the unique value of each key id, if deduplicated
+  size_t uniqueCount_ = 0;
+  const uint64_t* offsets_ = nullptr;  // uniqueCount_ + 1 offsets into the (decoded) pool
+  const char* pool_ = nullptr;         // if not compressed
+  // the compressed blocks and the decoded ones, if compressed
+  std::unique_ptr<ValueBlockCache> cache_;
+};
+
+}  // namespace rime
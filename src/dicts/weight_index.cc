@@ -0,0 +1,140 @@
+#include "dicts/weight_index.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+
+#include "dicts/dictionary.h"
+
+namespace rime {
+
+static std::optional<double> parseColumn(std::string_view item, const WeightIndex::Column& column) {
+  size_t begin = 0;
+  for (size_t i = 1; i < column.index; ++i) {
+    if (column.delimiter.empty()) {
+      return std::nullopt;
+    }
+    const size_t pos = item.find(column.delimiter, begin);
+    if (pos == std::string_view::npos) {
+      return std::nullopt;
+    }
+    begin = pos + column.delimiter.length();
+  }
+  const size_t end = column.delimiter.empty() ? std::string_view::npos
+                                              : item.find(column.delimiter, begin);
+  const std::string text(item.substr(begin, end == std::string_view::npos ? end : end - begin));
+
+  char* parsed = nullptr;
+  const double weight = std::strtod(text.c_str(), &parsed);
+  return parsed == text.c_str() ? std::nullopt : std::make_optional(weight);
+}
+
+double WeightIndex::parseWeight(std::string_view value,
+                                const Column& column,
+                                std::string_view concatSeparator) {
+  std::optional<double> result;
+  Dictionary::forEachItem(value, concatSeparator, [&](std::string_view item) {
+    auto weight = parseColumn(item, column);
+    if (weight.has_value() && (!result.has_value() || weight.value() > result.value())) {
+      result = weight;
+    }
+  });
+  return result.value_or(0);
+}
+
+void WeightIndex::build(Column column, std::vector<double> weights) {
+  if (weights.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Failed to index the weights of the keys");
+  }
+
+  column_ = std::move(column);
+  ownedWeights_ = std::move(weights);
+  size_ = ownedWeights_.size();
+  weights_ = ownedWeights_.data();
+
+  ownedTree_.assign(size_, 0);
+  tree_ = ownedTree_.data();
+  for (size_t node = size_; node-- > 1;) {  // the children before the parents
+    ownedTree_[node] =
+        static_cast<uint32_t>(heavier(nodeValue(node * 2), nodeValue(node * 2 + 1)));
+  }
+}
+
+void WeightIndex::clear() {
+  column_ = Column{};
+  size_ = 0;
+  weights_ = nullptr;
+  tree_ = nullptr;
+  ownedWeights_.clear();
+  ownedTree_.clear();
+}
+
+void WeightIndex::addSections(BinaryFileWriter& writer) const {
+  if (empty()) {
+    return;
+  }
+  writer.addSection(binary_format::SectionType::WeightColumn, binary_format::DEFAULT_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeValue(static_cast<uint64_t>(column_.index));
+                      out.writeBytes(column_.delimiter);
+                    });
+  writer.addSection(binary_format::SectionType::KeyWeights, binary_format::DEFAULT_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(weights_),
+                                      size_ * sizeof(double)});
+                    });
+  writer.addSection(binary_format::SectionType::WeightTree, binary_format::DEFAULT_ALIGNMENT,
+                    [this](auto& out) {
+                      out.writeBytes({reinterpret_cast<const char*>(tree_),
+                                      size_ * sizeof(uint32_t)});
+                    });
+}
+
+void WeightIndex::load(const BinaryFileReader& reader, size_t keyCount) {
+  clear();
+  auto column = reader.findSection(binary_format::SectionType::WeightColumn);
+  if (!column.has_value()) {
+    return;
+  }
+
+  auto weights = reader.section(binary_format::SectionType::KeyWeights);
+  auto tree = reader.section(binary_format::SectionType::WeightTree);
+  if (column->size() < sizeof(uint64_t) || weights.size() != keyCount * sizeof(double) ||
+      tree.size() != keyCount * sizeof(uint32_t)) {
+    throw std::runtime_error("Corrupted data file");
+  }
+
+  uint64_t index = 0;
+  std::copy_n(column->data(), sizeof(index), reinterpret_cast<char*>(&index));
+  column_.index = index;
+  column_.delimiter = column->substr(sizeof(index));
+  size_ = keyCount;
+  weights_ = reinterpret_cast<const double*>(weights.data());
+  tree_ = reinterpret_cast<const uint32_t*>(tree.data());
+}
+
+size_t WeightIndex::heavier(size_t a, size_t b) const {
+  if (a == std::numeric_limits<size_t>::max()) {
+    return b;
+  }
+  const double weightA = weightAt(a);
+  const double weightB = weightAt(b);
+  return weightA > weightB || (weightA == weightB && a < b) ? a : b;
+}
+
+size_t WeightIndex::heaviest(size_t begin, size_t end) const {
+  size_t result = std::numeric_limits<size_t>::max();
+  for (begin += size_, end += size_; begin < end; begin /= 2, end /= 2) {
+    if (begin % 2 == 1) {
+      result = heavier(result, nodeValue(begin++));
+    }
+    if (end % 2 == 1) {
+      result = heavier(result, nodeValue(--end));
+    }
+  }
+  return result;
+}
+
+}  // namespace rime
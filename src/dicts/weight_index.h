@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dicts/binary_format.h"
+
+namespace rime {
+
+// The weights of the keys of a trie in the byte order of the keys, to find the heaviest keys
+// starting with a prefix. The keys starting with a prefix are a range of that order, and a segment
+// tree over it finds the heaviest key of any range in O(log n), so that the top k keys of a prefix
+// are found by splitting the range at the heaviest key k times, without visiting the other keys.
+class WeightIndex {
+public:
+  // the column and the delimiter of the weights in the values, empty if the keys are not weighted
+  struct Column {
+    size_t index = 0;  // counted from 1 in the value split by the delimiter, 0 for no weights
+    std::string delimiter;
+  };
+
+  // Parses the weight in the column of a value, or the max weight of the items of a concatenated
+  // value. The weight of a value without the column or with an invalid number is 0.
+  static double parseWeight(std::string_view value,
+                            const Column& column,
+                            std::string_view concatSeparator);
+
+  // Builds the index from the weights of the keys in the byte order.
+  void build(Column column, std::vector<double> weights);
+  void clear();
+
+  void addSections(BinaryFileWriter& writer) const;
+  // Points to the sections in the mapped file, or clears the index if the file has no weights.
+  // Throws std::runtime_error if the sections are corrupted.
+  void load(const BinaryFileReader& reader, size_t keyCount);
+
+  [[nodiscard]] bool empty() const { return column_.index == 0; }
+  [[nodiscard]] const Column& column() const { return column_; }
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] double weightAt(size_t position) const { return weights_[position]; }
+  // Returns the position of the heaviest key in [begin, end), the earlier one for the same weight.
+  [[nodiscard]] size_t heaviest(size_t begin, size_t end) const;
+
+private:
+  // the position of the heaviest key under a node, the leaves are the positions themselves
+  [[nodiscard]] size_t nodeValue(size_t node) const {
+    return node >= size_ ? node - size_ : tree_[node];
+  }
+  [[nodiscard]] size_t heavier(size_t a, size_t b) const;
+
+  Column column_;
+  size_t size_ = 0;
+  const double* weights_ = nullptr;
+  // the internal nodes of a bottom-up segment tree over the weights, tree_[0] is unused
+  const uint32_t* tree_ = nullptr;
+  std::vector<double> ownedWeights_;
+  std::vector<uint32_t> ownedTree_;
+};
+
+}  // namespace rime
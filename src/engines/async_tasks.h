@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// Runs the work of the async functions exposed to JS on a background thread, and queues the
+// settlements of their promises to be run on the JS thread, since a JS context could only be used
+// by one thread at a time. The engine runs the settlements in `runPendingJobs()`.
+template <typename T_JS_VALUE>
+class AsyncTasks {
+public:
+  // returns the value to resolve the promise with, or throws to reject it
+  using Settler = std::function<T_JS_VALUE()>;
+
+  AsyncTasks() = default;
+  ~AsyncTasks() = default;
+
+  AsyncTasks(const AsyncTasks&) = delete;
+  AsyncTasks(AsyncTasks&&) = delete;
+  AsyncTasks& operator=(const AsyncTasks&) = delete;
+  AsyncTasks& operator=(AsyncTasks&&) = delete;
+
+  // Runs the work on the background thread, and queues the settler of the promise after it. If the
+  // work throws, the promise is rejected with the error message instead.
+  void run(uint64_t promiseId, std::function<void()> work, Settler settle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pool_ == nullptr) {
+      pool_ = std::make_unique<ThreadPool>(1);
+    }
+    pool_->submit([this, promiseId, work = std::move(work), settle = std::move(settle)]() mutable {
+      try {
+        work();
+      } catch (const std::exception& e) {
+        settle = [message = std::string(e.what())]() -> T_JS_VALUE {
+          throw std::runtime_error(message);
+        };
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished_.emplace_back(promiseId, std::move(settle));
+    });
+  }
+
+  // Takes the settlers of the finished work, in the order the work was finished.
+  [[nodiscard]] std::vector<std::pair<uint64_t, Settler>> takeFinished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::exchange(finished_, {});
+  }
+
+  [[nodiscard]] uint64_t nextPromiseId() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ++lastPromiseId_;
+  }
+
+private:
+  std::mutex mutex_;
+  uint64_t lastPromiseId_ = 0;
+  std::vector<std::pair<uint64_t, Settler>> finished_;
+  // created on the first task, and declared last to join the worker before the other members die
+  std::unique_ptr<ThreadPool> pool_;
+};
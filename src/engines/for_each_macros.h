@@ -58,16 +58,26 @@
 #define FOR_EACH_PAIR_14(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_13(macro, __VA_ARGS__))
 #define FOR_EACH_PAIR_15(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_14(macro, __VA_ARGS__))
 #define FOR_EACH_PAIR_16(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_15(macro, __VA_ARGS__))
+#define FOR_EACH_PAIR_17(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_16(macro, __VA_ARGS__))
+#define FOR_EACH_PAIR_18(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_17(macro, __VA_ARGS__))
+#define FOR_EACH_PAIR_19(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_18(macro, __VA_ARGS__))
+#define FOR_EACH_PAIR_20(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_19(macro, __VA_ARGS__))
+#define FOR_EACH_PAIR_21(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_20(macro, __VA_ARGS__))
+#define FOR_EACH_PAIR_22(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_21(macro, __VA_ARGS__))
+#define FOR_EACH_PAIR_23(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_22(macro, __VA_ARGS__))
+#define FOR_EACH_PAIR_24(macro, x, y, ...) macro(x, y) EXPAND(FOR_EACH_PAIR_23(macro, __VA_ARGS__))
 
 // Get number of argument pairs
-#define COUNT_PAIRS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17,   \
-                     _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, \
-                     ...)                                                                          \
+#define COUNT_PAIRS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, \
+                     _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32,  \
+                     _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47,  \
+                     _48, N, ...)                                                                \
   N
 
-#define COUNT_PAIRS(...)                                                                           \
-  COUNT_PAIRS_(__VA_ARGS__, 16, 16, 15, 15, 14, 14, 13, 13, 12, 12, 11, 11, 10, 10, 9, 9, 8, 8, 7, \
-               7, 6, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 0, 0)
+#define COUNT_PAIRS(...)                                                                         \
+  COUNT_PAIRS_(__VA_ARGS__, 24, 24, 23, 23, 22, 22, 21, 21, 20, 20, 19, 19, 18, 18, 17, 17, 16,  \
+               16, 15, 15, 14, 14, 13, 13, 12, 12, 11, 11, 10, 10, 9, 9, 8, 8, 7, 7, 6, 6, 5, 5, \
+               4, 4, 3, 3, 2, 2, 1, 0, 0)
 
 // Select the appropriate FOR_EACH_PAIR macro based on pair count
 #define INTERNAL_FOR_EACH_PAIR_N(N, macro, ...) FOR_EACH_PAIR_##N(macro, __VA_ARGS__)
@@ -2,9 +2,11 @@
 
 #include <JavaScriptCore/JavaScript.h>
 #include <JavaScriptCore/JavaScriptCore.h>
+#include <functional>
 #include <memory>
 #include <mutex>
 
+#include "engines/async_tasks.h"
 #include "engines/javascriptcore/jsc_engine_impl.h"
 #include "engines/javascriptcore/jsc_string_raii.hpp"
 #include "engines/js_exception.h"
@@ -18,6 +20,7 @@ class JsEngine<JSValueRef> {
   inline static bool isInitialized = false;
   inline static std::mutex instanceMutex;
   std::unique_ptr<JscEngineImpl> impl_{std::make_unique<JscEngineImpl>()};
+  AsyncTasks<JSValueRef> asyncTasks_;
 
   JsEngine<JSValueRef>() = default;
 
@@ -283,6 +286,7 @@ public:
     return JSValueMakeString(impl_->getContext(), JscStringRAII(str));
   }
   [[nodiscard]] JSValueRef wrap(const std::string& str) const { return wrap(str.c_str()); }
+  [[nodiscard]] JSValueRef wrap(std::string_view str) const { return wrap(std::string(str)); }
   [[nodiscard]] JSValueRef wrap(bool value) const {
     return JSValueMakeBoolean(impl_->getContext(), value);
   }
@@ -311,4 +315,24 @@ public:
   }
 
   JSValueRef getGlobalObject() { return impl_->getGlobalObject(); }
+
+  // Runs the work on a background thread and returns a promise of it. The promise is settled in the
+  // next `runPendingJobs()` after the work is done: resolved with the value returned by `settle`,
+  // or rejected with the message of the std::exception thrown by the work or `settle`.
+  JSValueRef runAsync(std::function<void()> work, std::function<JSValueRef()> settle) {
+    const uint64_t promiseId = asyncTasks_.nextPromiseId();
+    JSObjectRef promise = impl_->newPromise(promiseId);
+    if (promise != nullptr) {
+      asyncTasks_.run(promiseId, std::move(work), std::move(settle));
+    }
+    return promise;
+  }
+
+  // Settles the promises of the finished async work. JavaScriptCore runs the jobs of the promises
+  // by itself when the API calls return.
+  void runPendingJobs() {
+    for (auto& [promiseId, settle] : asyncTasks_.takeFinished()) {
+      impl_->settlePromise(promiseId, settle);
+    }
+  }
 };
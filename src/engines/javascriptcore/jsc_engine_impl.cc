@@ -2,11 +2,18 @@
 #include "engines/javascriptcore/jsc_code_loader.h"
 #include "engines/javascriptcore/jsc_string_raii.hpp"
 
+#include <exception>
+
 JscEngineImpl::JscEngineImpl() : ctx_(JSGlobalContextCreate(nullptr)) {
   exposeLogToJsConsole(ctx_);
 }
 
 JscEngineImpl::~JscEngineImpl() {
+  for (auto& [promiseId, resolvingFuncs] : pendingPromises_) {
+    JSValueUnprotect(ctx_, resolvingFuncs.first);
+    JSValueUnprotect(ctx_, resolvingFuncs.second);
+  }
+  pendingPromises_.clear();
   for (auto& clazz : clazzes_) {
     auto& clazzDef = clazz.second;
     JSClassRelease(clazzDef);
@@ -325,3 +332,44 @@ JSValueRef JscEngineImpl::jsError(JSContextRef ctx,
   google::LogMessage("$jsc$", 0, google::GLOG_ERROR).stream() << message;
   return JSValueMakeUndefined(ctx);
 }
+
+JSObjectRef JscEngineImpl::newPromise(uint64_t promiseId) {
+  JSObjectRef resolve = nullptr;
+  JSObjectRef reject = nullptr;
+  JSValueRef exception = nullptr;
+  JSObjectRef promise = JSObjectMakeDeferredPromise(ctx_, &resolve, &reject, &exception);
+  if (exception != nullptr) {
+    logErrorStackTrace(exception, __FILE_NAME__, __LINE__);
+    return nullptr;
+  }
+  JSValueProtect(ctx_, resolve);
+  JSValueProtect(ctx_, reject);
+  pendingPromises_[promiseId] = {resolve, reject};
+  return promise;
+}
+
+void JscEngineImpl::settlePromise(uint64_t promiseId, const std::function<JSValueRef()>& settle) {
+  auto it = pendingPromises_.find(promiseId);
+  if (it == pendingPromises_.end()) {
+    return;  // created by the context before the engine was reset
+  }
+  auto [resolve, reject] = it->second;
+  pendingPromises_.erase(it);
+
+  JSObjectRef func = resolve;
+  JSValueRef value = nullptr;
+  try {
+    value = settle();
+  } catch (const std::exception& e) {
+    func = reject;
+    JSValueRef message = JSValueMakeString(ctx_, JscStringRAII(e.what()));
+    value = JSObjectMakeError(ctx_, 1, &message, nullptr);
+  }
+  JSValueRef exception = nullptr;
+  JSObjectCallAsFunction(ctx_, func, nullptr, 1, &value, &exception);
+  if (exception != nullptr) {
+    logErrorStackTrace(exception, __FILE_NAME__, __LINE__);
+  }
+  JSValueUnprotect(ctx_, resolve);
+  JSValueUnprotect(ctx_, reject);
+}
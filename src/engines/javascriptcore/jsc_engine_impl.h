@@ -3,6 +3,8 @@
 #include <JavaScriptCore/JavaScript.h>
 #include <JavaScriptCore/JavaScriptCore.h>
 #include <glog/logging.h>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -69,6 +71,12 @@ public:
 
   [[nodiscard]] const JSClassRef& getRegisteredClass(const std::string& typeName) const;
 
+  // Creates a pending promise to be settled by the id, or returns nullptr on failure.
+  JSObjectRef newPromise(uint64_t promiseId);
+  // Resolves the promise with the value returned by `settle`, or rejects it with the message of the
+  // std::exception thrown by `settle`. The promises of the unknown ids are ignored.
+  void settlePromise(uint64_t promiseId, const std::function<JSValueRef()>& settle);
+
   static void exposeLogToJsConsole(JSContextRef ctx);
 
 private:
@@ -88,4 +96,6 @@ private:
   JSGlobalContextRef ctx_{nullptr};
   std::string baseFolderPath_;
   std::unordered_map<std::string, JSClassRef> clazzes_;
+  // the resolving functions of the pending promises by their ids, protected from GC
+  std::unordered_map<uint64_t, std::pair<JSObjectRef, JSObjectRef>> pendingPromises_;
 };
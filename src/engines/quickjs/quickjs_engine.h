@@ -1,9 +1,11 @@
 #pragma once
 
 #include <quickjs.h>
+#include <functional>
 #include <memory>
 #include <mutex>
 
+#include "engines/async_tasks.h"
 #include "engines/js_exception.h"
 #include "engines/js_traits.h"
 #include "engines/quickjs/quickjs_engine_impl.h"
@@ -18,6 +20,7 @@ class JsEngine<JSValue> {
   inline static bool isInitialized = false;
 
   std::unique_ptr<QuickJsEngineImpl> impl_{std::make_unique<QuickJsEngineImpl>()};
+  AsyncTasks<JSValue> asyncTasks_;
 
   JsEngine() { isInitialized = true; };
 
@@ -210,6 +213,7 @@ public:
 
   [[nodiscard]] JSValue wrap(const char* str) const { return impl_->toJsString(str); }
   [[nodiscard]] JSValue wrap(const std::string& str) const { return impl_->toJsString(str); }
+  [[nodiscard]] JSValue wrap(std::string_view str) const { return impl_->toJsString(str); }
   [[nodiscard]] JSValue wrap(bool value) const { return JS_NewBool(impl_->getContext(), value); }
   [[nodiscard]] JSValue wrap(size_t value) const {
     return impl_->toJsNumber(static_cast<int64_t>(value));
@@ -237,4 +241,26 @@ public:
   [[nodiscard]] JSValue throwError(JsErrorType errorType, const std::string& message) const {
     return impl_->throwError(errorType, message);
   }
+
+  // Runs the work on a background thread and returns a promise of it. The promise is settled in the
+  // next `runPendingJobs()` after the work is done: resolved with the value returned by `settle`,
+  // or rejected with the message of the std::exception thrown by the work or `settle`.
+  [[nodiscard]] JSValue runAsync(std::function<void()> work, std::function<JSValue()> settle) {
+    const uint64_t promiseId = asyncTasks_.nextPromiseId();
+    JSValue promise = impl_->newPromise(promiseId);
+    if (!JS_IsException(promise)) {
+      asyncTasks_.run(promiseId, std::move(work), std::move(settle));
+    }
+    return promise;
+  }
+
+  // Settles the promises of the finished async work, and runs the pending jobs of the promises,
+  // e.g. the `then` callbacks. To be called by the host before calling into JS, as there is no
+  // event loop in the IME.
+  void runPendingJobs() {
+    for (auto& [promiseId, settle] : asyncTasks_.takeFinished()) {
+      impl_->settlePromise(promiseId, settle);
+    }
+    impl_->runPendingJobs();
+  }
 };
@@ -2,6 +2,8 @@
 #include "engines/quickjs/quickjs_code_loader.h"
 #include "quickjs.h"
 
+#include <exception>
+
 QuickJsEngineImpl::QuickJsEngineImpl()
     : runtime_(JS_NewRuntime()), context_(JS_NewContext(runtime_)) {
   // Do not trigger GC when heap size is less than 16MB
@@ -14,6 +16,11 @@ QuickJsEngineImpl::QuickJsEngineImpl()
 }
 
 QuickJsEngineImpl::~QuickJsEngineImpl() {
+  for (auto& [promiseId, resolvingFuncs] : pendingPromises_) {
+    JS_FreeValue(context_, resolvingFuncs.first);
+    JS_FreeValue(context_, resolvingFuncs.second);
+  }
+  pendingPromises_.clear();
   JS_FreeContext(context_);
   JS_FreeRuntime(runtime_);
   registeredTypes_.clear();
@@ -278,3 +285,49 @@ JSValue QuickJsEngineImpl::jsError(JSContext* ctx,
   google::LogMessage("$qjs$", 0, google::GLOG_ERROR).stream() << logToStringStream(ctx, argc, argv);
   return JS_UNDEFINED;
 }
+
+JSValue QuickJsEngineImpl::newPromise(uint64_t promiseId) {
+  JSValue resolvingFuncs[2];  // NOLINT(modernize-avoid-c-arrays)
+  JSValue promise = JS_NewPromiseCapability(context_, resolvingFuncs);
+  if (!JS_IsException(promise)) {
+    pendingPromises_[promiseId] = {resolvingFuncs[0], resolvingFuncs[1]};
+  }
+  return promise;
+}
+
+void QuickJsEngineImpl::settlePromise(uint64_t promiseId, const std::function<JSValue()>& settle) {
+  auto it = pendingPromises_.find(promiseId);
+  if (it == pendingPromises_.end()) {
+    return;  // created by the context before the engine was reset
+  }
+  auto [resolve, reject] = it->second;
+  pendingPromises_.erase(it);
+
+  JSValue func = resolve;
+  JSValue value = JS_UNDEFINED;
+  try {
+    value = settle();
+  } catch (const std::exception& e) {
+    func = reject;
+    JS_FreeValue(context_, throwError(JsErrorType::GENERIC, e.what()));
+    value = JS_GetException(context_);
+  }
+  JSValue ret = JS_Call(context_, func, JS_UNDEFINED, 1, &value);
+  if (JS_IsException(ret)) {
+    logErrorStackTrace(ret, __FILE_NAME__, __LINE__);
+  }
+  JS_FreeValue(context_, ret);
+  JS_FreeValue(context_, value);
+  JS_FreeValue(context_, resolve);
+  JS_FreeValue(context_, reject);
+}
+
+void QuickJsEngineImpl::runPendingJobs() {
+  JSContext* ctx = nullptr;
+  int ret = 0;
+  while ((ret = JS_ExecutePendingJob(runtime_, &ctx)) != 0) {
+    if (ret < 0) {
+      logErrorStackTrace(JS_EXCEPTION, __FILE_NAME__, __LINE__);
+    }
+  }
+}
@@ -3,8 +3,10 @@
 #include <glog/logging.h>
 #include <quickjs.h>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include "engines/js_exception.h"
@@ -52,11 +54,21 @@ public:
   [[nodiscard]] JSValue getGlobalObject() const;
   [[nodiscard]] JSValue throwError(JsErrorType errorType, const std::string& message) const;
 
+  // Creates a pending promise to be settled by the id.
+  [[nodiscard]] JSValue newPromise(uint64_t promiseId);
+  // Resolves the promise with the value returned by `settle`, or rejects it with the message of the
+  // std::exception thrown by `settle`. The promises of the unknown ids are ignored.
+  void settlePromise(uint64_t promiseId, const std::function<JSValue()>& settle);
+  void runPendingJobs();
+
   // Type conversion utilities
   [[nodiscard]] JSValue toJsString(const char* str) const { return JS_NewString(context_, str); }
   [[nodiscard]] JSValue toJsString(const std::string& str) const {
     return JS_NewString(context_, str.c_str());
   }
+  [[nodiscard]] JSValue toJsString(std::string_view str) const {
+    return JS_NewStringLen(context_, str.data(), str.length());
+  }
   [[nodiscard]] std::string toStdString(const JSValue& value) const;
   [[nodiscard]] JSValue toJsNumber(double value) const { return JS_NewFloat64(context_, value); }
   [[nodiscard]] JSValue toJsNumber(int64_t value) const { return JS_NewInt64(context_, value); }
@@ -91,5 +103,7 @@ private:
   JSRuntime* runtime_;
   JSContext* context_;
   std::unordered_map<std::string, JSClassID> registeredTypes_;
+  // the resolving functions of the pending promises by their ids
+  std::unordered_map<uint64_t, std::pair<JSValue, JSValue>> pendingPromises_;
   std::string baseFolderPath_;  // absolute path to the base folder of the js files
 };
@@ -91,6 +91,7 @@ public:
     }
 
     auto& jsEngine = JsEngine<T_JS_VALUE>::instance();
+    jsEngine.runPendingJobs();  // to settle the promises of the async work, e.g. dictionary loading
     if (jsEngine.isFunction(funcIsApplicable_)) {
       auto jsEvn = jsEngine.wrap(environment);
       T_JS_VALUE args[1] = {jsEvn};
@@ -33,6 +33,7 @@ protected:
     finalizer_ = jsEngine.toObject(jsEngine.getObjectProperty(instance_, "finalizer"));
 
     jsEngine.protectFromGC(instance_, mainFunc_, finalizer_);
+    jsEngine.runPendingJobs();  // the `then` callbacks of the promises created in the constructor
 
     isLoaded_ = true;
     LOG(INFO) << "[qjs] created an instance of the exported class in " << nameSpace;
@@ -19,6 +19,7 @@ public:
     }
 
     auto& engine = JsEngine<T_JS_VALUE>::instance();
+    engine.runPendingJobs();  // to settle the promises of the async work, e.g. dictionary loading
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
     T_JS_VALUE jsKeyEvt = engine.wrap(const_cast<rime::KeyEvent*>(&keyEvent));
     auto jsEnvironment = engine.wrap(environment);
@@ -28,6 +28,7 @@ public:
     }
 
     auto& engine = JsEngine<T_JS_VALUE>::instance();
+    engine.runPendingJobs();  // to settle the promises of the async work, e.g. dictionary loading
     T_JS_VALUE jsInput = engine.wrap(input);
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
     T_JS_VALUE jsSegment = engine.wrap(const_cast<Segment*>(&segment));
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A fixed-size pool of worker threads, the tasks are run in the order of submission.
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threads) {
+    threads = std::max<size_t>(threads, 1);
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this] { run(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  // waits for the pending tasks to finish
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    condition_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  // the number of threads to use when it's not specified, i.e. 0
+  static size_t resolveThreadCount(size_t threads) {
+    if (threads > 0) {
+      return threads;
+    }
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+
+  // The pool of a thread per hardware thread shared by the batch lookups, started on its first
+  // use instead of starting and joining the threads of every batch. It's never destroyed, as
+  // joining the threads at exit could deadlock while the module is unloaded. A task on it should
+  // not wait for the other tasks on it, which could be queued behind the waiting one.
+  static ThreadPool& shared() {
+    static auto* pool = new ThreadPool(resolveThreadCount(0));
+    return *pool;
+  }
+
+  // Runs `task(begin, end)` on the ranges splitting [0, count) evenly, up to `threads` ranges with
+  // at least `minRangeSize` items per range, on the shared pool and the calling thread, or in the
+  // calling thread only if there are too few items. The first exception of the tasks is rethrown
+  // after all of them are done.
+  template <typename F>
+  static void forEachRange(size_t count, size_t threads, size_t minRangeSize, F&& task) {
+    const size_t ranges =
+        std::min(resolveThreadCount(threads), count / std::max<size_t>(minRangeSize, 1));
+    if (ranges <= 1) {
+      task(size_t{0}, count);
+      return;
+    }
+
+    auto& pool = shared();
+    std::vector<std::future<void>> futures;
+    futures.reserve(ranges - 1);
+    for (size_t i = 1; i < ranges; ++i) {
+      const size_t begin = count * i / ranges;
+      const size_t end = count * (i + 1) / ranges;
+      futures.push_back(pool.submit([&task, begin, end] { task(begin, end); }));
+    }
+    // all the tasks are waited for, as they refer to the task
+    std::exception_ptr error;
+    try {
+      task(size_t{0}, count / ranges);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    for (auto& future : futures) {
+      try {
+        future.get();
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  [[nodiscard]] size_t size() const { return workers_.size(); }
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F&& task) {
+    // std::function requires a copyable callable
+    auto packaged =
+        std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+    auto future = packaged->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace([packaged] { (*packaged)(); });
+    }
+    condition_.notify_one();
+    return future;
+  }
+
+private:
+  void run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return;  // stopping
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_ = false;
+};
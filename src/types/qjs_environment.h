@@ -6,8 +6,15 @@
 
 #include "engines/js_exception.h"
 #include "engines/js_macros.h"
+#include "dicts/dictionary_registry.h"
 #include "environment.h"
 #include "js_wrapper.h"
+#include "types/qjs_double_array_trie.h"
+#include "types/qjs_fst.h"
+#include "types/qjs_sharded_trie.h"
+#include "types/qjs_leveldb.h"
+#include "types/qjs_sorted_text_dictionary.h"
+#include "types/qjs_trie.h"
 
 using namespace rime;
 
@@ -58,11 +65,113 @@ class JsWrapper<Environment> {
     }
   })
 
+  DEFINE_CFUNCTION_ARGC(openTrie, 1, {
+    std::string path = engine.toStdString(argv[0]);
+    TrieLoadOptions options;
+    if (argc > 1) {
+      options = parseTrieLoadOptions(engine, argv[1]);
+    }
+    try {
+      return engine.wrap(DictionaryRegistry::instance().openTrie(path, options));
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "openTrie of " << path << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(openDoubleArrayTrie, 1, {
+    std::string path = engine.toStdString(argv[0]);
+    TrieLoadOptions options;
+    if (argc > 1) {
+      options = parseTrieLoadOptions(engine, argv[1]);
+    }
+    try {
+      return engine.wrap(DictionaryRegistry::instance().openDoubleArrayTrie(path, options));
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "openDoubleArrayTrie of " << path << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(openFst, 1, {
+    std::string path = engine.toStdString(argv[0]);
+    TrieLoadOptions options;
+    if (argc > 1) {
+      options = parseTrieLoadOptions(engine, argv[1]);
+    }
+    try {
+      return engine.wrap(DictionaryRegistry::instance().openFst(path, options));
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "openFst of " << path << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(openShardedTrie, 1, {
+    std::string path = engine.toStdString(argv[0]);
+    TrieLoadOptions options;
+    if (argc > 1) {
+      options = parseTrieLoadOptions(engine, argv[1]);
+    }
+    try {
+      return engine.wrap(DictionaryRegistry::instance().openShardedTrie(path, options));
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "openShardedTrie of " << path << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(openSortedTextDictionary, 1, {
+    std::string path = engine.toStdString(argv[0]);
+    ParseTextFileOptions options;
+    if (argc > 1) {
+      options = parseTextFileOptions(engine, argv[1]);
+    }
+    try {
+      return engine.wrap(DictionaryRegistry::instance().openSortedTextDictionary(path, options));
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "openSortedTextDictionary of " << path << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(openLevelDb, 1, {
+    std::string path = engine.toStdString(argv[0]);
+    LevelDbOptions options;
+    if (argc > 1) {
+      options = parseLevelDbOptions(engine, argv[1]);
+    }
+    try {
+      return engine.wrap(DictionaryRegistry::instance().openLevelDb(path, options));
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "openLevelDb of " << path << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
 public:
-  EXPORT_CLASS_WITH_RAW_POINTER(
-      Environment,
-      WITHOUT_CONSTRUCTOR,
-      WITHOUT_PROPERTIES,
-      WITH_GETTERS(id, engine, namespace, userDataDir, sharedDataDir, os),
-      WITH_FUNCTIONS(loadFile, 1, fileExists, 1, getRimeInfo, 0, popen, 1));
+  EXPORT_CLASS_WITH_RAW_POINTER(Environment,
+                                WITHOUT_CONSTRUCTOR,
+                                WITHOUT_PROPERTIES,
+                                WITH_GETTERS(id, engine, namespace, userDataDir, sharedDataDir, os),
+                                WITH_FUNCTIONS(loadFile,
+                                               1,
+                                               fileExists,
+                                               1,
+                                               getRimeInfo,
+                                               0,
+                                               popen,
+                                               1,
+                                               openTrie,
+                                               1,
+                                               openDoubleArrayTrie,
+                                               1,
+                                               openFst,
+                                               1,
+                                               openShardedTrie,
+                                               1,
+                                               openSortedTextDictionary,
+                                               1,
+                                               openLevelDb,
+                                               1));
 };
@@ -1,11 +1,24 @@
 #pragma once
 
 #include <glog/logging.h>
+#include <string>
 
 #include "dicts/leveldb.h"
+#include "engines/js_exception.h"
 #include "engines/js_macros.h"
 #include "js_wrapper.h"
 
+// Returns a count or a size passed from JS, which is cast to size_t. Throws JsException if it's
+// negative or not a number, instead of wrapping around to a huge one.
+template <typename T>
+static size_t toSize(const JsEngine<T>& engine, T value, const char* name) {
+  const double number = engine.toDouble(value);
+  if (!(number >= 0)) {
+    throw JsException(JsErrorType::RANGE, std::string(name) + " should be a non-negative number");
+  }
+  return engine.toInt(value);
+}
+
 template <typename T>
 static ParseTextFileOptions parseTextFileOptions(const JsEngine<T>& engine, T jsOptions) {
   ParseTextFileOptions result;
@@ -50,9 +63,137 @@ static ParseTextFileOptions parseTextFileOptions(const JsEngine<T>& engine, T js
   if (!engine.isUndefined(jsConcatSeparator)) {
     result.concatSeparator = engine.toStdString(jsConcatSeparator);
   }
+  auto jsThreads = engine.getObjectProperty(objOptions, "threads");
+  if (!engine.isUndefined(jsThreads)) {
+    result.threads = engine.toInt(jsThreads);
+  }
+  auto jsMemoryBudget = engine.getObjectProperty(objOptions, "memoryBudget");
+  if (!engine.isUndefined(jsMemoryBudget)) {
+    result.memoryBudget = engine.toInt(jsMemoryBudget);
+  }
+  auto jsWeightColumn = engine.getObjectProperty(objOptions, "weightColumn");
+  if (!engine.isUndefined(jsWeightColumn)) {
+    result.weightColumn = engine.toInt(jsWeightColumn);
+  }
+  auto jsReverseIndex = engine.getObjectProperty(objOptions, "reverseIndex");
+  if (!engine.isUndefined(jsReverseIndex)) {
+    result.reverseIndex = engine.toBool(jsReverseIndex);
+  }
+  auto jsPerfectHashIndex = engine.getObjectProperty(objOptions, "perfectHashIndex");
+  if (!engine.isUndefined(jsPerfectHashIndex)) {
+    result.perfectHashIndex = engine.toBool(jsPerfectHashIndex);
+  }
+  auto jsDeduplicateValues = engine.getObjectProperty(objOptions, "deduplicateValues");
+  if (!engine.isUndefined(jsDeduplicateValues)) {
+    result.deduplicateValues = engine.toBool(jsDeduplicateValues);
+  }
+  auto jsCompressValues = engine.getObjectProperty(objOptions, "compressValues");
+  if (!engine.isUndefined(jsCompressValues)) {
+    result.compressValues = engine.toBool(jsCompressValues);
+  }
+  return result;
+}
+
+template <typename T>
+static PrefixSearchOptions parsePrefixSearchOptions(const JsEngine<T>& engine, T jsOptions) {
+  PrefixSearchOptions result;
+  if (engine.isUndefined(jsOptions)) {
+    return result;
+  }
+
+  auto objOptions = engine.toObject(jsOptions);
+  auto jsLimit = engine.getObjectProperty(objOptions, "limit");
+  if (!engine.isUndefined(jsLimit)) {
+    result.limit = engine.toInt(jsLimit);
+  }
+  auto jsOffset = engine.getObjectProperty(objOptions, "offset");
+  if (!engine.isUndefined(jsOffset)) {
+    result.offset = engine.toInt(jsOffset);
+  }
+  return result;
+}
+
+template <typename T>
+static FindManyOptions parseFindManyOptions(const JsEngine<T>& engine, T jsOptions) {
+  FindManyOptions result;
+  if (engine.isUndefined(jsOptions)) {
+    return result;
+  }
+
+  auto objOptions = engine.toObject(jsOptions);
+  auto jsThreads = engine.getObjectProperty(objOptions, "threads");
+  if (!engine.isUndefined(jsThreads)) {
+    result.threads = engine.toInt(jsThreads);
+  }
+  return result;
+}
+
+template <typename T>
+static LevelDbOptions parseLevelDbOptions(const JsEngine<T>& engine, T jsOptions) {
+  LevelDbOptions result;
+  if (engine.isUndefined(jsOptions)) {
+    return result;
+  }
+
+  auto objOptions = engine.toObject(jsOptions);
+  auto jsBlockCacheSize = engine.getObjectProperty(objOptions, "blockCacheSize");
+  if (!engine.isUndefined(jsBlockCacheSize)) {
+    result.blockCacheSize = engine.toInt(jsBlockCacheSize);
+  }
+  auto jsBloomFilterBitsPerKey = engine.getObjectProperty(objOptions, "bloomFilterBitsPerKey");
+  if (!engine.isUndefined(jsBloomFilterBitsPerKey)) {
+    result.bloomFilterBitsPerKey = engine.toInt(jsBloomFilterBitsPerKey);
+  }
+  auto jsCompression = engine.getObjectProperty(objOptions, "compression");
+  if (!engine.isUndefined(jsCompression)) {
+    result.compression = engine.toBool(jsCompression);
+  }
+  auto jsFillCache = engine.getObjectProperty(objOptions, "fillCache");
+  if (!engine.isUndefined(jsFillCache)) {
+    result.fillCache = engine.toBool(jsFillCache);
+  }
+  return result;
+}
+
+template <typename T>
+static std::vector<std::string> parseStringArray(const JsEngine<T>& engine, T jsArray) {
+  std::vector<std::string> result;
+  if (!engine.isArray(jsArray)) {
+    return result;
+  }
+
+  const size_t length = engine.getArrayLength(jsArray);
+  result.reserve(length);
+  for (size_t i = 0; i < length; ++i) {
+    T item = engine.getArrayItem(jsArray, i);
+    result.push_back(engine.toStdString(item));
+    engine.freeValue(item);
+  }
   return result;
 }
 
+template <>
+class JsWrapper<LevelDbPrefixIterator> {
+  DEFINE_CFUNCTION(next, {
+    auto obj = engine.unwrap<LevelDbPrefixIterator>(thisVal);
+    auto match = obj->next();
+    if (!match.has_value()) {
+      return engine.null();
+    }
+    auto jsObject = engine.newObject();
+    engine.setObjectProperty(jsObject, "text", engine.wrap(match->first));
+    engine.setObjectProperty(jsObject, "info", engine.wrap(match->second));
+    return jsObject;
+  })
+
+public:
+  EXPORT_CLASS_WITH_SHARED_POINTER(LevelDbPrefixIterator,
+                                   WITHOUT_CONSTRUCTOR,
+                                   WITHOUT_PROPERTIES,
+                                   WITHOUT_GETTERS,
+                                   WITH_FUNCTIONS(next, 0));
+};
+
 template <>
 class JsWrapper<LevelDb> {
   DEFINE_CFUNCTION_ARGC(loadTextFile, 1, {
@@ -69,16 +210,29 @@ class JsWrapper<LevelDb> {
 
   DEFINE_CFUNCTION_ARGC(loadBinaryFile, 1, {
     std::string absolutePath = engine.toStdString(argv[0]);
+    LevelDbOptions options;
+    if (argc > 1) {
+      options = parseLevelDbOptions(engine, argv[1]);
+    }
     auto obj = engine.unwrap<LevelDb>(thisVal);
-    obj->loadBinaryFile(absolutePath);
+    try {
+      obj->loadBinaryFile(absolutePath, options);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "loadBinaryFile of " << absolutePath << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
     return engine.undefined();
   })
 
   DEFINE_CFUNCTION_ARGC(saveToBinaryFile, 1, {
     std::string absolutePath = engine.toStdString(argv[0]);
+    LevelDbOptions options;
+    if (argc > 1) {
+      options = parseLevelDbOptions(engine, argv[1]);
+    }
     auto obj = engine.unwrap<LevelDb>(thisVal);
     try {
-      obj->saveToBinaryFile(absolutePath);
+      obj->saveToBinaryFile(absolutePath, options);
     } catch (const std::exception& e) {
       LOG(ERROR) << "saveToBinaryFile of " << absolutePath << " failed: " << e.what();
       return engine.throwError(JsErrorType::GENERIC, e.what());
@@ -93,21 +247,73 @@ class JsWrapper<LevelDb> {
     return result ? engine.wrap(*result) : engine.null();
   })
 
+  DEFINE_CFUNCTION_ARGC(findAll, 1, {
+    std::string key = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<LevelDb>(thisVal);
+    auto items = obj->findAll(key);
+
+    auto jsArray = engine.newArray();
+    for (size_t i = 0; i < items.size(); ++i) {
+      engine.insertItemToArray(jsArray, i, engine.wrap(items[i]));
+    }
+    return jsArray;
+  })
+
+  DEFINE_CFUNCTION_ARGC(findMany, 1, {
+    auto keys = parseStringArray(engine, argv[0]);
+    FindManyOptions options;
+    if (argc > 1) {
+      options = parseFindManyOptions(engine, argv[1]);
+    }
+    auto obj = engine.unwrap<LevelDb>(thisVal);
+    try {
+      auto values = obj->findMany(keys, options);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < values.size(); ++i) {
+        engine.insertItemToArray(jsArray, i,
+                                 values[i].has_value() ? engine.wrap(*values[i]) : engine.null());
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
   DEFINE_CFUNCTION_ARGC(prefixSearch, 1, {
     std::string prefix = engine.toStdString(argv[0]);
+    PrefixSearchOptions options;
+    if (argc > 1) {
+      options = parsePrefixSearchOptions(engine, argv[1]);
+    }
     auto obj = engine.unwrap<LevelDb>(thisVal);
-    auto results = obj->prefixSearch(prefix);
 
+    // the JS strings are created from the blocks of the db, without copying the matches
     auto jsArray = engine.newArray();
-    for (size_t i = 0; i < results.size(); ++i) {
-      auto jsObject = engine.newObject();
-      engine.setObjectProperty(jsObject, "text", engine.wrap(results[i].first));
-      engine.setObjectProperty(jsObject, "info", engine.wrap(results[i].second));
-      engine.insertItemToArray(jsArray, i, jsObject);
+    size_t index = 0;
+    try {
+      obj->forEachPrefixMatch(prefix, options, [&](std::string_view key, std::string_view item) {
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(key));
+        engine.setObjectProperty(jsObject, "info", engine.wrap(item));
+        engine.insertItemToArray(jsArray, index++, jsObject);
+      });
+    } catch (const std::exception& e) {
+      engine.freeValue(jsArray);
+      return engine.throwError(JsErrorType::GENERIC, e.what());
     }
     return jsArray;
   })
 
+  DEFINE_CFUNCTION_ARGC(prefixIterator, 1, {
+    std::string prefix = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<LevelDb>(thisVal);
+    try {
+      return engine.wrap(obj->prefixIterator(prefix));
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
   DEFINE_CFUNCTION(close, {
     auto obj = engine.unwrap<LevelDb>(thisVal);
     obj->close();
@@ -129,8 +335,14 @@ public:
                                                   1,
                                                   find,
                                                   1,
+                                                  findAll,
+                                                  1,
+                                                  findMany,
+                                                  1,
                                                   prefixSearch,
                                                   1,
+                                                  prefixIterator,
+                                                  1,
                                                   close,
                                                   0));
 };
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <glog/logging.h>
+#include "dicts/sharded_trie.h"
+#include "engines/js_macros.h"
+#include "js_wrapper.h"
+#include "types/qjs_leveldb.h"
+#include "types/qjs_trie.h"
+
+using namespace rime;
+
+template <typename T>
+static ShardedTrieOptions parseShardedTrieOptions(const JsEngine<T>& engine, T jsOptions) {
+  ShardedTrieOptions result;
+  if (engine.isUndefined(jsOptions)) {
+    return result;
+  }
+
+  auto objOptions = engine.toObject(jsOptions);
+  auto jsShards = engine.getObjectProperty(objOptions, "shards");
+  if (!engine.isUndefined(jsShards)) {
+    result.shards = engine.toInt(jsShards);
+  }
+  auto jsThreads = engine.getObjectProperty(objOptions, "threads");
+  if (!engine.isUndefined(jsThreads)) {
+    result.threads = engine.toInt(jsThreads);
+  }
+  return result;
+}
+
+template <>
+class JsWrapper<rime::ShardedTrie> {
+  DEFINE_CFUNCTION_ARGC(loadTextFile, 1, {
+    std::string absolutePath = engine.toStdString(argv[0]);
+    ParseTextFileOptions options;
+    if (argc > 1) {
+      options = parseTextFileOptions(engine, argv[1]);
+    }
+
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      obj->loadTextFile(absolutePath, options);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "loadTextFile of " << absolutePath << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+    return engine.undefined();
+  })
+
+  DEFINE_CFUNCTION_ARGC(loadBinaryFile, 1, {
+    std::string absolutePath = engine.toStdString(argv[0]);
+    TrieLoadOptions options;
+    if (argc > 1) {
+      options = parseTrieLoadOptions(engine, argv[1]);
+    }
+
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      obj->loadBinaryFile(absolutePath, options);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "loadBinaryFile of " << absolutePath << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+    return engine.undefined();
+  })
+
+  DEFINE_CFUNCTION_ARGC(saveToBinaryFile, 1, {
+    std::string absolutePath = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      obj->saveToBinaryFile(absolutePath);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "saveToBinaryFile of " << absolutePath << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+    return engine.undefined();
+  })
+
+  DEFINE_CFUNCTION_ARGC(find, 1, {
+    std::string key = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      auto result = obj->find(key);
+      return result.has_value() ? engine.wrap(result.value()) : engine.null();
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(findAll, 1, {
+    std::string key = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      auto items = obj->findAll(key);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < items.size(); ++i) {
+        engine.insertItemToArray(jsArray, i, engine.wrap(items[i]));
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(findMany, 1, {
+    auto keys = parseStringArray(engine, argv[0]);
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      auto values = obj->findMany(keys);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < values.size(); ++i) {
+        engine.insertItemToArray(jsArray, i,
+                                 values[i].has_value() ? engine.wrap(*values[i]) : engine.null());
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(prefixSearch, 1, {
+    std::string prefix = engine.toStdString(argv[0]);
+    PrefixSearchOptions options;
+    if (argc > 1) {
+      options = parsePrefixSearchOptions(engine, argv[1]);
+    }
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      auto matches = obj->prefixSearch(prefix, options);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < matches.size(); ++i) {
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(matches[i].first));
+        engine.setObjectProperty(jsObject, "info", engine.wrap(matches[i].second));
+        engine.insertItemToArray(jsArray, i, jsObject);
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(topK, 2, {
+    std::string prefix = engine.toStdString(argv[0]);
+    const size_t k = toSize(engine, argv[1], "k");
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      auto matches = obj->topK(prefix, k);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < matches.size(); ++i) {
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(matches[i].key));
+        engine.setObjectProperty(jsObject, "info", engine.wrap(matches[i].value));
+        engine.setObjectProperty(jsObject, "weight", engine.wrap(matches[i].weight));
+        engine.insertItemToArray(jsArray, i, jsObject);
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(contains, 1, {
+    std::string key = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<ShardedTrie>(thisVal);
+    try {
+      return engine.wrap(obj->contains(key));
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION(makeShardedTrie, {
+    ShardedTrieOptions options;
+    if (argc > 0) {
+      options = parseShardedTrieOptions(engine, argv[0]);
+    }
+    return engine.wrap(std::make_shared<ShardedTrie>(options));
+  })
+
+public:
+  EXPORT_CLASS_WITH_SHARED_POINTER(ShardedTrie,
+                                   WITH_CONSTRUCTOR(makeShardedTrie, 0),
+                                   WITHOUT_PROPERTIES,
+                                   WITHOUT_GETTERS,
+                                   WITH_FUNCTIONS(loadTextFile,
+                                                  1,
+                                                  loadBinaryFile,
+                                                  1,
+                                                  saveToBinaryFile,
+                                                  1,
+                                                  find,
+                                                  1,
+                                                  findAll,
+                                                  1,
+                                                  findMany,
+                                                  1,
+                                                  prefixSearch,
+                                                  1,
+                                                  topK,
+                                                  2,
+                                                  contains,
+                                                  1));
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <glog/logging.h>
+#include "dicts/sorted_text_dictionary.h"
+#include "engines/js_macros.h"
+#include "js_wrapper.h"
+#include "types/qjs_leveldb.h"
+
+using namespace rime;
+
+template <>
+class JsWrapper<rime::SortedTextDictionary> {
+  DEFINE_CFUNCTION_ARGC(loadTextFile, 1, {
+    std::string absolutePath = engine.toStdString(argv[0]);
+    ParseTextFileOptions options;
+    if (argc > 1) {
+      options = parseTextFileOptions(engine, argv[1]);
+    }
+
+    auto obj = engine.unwrap<SortedTextDictionary>(thisVal);
+    try {
+      obj->loadTextFile(absolutePath, options);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "loadTextFile of " << absolutePath << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+    return engine.undefined();
+  })
+
+  DEFINE_CFUNCTION_ARGC(find, 1, {
+    std::string key = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<SortedTextDictionary>(thisVal);
+    try {
+      auto result = obj->find(key);
+      return result.has_value() ? engine.wrap(result.value()) : engine.null();
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(findAll, 1, {
+    std::string key = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<SortedTextDictionary>(thisVal);
+    try {
+      auto items = obj->findAll(key);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < items.size(); ++i) {
+        engine.insertItemToArray(jsArray, i, engine.wrap(items[i]));
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(findMany, 1, {
+    auto keys = parseStringArray(engine, argv[0]);
+    auto obj = engine.unwrap<SortedTextDictionary>(thisVal);
+    try {
+      auto values = obj->findMany(keys);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < values.size(); ++i) {
+        engine.insertItemToArray(jsArray, i,
+                                 values[i].has_value() ? engine.wrap(*values[i]) : engine.null());
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(prefixSearch, 1, {
+    std::string prefix = engine.toStdString(argv[0]);
+    PrefixSearchOptions options;
+    if (argc > 1) {
+      options = parsePrefixSearchOptions(engine, argv[1]);
+    }
+    auto obj = engine.unwrap<SortedTextDictionary>(thisVal);
+    try {
+      auto matches = obj->prefixSearch(prefix, options);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < matches.size(); ++i) {
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(matches[i].first));
+        engine.setObjectProperty(jsObject, "info", engine.wrap(matches[i].second));
+        engine.insertItemToArray(jsArray, i, jsObject);
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(contains, 1, {
+    std::string key = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<SortedTextDictionary>(thisVal);
+    try {
+      return engine.wrap(obj->contains(key));
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION(makeSortedTextDictionary, {
+    return engine.wrap(std::make_shared<SortedTextDictionary>());
+  })
+
+public:
+  EXPORT_CLASS_WITH_SHARED_POINTER(SortedTextDictionary,
+                                   WITH_CONSTRUCTOR(makeSortedTextDictionary, 0),
+                                   WITHOUT_PROPERTIES,
+                                   WITHOUT_GETTERS,
+                                   WITH_FUNCTIONS(loadTextFile,
+                                                  1,
+                                                  find,
+                                                  1,
+                                                  findAll,
+                                                  1,
+                                                  findMany,
+                                                  1,
+                                                  prefixSearch,
+                                                  1,
+                                                  contains,
+                                                  1));
+};
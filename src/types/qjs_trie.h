@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glog/logging.h>
+#include "dicts/fuzzy_matcher.h"
 #include "dicts/trie.h"
 #include "engines/js_macros.h"
 #include "js_wrapper.h"
@@ -8,6 +9,81 @@
 
 using namespace rime;
 
+template <typename T>
+static TrieLoadOptions parseTrieLoadOptions(const JsEngine<T>& engine, T jsOptions) {
+  TrieLoadOptions result;
+  if (engine.isUndefined(jsOptions)) {
+    return result;
+  }
+
+  auto objOptions = engine.toObject(jsOptions);
+
+  auto jsMode = engine.getObjectProperty(objOptions, "mode");
+  if (!engine.isUndefined(jsMode)) {
+    auto mode = engine.toStdString(jsMode);
+    result.mode = mode == "read" ? TrieLoadMode::Read : TrieLoadMode::Map;
+  }
+  auto jsAdvice = engine.getObjectProperty(objOptions, "advice");
+  if (!engine.isUndefined(jsAdvice)) {
+    auto advice = engine.toStdString(jsAdvice);
+    if (advice == "random") {
+      result.advice = MemoryAdvice::Random;
+    } else if (advice == "sequential") {
+      result.advice = MemoryAdvice::Sequential;
+    } else if (advice == "willneed") {
+      result.advice = MemoryAdvice::WillNeed;
+    } else {  // default to normal
+      result.advice = MemoryAdvice::Normal;
+    }
+  }
+  auto jsVerifyChecksums = engine.getObjectProperty(objOptions, "verifyChecksums");
+  if (!engine.isUndefined(jsVerifyChecksums)) {
+    result.verifyChecksums = engine.toBool(jsVerifyChecksums);
+  }
+  auto jsCachedValueBlocks = engine.getObjectProperty(objOptions, "cachedValueBlocks");
+  if (!engine.isUndefined(jsCachedValueBlocks)) {
+    result.cachedValueBlocks = toSize(engine, jsCachedValueBlocks, "cachedValueBlocks");
+  }
+  return result;
+}
+
+// the length of a UTF-8 text in the UTF-16 code units of a JS string
+static size_t utf16Length(std::string_view text) {
+  size_t length = 0;
+  for (size_t pos = 0; pos < text.length();) {
+    uint32_t codePoint = 0;
+    pos += decodeUtf8(text, pos, codePoint);
+    length += codePoint >= 0x10000 && codePoint <= 0x10FFFF ? 2 : 1;
+  }
+  return length;
+}
+
+template <>
+class JsWrapper<rime::TriePrefixIterator> {
+  DEFINE_CFUNCTION(next, {
+    auto obj = engine.unwrap<TriePrefixIterator>(thisVal);
+    try {
+      auto match = obj->next();
+      if (!match.has_value()) {
+        return engine.null();
+      }
+      auto jsObject = engine.newObject();
+      engine.setObjectProperty(jsObject, "text", engine.wrap(match->first));
+      engine.setObjectProperty(jsObject, "info", engine.wrap(match->second));
+      return jsObject;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+public:
+  EXPORT_CLASS_WITH_SHARED_POINTER(TriePrefixIterator,
+                                   WITHOUT_CONSTRUCTOR,
+                                   WITHOUT_PROPERTIES,
+                                   WITHOUT_GETTERS,
+                                   WITH_FUNCTIONS(next, 0));
+};
+
 template <>
 class JsWrapper<rime::Trie> {
   DEFINE_CFUNCTION_ARGC(loadTextFile, 1, {
@@ -30,9 +106,14 @@ class JsWrapper<rime::Trie> {
 
   DEFINE_CFUNCTION_ARGC(loadBinaryFile, 1, {
     std::string absolutePath = engine.toStdString(argv[0]);
+    TrieLoadOptions options;
+    if (argc > 1) {
+      options = parseTrieLoadOptions(engine, argv[1]);
+    }
+
     auto obj = engine.unwrap<Trie>(thisVal);
     try {
-      obj->loadBinaryFile(absolutePath);
+      obj->loadBinaryFile(absolutePath, options);
     } catch (const std::exception& e) {
       LOG(ERROR) << "loadBinaryFileMmap of " << absolutePath << " failed: " << e.what();
       return engine.throwError(JsErrorType::GENERIC, e.what());
@@ -40,6 +121,37 @@ class JsWrapper<rime::Trie> {
     return engine.undefined();
   })
 
+  // Loads the binary file into a new trie on a background thread, and swaps it in when the promise
+  // is settled on the JS thread. The trie is not loaded until then, e.g. `find` returns null.
+  DEFINE_CFUNCTION_ARGC(loadBinaryFileAsync, 1, {
+    std::string absolutePath = engine.toStdString(argv[0]);
+    TrieLoadOptions options;
+    if (argc > 1) {
+      options = parseTrieLoadOptions(engine, argv[1]);
+    }
+
+    auto obj = engine.unwrap<Trie>(thisVal);
+    auto loaded = std::make_shared<Trie>();
+    return engine.runAsync(
+        [loaded, absolutePath, options] {
+          try {
+            loaded->loadBinaryFile(absolutePath, options);
+          } catch (const std::exception& e) {
+            LOG(ERROR) << "loadBinaryFileAsync of " << absolutePath << " failed: " << e.what();
+            throw;
+          }
+        },
+        [&engine, obj, loaded] {
+          obj->swap(*loaded);
+          return engine.undefined();
+        });
+  })
+
+  DEFINE_CFUNCTION(isLoaded, {
+    auto obj = engine.unwrap<Trie>(thisVal);
+    return engine.wrap(obj->isLoaded());
+  })
+
   DEFINE_CFUNCTION_ARGC(saveToBinaryFile, 1, {
     std::string absolutePath = engine.toStdString(argv[0]);
     auto obj = engine.unwrap<Trie>(thisVal);
@@ -52,27 +164,222 @@ class JsWrapper<rime::Trie> {
     return engine.undefined();
   })
 
+  DEFINE_CFUNCTION_ARGC(buildBinaryFile, 2, {
+    std::string txtPath = engine.toStdString(argv[0]);
+    std::string binaryPath = engine.toStdString(argv[1]);
+    ParseTextFileOptions options;
+    if (argc > 2) {
+      options = parseTextFileOptions(engine, argv[2]);
+    }
+
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      obj->buildBinaryFile(txtPath, options, binaryPath);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "buildBinaryFile of " << txtPath << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+    return engine.undefined();
+  })
+
   DEFINE_CFUNCTION_ARGC(find, 1, {
     std::string key = engine.toStdString(argv[0]);
     auto obj = engine.unwrap<Trie>(thisVal);
-    auto result = obj->find(key);
-    return result.has_value() ? engine.wrap(result.value()) : engine.null();
+    try {
+      auto result = obj->findView(key);
+      return result.has_value() ? engine.wrap(result.value()) : engine.null();
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(findAll, 1, {
+    std::string key = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      auto items = obj->findAllView(key);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < items.size(); ++i) {
+        engine.insertItemToArray(jsArray, i, engine.wrap(items[i]));
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(findMany, 1, {
+    auto keys = parseStringArray(engine, argv[0]);
+    FindManyOptions options;
+    if (argc > 1) {
+      options = parseFindManyOptions(engine, argv[1]);
+    }
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      auto values = obj->findManyView(keys, options);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < values.size(); ++i) {
+        engine.insertItemToArray(jsArray, i,
+                                 values[i].has_value() ? engine.wrap(*values[i]) : engine.null());
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
   })
 
   DEFINE_CFUNCTION_ARGC(prefixSearch, 1, {
     std::string prefix = engine.toStdString(argv[0]);
+    PrefixSearchOptions options;
+    if (argc > 1) {
+      options = parsePrefixSearchOptions(engine, argv[1]);
+    }
     auto obj = engine.unwrap<Trie>(thisVal);
-    auto matches = obj->prefixSearch(prefix);
+    try {
+      auto matches = obj->prefixSearchView(prefix, options);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < matches.size(); ++i) {
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(matches[i].first));
+        engine.setObjectProperty(jsObject, "info", engine.wrap(matches[i].second));
+        engine.insertItemToArray(jsArray, i, jsObject);
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
 
-    auto jsArray = engine.newArray();
-    for (size_t i = 0; i < matches.size(); ++i) {
-      auto jsObject = engine.newObject();
-      engine.setObjectProperty(jsObject, "text", engine.wrap(matches[i].first));
-      engine.setObjectProperty(jsObject, "info", engine.wrap(matches[i].second));
-      engine.insertItemToArray(jsArray, i, jsObject);
+  DEFINE_CFUNCTION_ARGC(topK, 2, {
+    std::string prefix = engine.toStdString(argv[0]);
+    const size_t k = toSize(engine, argv[1], "k");
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      auto matches = obj->topK(prefix, k);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < matches.size(); ++i) {
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(matches[i].key));
+        engine.setObjectProperty(jsObject, "info", engine.wrap(matches[i].value));
+        engine.setObjectProperty(jsObject, "weight", engine.wrap(matches[i].weight));
+        engine.insertItemToArray(jsArray, i, jsObject);
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(fuzzySearch, 2, {
+    std::string query = engine.toStdString(argv[0]);
+    const size_t maxDistance = toSize(engine, argv[1], "maxDistance");
+    size_t limit = 0;
+    if (argc > 2 && !engine.isUndefined(argv[2])) {
+      limit = toSize(engine, argv[2], "limit");
+    }
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      auto matches = obj->fuzzySearch(query, maxDistance, limit);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < matches.size(); ++i) {
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(matches[i].key));
+        engine.setObjectProperty(jsObject, "info", engine.wrap(matches[i].value));
+        engine.setObjectProperty(jsObject, "distance", engine.wrap(matches[i].distance));
+        engine.insertItemToArray(jsArray, i, jsObject);
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(reverseFind, 1, {
+    std::string value = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      auto keys = obj->reverseFind(value);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < keys.size(); ++i) {
+        engine.insertItemToArray(jsArray, i, engine.wrap(keys[i]));
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "reverseFind of " << value << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
     }
-    return jsArray;
   })
+
+  DEFINE_CFUNCTION_ARGC(commonPrefixSearch, 1, {
+    std::string text = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      auto matches = obj->commonPrefixSearch(text);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < matches.size(); ++i) {
+        const auto key = std::string_view(text).substr(0, matches[i].length);
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(std::string(key)));
+        engine.setObjectProperty(jsObject, "info", engine.wrap(matches[i].value));
+        engine.setObjectProperty(jsObject, "length", engine.wrap(utf16Length(key)));
+        engine.insertItemToArray(jsArray, i, jsObject);
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(longestMatchSegmentation, 1, {
+    std::string text = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      auto segments = obj->longestMatchSegmentation(text);
+      auto jsArray = engine.newArray();
+      for (size_t i = 0; i < segments.size(); ++i) {
+        auto jsObject = engine.newObject();
+        engine.setObjectProperty(jsObject, "text", engine.wrap(std::string(segments[i].text)));
+        engine.setObjectProperty(jsObject, "info", segments[i].value.has_value()
+                                                       ? engine.wrap(segments[i].value.value())
+                                                       : engine.null());
+        engine.insertItemToArray(jsArray, i, jsObject);
+      }
+      return jsArray;
+    } catch (const std::exception& e) {
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+  })
+
+  DEFINE_CFUNCTION_ARGC(add, 2, {
+    std::string key = engine.toStdString(argv[0]);
+    std::string value = engine.toStdString(argv[1]);
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      obj->add(key, value);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "add of " << key << " failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+    return engine.undefined();
+  })
+
+  DEFINE_CFUNCTION(compact, {
+    auto obj = engine.unwrap<Trie>(thisVal);
+    try {
+      obj->compact();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "compact failed: " << e.what();
+      return engine.throwError(JsErrorType::GENERIC, e.what());
+    }
+    return engine.undefined();
+  })
+
+  DEFINE_CFUNCTION_ARGC(prefixIterator, 1, {
+    std::string prefix = engine.toStdString(argv[0]);
+    auto obj = engine.unwrap<Trie>(thisVal);
+    return engine.wrap(std::make_shared<TriePrefixIterator>(obj, prefix));
+  })
+
   DEFINE_CFUNCTION(makeTrie, { return engine.wrap(std::make_shared<Trie>()); })
 
 public:
@@ -84,10 +391,36 @@ public:
                                                   1,
                                                   loadBinaryFile,
                                                   1,
+                                                  loadBinaryFileAsync,
+                                                  1,
+                                                  isLoaded,
+                                                  0,
                                                   saveToBinaryFile,
                                                   1,
+                                                  buildBinaryFile,
+                                                  2,
                                                   find,
                                                   1,
+                                                  findAll,
+                                                  1,
+                                                  findMany,
+                                                  1,
                                                   prefixSearch,
-                                                  1));
+                                                  1,
+                                                  prefixIterator,
+                                                  1,
+                                                  topK,
+                                                  2,
+                                                  fuzzySearch,
+                                                  2,
+                                                  reverseFind,
+                                                  1,
+                                                  commonPrefixSearch,
+                                                  1,
+                                                  longestMatchSegmentation,
+                                                  1,
+                                                  add,
+                                                  2,
+                                                  compact,
+                                                  0));
 };
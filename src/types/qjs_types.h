@@ -11,8 +11,10 @@
 #include "qjs_config_map.h"
 #include "qjs_config_value.h"
 #include "qjs_context.h"
+#include "qjs_double_array_trie.h"
 #include "qjs_engine.h"
 #include "qjs_environment.h"
+#include "qjs_fst.h"
 #include "qjs_key_event.h"
 #include "qjs_leveldb.h"
 #include "qjs_notifier.h"
@@ -21,6 +23,8 @@
 #include "qjs_preedit.h"
 #include "qjs_schema.h"
 #include "qjs_segment.h"
+#include "qjs_sharded_trie.h"
+#include "qjs_sorted_text_dictionary.h"
 #include "qjs_trie.h"
 
 template <typename T_JS_VALUE>
@@ -32,7 +36,13 @@ void registerTypesToJsEngine() {
   engine.template registerType<rime::Candidate>();
   engine.template registerType<rime::Translation>();
   engine.template registerType<rime::Trie>();
+  engine.template registerType<rime::TriePrefixIterator>();
+  engine.template registerType<rime::DoubleArrayTrie>();
+  engine.template registerType<rime::Fst>();
+  engine.template registerType<rime::ShardedTrie>();
+  engine.template registerType<rime::SortedTextDictionary>();
   engine.template registerType<LevelDb>();
+  engine.template registerType<LevelDbPrefixIterator>();
   engine.template registerType<rime::Segment>();
   engine.template registerType<rime::KeyEvent>();
   engine.template registerType<rime::Context>();
@@ -1,9 +1,30 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <thread>
 
 #include "dict_data_helper.hpp"
+#include "dicts/binary_format.h"
+#include "dicts/block_codec.h"
+#include "dicts/dictionary_registry.h"
+#include "dicts/double_array_trie.h"
+#include "dicts/external_sorter.h"
+#include "dicts/fst.h"
+#include "dicts/fuzzy_matcher.h"
 #include "dicts/leveldb.h"
+#include "dicts/sharded_trie.h"
+#include "dicts/sorted_text_dictionary.h"
+#include "dicts/text_scanner.h"
 #include "dicts/trie.h"
+#include "dicts/value_pool.h"
+#include "thread_pool.hpp"
 
 #include "test_helper.hpp"
 
@@ -48,4 +69,1374 @@ TEST_F(DictionaryTest, LoadTextFileAndLookupWithLevelDb) {
   LevelDb dict2;
   dict2.loadBinaryFile(helper.levelDbFolderPath_);
   DictionaryDataHelper::testSearchItems(dict2);
+
+  // a db opened by another object is locked, and the status of leveldb is reported
+  LevelDb dict3;
+  try {
+    dict3.loadBinaryFile(helper.levelDbFolderPath_);
+    ADD_FAILURE() << "a locked db is opened";
+  } catch (const std::runtime_error& error) {
+    EXPECT_NE(std::string(error.what()).find(helper.levelDbFolderPath_), std::string::npos);
+    EXPECT_NE(std::string(error.what()).find("lock"), std::string::npos) << error.what();
+  }
+  EXPECT_THROW(dict3.loadBinaryFile(helper.levelDbFolderPath_ + ".missing"), std::runtime_error);
+}
+
+TEST_F(DictionaryTest, FindViewsIntoTheMappedTrieFile) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+  trie.saveToBinaryFile(helper.mergedBinaryPath_);
+
+  rime::Trie trie2;
+  trie2.loadBinaryFile(helper.mergedBinaryPath_);
+  auto value = trie2.findView("accordion");
+  ASSERT_TRUE(value.has_value());
+  EXPECT_EQ(value.value(), "[ә'kɒ:djәn]; n. 手风琴\\n a. 可折叠的");
+  EXPECT_FALSE(trie2.findView("nonexistent-word").has_value());
+  EXPECT_EQ(trie2.prefixSearchView("accordion").size(), 2);
+
+  // rewriting the binary file should not invalidate the views of the loaded one
+  trie2.saveToBinaryFile(helper.mergedBinaryPath_);
+  EXPECT_EQ(value.value(), "[ә'kɒ:djәn]; n. 手风琴\\n a. 可折叠的");
+
+  rime::Trie trie3;
+  trie3.loadBinaryFile(helper.mergedBinaryPath_);
+  DictionaryDataHelper::testSearchItems(trie3);
+}
+
+TEST_F(DictionaryTest, LoadTrieBinaryFileIntoHeap) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+  trie.saveToBinaryFile(helper.mergedBinaryPath_);
+
+  rime::Trie trie2;
+  trie2.loadBinaryFile(helper.mergedBinaryPath_,
+                       {rime::TrieLoadMode::Read, rime::MemoryAdvice::Random});
+  DictionaryDataHelper::testSearchItems(trie2);
+}
+
+TEST_F(DictionaryTest, RejectCorruptedTrieBinaryFile) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+  trie.saveToBinaryFile(helper.mergedBinaryPath_);
+
+  rime::TrieLoadOptions loadOptions;
+  loadOptions.verifyChecksums = true;
+  rime::Trie trie2;
+  trie2.loadBinaryFile(helper.mergedBinaryPath_, loadOptions);
+  DictionaryDataHelper::testSearchItems(trie2);
+
+  {
+    // flip the last byte of the file, in the trie section
+    std::fstream file(helper.mergedBinaryPath_, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(-1, std::ios::end);
+    const char byte = static_cast<char>(file.get() ^ 0xFF);
+    file.seekp(-1, std::ios::end);
+    file.put(byte);
+  }
+  rime::Trie trie3;
+  EXPECT_THROW(trie3.loadBinaryFile(helper.mergedBinaryPath_, loadOptions), std::runtime_error);
+
+  // the sections out of bounds are rejected without verifying the checksums
+  const auto overwrite = [&](size_t offset, uint32_t value) {
+    std::fstream file(helper.mergedBinaryPath_, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  const auto sectionOffset = [&](rime::binary_format::SectionType type) {
+    std::ifstream file(helper.mergedBinaryPath_, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    rime::BinaryFileReader reader(data.data(), data.size());
+    return static_cast<size_t>(reader.section(type).data() - data.data());
+  };
+  trie.saveToBinaryFile(helper.mergedBinaryPath_);
+  overwrite(sectionOffset(rime::binary_format::SectionType::KeyOrder), 0xFFFFFFFF);
+  EXPECT_THROW(trie3.loadBinaryFile(helper.mergedBinaryPath_), std::runtime_error);
+
+  // a newer version is reported as unsupported rather than corrupted
+  trie.saveToBinaryFile(helper.mergedBinaryPath_);
+  overwrite(offsetof(rime::BinaryFileHeader, version), rime::binary_format::VERSION + 1);
+  try {
+    trie3.loadBinaryFile(helper.mergedBinaryPath_);
+    ADD_FAILURE() << "a newer version is loaded";
+  } catch (const std::runtime_error& error) {
+    EXPECT_EQ(std::string(error.what()).find("Unsupported"), 0U) << error.what();
+  }
+}
+
+TEST_F(DictionaryTest, ParseTextFileInChunks) {
+  auto helper = getDictHelper();
+  {
+    // large enough to be split into chunks, with the duplicated keys spread across the chunks
+    std::ofstream file(helper.txtPath_);
+    for (int i = 0; i < 100000; ++i) {
+      file << "# comment\n";
+      file << "key" << i % 1000 << '\t' << "value" << i << "\r\n";
+    }
+  }
+
+  for (auto policy : {OnDuplicatedKey::Overwrite, OnDuplicatedKey::Skip, OnDuplicatedKey::Concat}) {
+    ParseTextFileOptions options;
+    options.onDuplicatedKey = policy;
+    auto expected = Dictionary::parseTextFile(helper.txtPath_, options);
+    options.threads = 4;
+    auto actual = Dictionary::parseTextFile(helper.txtPath_, options);
+    EXPECT_EQ(actual.size(), 1000);
+    EXPECT_EQ(actual, expected);
+  }
+}
+
+TEST_F(DictionaryTest, ScanTextLines) {
+  // long enough to cross the SIMD vectors
+  const std::string longKey(40, 'k');
+  const std::string text = "# comment\n" + longKey + "\tvalue\r\n" + "no delimiter\n\n" + "a\t\tb";
+  const ByteSetScanner charsToRemove("\r");
+  TextLineScanner scanner(text, "\t", charsToRemove);
+
+  std::vector<TextLine> lines;
+  TextLine line;
+  while (scanner.next(line)) {
+    lines.push_back(line);
+  }
+  ASSERT_EQ(lines.size(), 5);
+  EXPECT_EQ(lines[0].text, "# comment");
+  EXPECT_EQ(lines[1].text, longKey + "\tvalue\r");
+  EXPECT_EQ(lines[1].delimiterPos, longKey.size());
+  EXPECT_TRUE(lines[1].hasCharsToRemove);
+  EXPECT_EQ(lines[2].delimiterPos, std::string_view::npos);
+  EXPECT_FALSE(lines[2].hasCharsToRemove);
+  EXPECT_TRUE(lines[3].text.empty());
+  EXPECT_EQ(lines[4].text, "a\t\tb");
+  EXPECT_EQ(lines[4].delimiterPos, 1);
+
+  ParseTextFileOptions options;
+  auto helper = getDictHelper();
+  std::ofstream(helper.txtPath_) << text;
+  auto map = Dictionary::parseTextFile(helper.txtPath_, options);
+  ASSERT_EQ(map.size(), 2);
+  EXPECT_EQ(map[longKey], "value");
+  EXPECT_EQ(map["a"], "\tb");
+}
+
+TEST_F(DictionaryTest, BuildDictionaryFilesInBoundedMemory) {
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    for (int i = 0; i < 5000; ++i) {
+      file << "key" << (i * 7919) % 1000 << '\t' << "value" << i << '\n';
+    }
+  }
+
+  ParseTextFileOptions options;
+  options.onDuplicatedKey = OnDuplicatedKey::Concat;
+  options.concatSeparator = "|";
+  const auto expected = Dictionary::parseTextFile(helper.txtPath_, options);
+
+  options.memoryBudget = 16 * 1024;  // to spill several sorted runs
+  std::string previousKey;
+  size_t count = 0;
+  Dictionary::parseSortedTextFile(
+      helper.txtPath_, options, helper.binaryPath_,
+      [&](const std::string& key, const std::string& value) {
+        EXPECT_TRUE(count == 0 || previousKey < key);
+        EXPECT_EQ(value, expected.at(key));
+        previousKey = key;
+        ++count;
+      });
+  EXPECT_EQ(count, expected.size());
+
+  // a run holds the entries of about the budget, and the runs are merged in several passes
+  const int entryCount = 20000;
+  ExternalSorter sorter(options, helper.binaryPath_);
+  for (int i = 0; i < entryCount; ++i) {
+    sorter.add("key" + std::to_string((i * 7919) % entryCount), "value" + std::to_string(i));
+  }
+  EXPECT_GT(sorter.spilledRuns(), 64U);
+  EXPECT_LT(sorter.spilledRuns(), 400U);
+  count = 0;
+  sorter.finish([&](const std::string& key, const std::string& value) {
+    EXPECT_TRUE(count == 0 || previousKey < key);
+    EXPECT_EQ(value.rfind("value", 0), 0U);
+    previousKey = key;
+    ++count;
+  });
+  EXPECT_EQ(count, entryCount);
+
+  rime::Trie trie;
+  trie.buildBinaryFile(helper.txtPath_, options, helper.binaryPath_);
+  rime::Trie trie2;
+  trie2.loadBinaryFile(helper.binaryPath_);
+  for (const auto& [key, value] : expected) {
+    EXPECT_EQ(trie.find(key), value);
+    EXPECT_EQ(trie2.find(key), value);
+  }
+
+  LevelDb db;
+  db.loadTextFile(helper.txtPath_, options);
+  db.saveToBinaryFile(helper.levelDbFolderPath_);
+  for (const auto& [key, value] : expected) {
+    EXPECT_EQ(db.find(key), value);
+  }
+  db.close();
+}
+
+TEST_F(DictionaryTest, BulkLoadLevelDbInBoundedMemory) {
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    for (int i = 0; i < 5000; ++i) {
+      file << "key" << (i * 7919) % 5000 << '\t' << "value" << i << '\n';
+    }
+  }
+  const auto sortedRunsLeft = [&]() {
+    const std::filesystem::path dbPath(helper.levelDbFolderPath_);
+    const auto prefix = dbPath.filename().string() + ".sort";
+    return std::count_if(std::filesystem::directory_iterator(dbPath.parent_path()),
+                         std::filesystem::directory_iterator(), [&](const auto& entry) {
+                           return entry.path().filename().string().rfind(prefix, 0) == 0;
+                         });
+  };
+
+  ParseTextFileOptions options;
+  options.memoryBudget = 16 * 1024;
+  LevelDb db;
+  db.loadTextFile(helper.txtPath_, options);
+  db.saveToBinaryFile(helper.levelDbFolderPath_);
+  EXPECT_GT(db.spilledRuns(), 0U);
+  EXPECT_EQ(sortedRunsLeft(), 0);
+  for (int i = 0; i < 5000; i += 97) {
+    EXPECT_EQ(db.find("key" + std::to_string((i * 7919) % 5000)), "value" + std::to_string(i));
+  }
+  db.close();
+
+  // the default budget holds the small file without spilling
+  std::filesystem::remove_all(helper.levelDbFolderPath_);
+  LevelDb db2;
+  db2.loadTextFile(helper.txtPath_, ParseTextFileOptions());
+  db2.saveToBinaryFile(helper.levelDbFolderPath_);
+  EXPECT_EQ(db2.spilledRuns(), 0U);
+  EXPECT_EQ(db2.find("key0"), "value0");
+  db2.close();
+}
+
+TEST_F(DictionaryTest, FindAllValuesOfDuplicatedKey) {
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    file << "key\tfirst|value\n";
+    file << "other\tsingle\n";
+    file << "key\tsecond\n";
+  }
+  ParseTextFileOptions options;
+  options.onDuplicatedKey = OnDuplicatedKey::Concat;
+  options.concatSeparator = "$|$";
+  const std::vector<std::string> expected = {"first|value", "second"};
+
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+  EXPECT_EQ(trie.findAll("key"), expected);
+  EXPECT_EQ(trie.find("key"), "first|value$|$second");
+  trie.saveToBinaryFile(helper.binaryPath_);
+
+  rime::Trie trie2;
+  trie2.loadBinaryFile(helper.binaryPath_);
+  EXPECT_EQ(trie2.findAll("key"), expected);
+  EXPECT_EQ(trie2.findAll("other"), std::vector<std::string>{"single"});
+  EXPECT_TRUE(trie2.findAll("missing").empty());
+  auto results = trie2.prefixSearch("k");
+  ASSERT_EQ(results.size(), 2);
+  EXPECT_EQ(results[1].second, "second");
+
+  LevelDb db;
+  db.loadTextFile(helper.txtPath_, options);
+  db.saveToBinaryFile(helper.levelDbFolderPath_);
+  db.close();
+  LevelDb db2;
+  db2.loadBinaryFile(helper.levelDbFolderPath_);
+  EXPECT_EQ(db2.findAll("key"), expected);
+  db2.close();
+}
+
+TEST_F(DictionaryTest, PrefixSearchWithRangeAndIterator) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+
+  auto trie = std::make_shared<rime::Trie>();
+  trie->loadTextFile(helper.txtPath_, options);
+  const auto all = trie->prefixSearch("accord");
+  ASSERT_EQ(all.size(), 6);
+
+  auto page = trie->prefixSearch("accord", {2, 3});
+  ASSERT_EQ(page.size(), 2);
+  EXPECT_EQ(page[0], all[3]);
+  EXPECT_EQ(page[1], all[4]);
+  EXPECT_EQ(trie->prefixSearch("accord", {0, 5}).size(), 1);
+
+  rime::TriePrefixIterator iterator(trie, "accord");
+  for (const auto& [key, value] : all) {
+    auto match = iterator.next();
+    ASSERT_TRUE(match.has_value());
+    EXPECT_EQ(match->first, key);
+    EXPECT_EQ(match->second, value);
+  }
+  EXPECT_FALSE(iterator.next().has_value());
+
+  rime::TriePrefixIterator staleIterator(trie, "accord");
+  trie->loadTextFile(helper.txtPath_, options);
+  EXPECT_THROW(staleIterator.next(), std::runtime_error);
+
+  LevelDb db;
+  db.loadTextFile(helper.txtPath_, options);
+  db.saveToBinaryFile(helper.levelDbFolderPath_);
+  const auto dbAll = db.prefixSearch("accord");
+  const std::vector<std::pair<std::string, std::string>> dbPage = {dbAll[3], dbAll[4]};
+  EXPECT_EQ(db.prefixSearch("accord", {2, 3}), dbPage);
+  auto dbIterator = db.prefixIterator("accord");
+  db.close();  // the iterator keeps the db open
+  size_t count = 0;
+  while (dbIterator->next().has_value()) {
+    ++count;
+  }
+  EXPECT_EQ(count, all.size());
+}
+
+TEST_F(DictionaryTest, FindManyKeysInOneCall) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+
+  const std::vector<std::string> words = {"accordion", "nonexistent-word", "accord", "", "acc"};
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < 40000; ++i) {  // enough to be looked up on multiple threads
+    keys.push_back(words[i % words.size()]);
+  }
+
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+  LevelDb db;
+  db.loadTextFile(helper.txtPath_, options);
+  db.saveToBinaryFile(helper.levelDbFolderPath_);
+
+  const auto trieValues = trie.findMany(keys);
+  const auto trieViews = trie.findManyView(keys, {4});
+  const auto dbValues = db.findMany(keys, {4});
+  ASSERT_EQ(trieValues.size(), keys.size());
+  ASSERT_EQ(trieViews.size(), keys.size());
+  ASSERT_EQ(dbValues.size(), keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const auto expected = trie.find(keys[i]);
+    EXPECT_EQ(trieValues[i], expected);
+    EXPECT_EQ(trieViews[i].has_value(), expected.has_value());
+    if (trieViews[i].has_value() && expected.has_value()) {
+      EXPECT_EQ(trieViews[i].value(), expected.value());
+    }
+    EXPECT_EQ(dbValues[i], expected);
+  }
+  EXPECT_TRUE(trie.findMany({}).empty());
+
+  // the ranges run on the shared pool, and an exception is rethrown after all of them are done
+  for (int round = 0; round < 2; ++round) {
+    std::atomic<size_t> visited = 0;
+    EXPECT_THROW(ThreadPool::forEachRange(100, 4, 10,
+                                          [&](size_t begin, size_t end) {
+                                            visited += end - begin;
+                                            if (begin > 0) {
+                                              throw std::runtime_error("failed range");
+                                            }
+                                          }),
+                 std::runtime_error);
+    EXPECT_EQ(visited, 100U);
+  }
+}
+
+TEST_F(DictionaryTest, AddKeysToTheLoadedTrie) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+
+  {
+    rime::Trie trie;
+    trie.loadTextFile(helper.txtPath_, options);
+    trie.saveToBinaryFile(helper.binaryPath_);
+  }
+
+  auto trie = std::make_shared<rime::Trie>();
+  trie->loadBinaryFile(helper.binaryPath_);
+  auto staleIterator = std::make_shared<rime::TriePrefixIterator>(trie, "accord");
+  trie->add("accordant", "a. 一致的");
+  trie->add("accordion", "n. 手风琴");  // overrides the value in the file
+  trie->add("account", "n. 账户");
+  EXPECT_THROW(staleIterator->next(), std::runtime_error);
+  EXPECT_EQ(trie->deltaSize(), 3);
+
+  EXPECT_EQ(trie->find("accordant"), "a. 一致的");
+  EXPECT_EQ(trie->find("accordion"), "n. 手风琴");
+  EXPECT_TRUE(trie->find("accordance").has_value());
+  EXPECT_TRUE(trie->contains("account"));
+  EXPECT_EQ(trie->findMany({"account", "nonexistent-word"}),
+            (std::vector<std::optional<std::string>>{"n. 账户", std::nullopt}));
+
+  const auto matches = trie->prefixSearch("accord");
+  ASSERT_EQ(matches.size(), 7);
+  EXPECT_EQ(matches[5], std::make_pair(std::string("accordant"), std::string("a. 一致的")));
+  EXPECT_EQ(matches[6], std::make_pair(std::string("accordion"), std::string("n. 手风琴")));
+  EXPECT_EQ(trie->prefixSearch("accord", {1, 5})[0], matches[5]);
+
+  rime::TriePrefixIterator iterator(trie, "accord");
+  for (const auto& [key, value] : matches) {
+    auto match = iterator.next();
+    ASSERT_TRUE(match.has_value());
+    EXPECT_EQ(match->first, key);
+    EXPECT_EQ(match->second, value);
+  }
+  EXPECT_FALSE(iterator.next().has_value());
+
+  // in the byte order of the keys, with the added keys merged in
+  auto sorted = matches;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const auto& a, const auto& b) { return a.first < b.first; });
+  EXPECT_EQ(trie->prefixSearchInKeyOrder("accord", 0), sorted);
+  sorted.resize(3);
+  EXPECT_EQ(trie->prefixSearchInKeyOrder("accord", 3), sorted);
+
+  trie->compact();
+  EXPECT_EQ(trie->deltaSize(), 0);
+  EXPECT_EQ(trie->find("accordion"), "n. 手风琴");
+  EXPECT_EQ(trie->prefixSearch("acc").size(), 8);
+
+  rime::Trie empty;
+  empty.add("accord", "n. 一致");
+  EXPECT_EQ(empty.find("accord"), "n. 一致");
+  EXPECT_EQ(empty.prefixSearch("acc").size(), 1);
+  EXPECT_EQ(empty.prefixSearchInKeyOrder("acc", 0).size(), 1);
+}
+
+TEST_F(DictionaryTest, SearchTopKWeightedCompletions) {
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    for (int i = 0; i < 300; ++i) {
+      // the weights of the keys are not in their byte order
+      file << "key" << i << "\tvalue" << i << "\t" << (i * 37) % 101 << "\n";
+    }
+    file << "key7\tduplicated\t1000\n";
+  }
+  ParseTextFileOptions options;
+  options.weightColumn = 2;
+  options.onDuplicatedKey = OnDuplicatedKey::Concat;
+
+  const auto expectTopK = [&](const rime::Trie& trie, const std::string& prefix, size_t k) {
+    std::vector<std::pair<double, std::string>> expected;
+    for (const auto& [key, value] : trie.prefixSearch(prefix)) {
+      if (expected.empty() || expected.back().second != key) {
+        expected.emplace_back(rime::WeightIndex::parseWeight(
+                                  trie.find(key).value(), {2, "\t"}, options.concatSeparator),
+                              key);
+      }
+    }
+    std::sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) {
+      return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+    expected.resize(std::min(expected.size(), k));
+
+    const auto matches = trie.topK(prefix, k);
+    ASSERT_EQ(matches.size(), expected.size()) << prefix;
+    for (size_t i = 0; i < matches.size(); ++i) {
+      EXPECT_EQ(matches[i].key, expected[i].second) << prefix;
+      EXPECT_EQ(matches[i].weight, expected[i].first) << prefix;
+      EXPECT_EQ(matches[i].value, trie.find(matches[i].key).value());
+    }
+  };
+
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+  EXPECT_EQ(trie.topK("key", 1)[0].key, "key7");
+  for (const auto* prefix : {"", "key", "key1", "key29", "key299", "key3", "nonexistent"}) {
+    expectTopK(trie, prefix, 10);
+  }
+  expectTopK(trie, "key1", 1000);
+
+  trie.saveToBinaryFile(helper.binaryPath_);
+  rime::Trie loaded;
+  loaded.loadBinaryFile(helper.binaryPath_);
+  expectTopK(loaded, "key2", 10);
+
+  rime::Trie built;
+  built.buildBinaryFile(helper.txtPath_, options, helper.mergedBinaryPath_);
+  expectTopK(built, "key", 10);
+  expectTopK(built, "key1", 5);
+
+  built.add("key1000", "added\t500");
+  built.add("key0", "overridden\t-1");
+  EXPECT_EQ(built.topK("key", 2)[1].key, "key1000");
+  EXPECT_EQ(built.topK("key0", 1)[0].weight, -1);
+  built.compact();
+  expectTopK(built, "key", 10);
+  expectTopK(built, "key100", 10);
+
+  rime::Trie unweighted;
+  unweighted.loadTextFile(helper.txtPath_, ParseTextFileOptions{});
+  EXPECT_THROW((void)unweighted.topK("key", 1), std::runtime_error);
+}
+
+TEST_F(DictionaryTest, FuzzySearchWithinEditDistance) {
+  const auto levenshtein = [](const std::string& a, const std::string& b) {
+    LevenshteinMatcher matcher(a, std::max(a.size(), b.size()));
+    for (size_t pos = 0; pos < b.size();) {
+      uint32_t codePoint = 0;
+      pos += decodeUtf8(b, pos, codePoint);
+      matcher.push(codePoint);
+    }
+    return matcher.distance().value();
+  };
+
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    const std::vector<std::string> stems = {"accord", "account", "accurate", "点头", "点点", "ab"};
+    for (const auto& stem : stems) {
+      for (const auto* suffix : {"", "s", "ed", "ing", "ion", "ingly", "之交"}) {
+        file << stem << suffix << "\tvalue of " << stem << suffix << "\n";
+      }
+    }
+  }
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, ParseTextFileOptions{});
+  trie.add("accorb", "added");
+
+  for (const std::string query : {"acord", "accourd", "点投", "ab", "", "xyz", "accordingly"}) {
+    for (size_t maxDistance : {0, 1, 2, 3}) {
+      std::vector<std::pair<size_t, std::string>> expected;
+      for (const auto& [key, value] : trie.prefixSearch("")) {
+        const size_t distance = levenshtein(query, key);
+        if (distance <= maxDistance) {
+          expected.emplace_back(distance, key);
+        }
+      }
+      std::sort(expected.begin(), expected.end());
+
+      const auto matches = trie.fuzzySearch(query, maxDistance);
+      ASSERT_EQ(matches.size(), expected.size()) << query << " " << maxDistance;
+      for (size_t i = 0; i < matches.size(); ++i) {
+        EXPECT_EQ(matches[i].distance, expected[i].first);
+        EXPECT_EQ(matches[i].key, expected[i].second);
+        EXPECT_EQ(matches[i].value, trie.find(matches[i].key).value());
+      }
+    }
+  }
+  EXPECT_EQ(levenshtein("点投", "点头"), 1);
+  EXPECT_EQ(trie.fuzzySearch("acord", 2, 1).size(), 1);
+  EXPECT_EQ(trie.fuzzySearch("acord", 2, 1)[0].key, "accord");
+}
+
+TEST_F(DictionaryTest, SegmentTextByLongestMatch) {
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    for (const auto* key : {"中", "中国", "中国人", "国人", "人民", "民", "银行", "银"}) {
+      file << key << "\tvalue of " << key << "\n";
+    }
+  }
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, ParseTextFileOptions{});
+
+  auto matches = trie.commonPrefixSearch("中国人民银行");
+  ASSERT_EQ(matches.size(), 3);
+  EXPECT_EQ(matches[0].length, std::string("中").length());
+  EXPECT_EQ(matches[1].length, std::string("中国").length());
+  EXPECT_EQ(matches[2].length, std::string("中国人").length());
+  EXPECT_EQ(matches[2].value, "value of 中国人");
+  EXPECT_TRUE(trie.commonPrefixSearch("国家").empty());
+  EXPECT_TRUE(trie.commonPrefixSearch("").empty());
+
+  trie.add("中国人民", "added");
+  trie.add("中", "overridden");
+  matches = trie.commonPrefixSearch("中国人民银行");
+  ASSERT_EQ(matches.size(), 4);
+  EXPECT_EQ(matches[0].value, "overridden");
+  EXPECT_EQ(matches[3].length, std::string("中国人民").length());
+  EXPECT_EQ(matches[3].value, "added");
+
+  const auto segments = trie.longestMatchSegmentation("中国人民的银行ok");
+  std::vector<std::string> texts;
+  for (const auto& segment : segments) {
+    texts.emplace_back(segment.text);
+  }
+  EXPECT_EQ(texts, (std::vector<std::string>{"中国人民", "的", "银行", "o", "k"}));
+  EXPECT_EQ(segments[0].value, "added");
+  EXPECT_FALSE(segments[1].value.has_value());
+  EXPECT_EQ(segments[2].value, "value of 银行");
+  EXPECT_TRUE(trie.longestMatchSegmentation("").empty());
+
+  // the added keys are found past the prefixes that are not added themselves
+  trie.add("中国人民银行", "bank");
+  trie.add("中国人民银", "unmatched");
+  matches = trie.commonPrefixSearch("中国人民银行行长");
+  ASSERT_EQ(matches.size(), 6);
+  EXPECT_EQ(matches[4].value, "unmatched");
+  EXPECT_EQ(matches[5].length, std::string("中国人民银行").length());
+  EXPECT_EQ(matches[5].value, "bank");
+  EXPECT_EQ(trie.longestMatchSegmentation("中国人民银行")[0].value, "bank");
+}
+
+TEST_F(DictionaryTest, ReverseFindKeysByValue) {
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    file << "zhong\t中\nzhong\t种\nzhong\t重\nchong\t重\nchong\t虫\nzhongyao\t重要\n";
+  }
+  ParseTextFileOptions options;
+  options.onDuplicatedKey = OnDuplicatedKey::Concat;
+  options.reverseIndex = true;
+
+  const auto expectReverseFind = [](const rime::Trie& trie) {
+    EXPECT_EQ(trie.reverseFind("重"), (std::vector<std::string>{"chong", "zhong"}));
+    EXPECT_EQ(trie.reverseFind("中"), (std::vector<std::string>{"zhong"}));
+    EXPECT_EQ(trie.reverseFind("重要"), (std::vector<std::string>{"zhongyao"}));
+    EXPECT_TRUE(trie.reverseFind("重要的").empty());
+    EXPECT_TRUE(trie.reverseFind("").empty());
+  };
+
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+  expectReverseFind(trie);
+
+  trie.saveToBinaryFile(helper.binaryPath_);
+  rime::Trie loaded;
+  loaded.loadBinaryFile(helper.binaryPath_);
+  expectReverseFind(loaded);
+
+  rime::Trie built;
+  built.buildBinaryFile(helper.txtPath_, options, helper.binaryPath_);
+  expectReverseFind(built);
+
+  built.add("zhong4", "中");
+  built.add("zhong", "钟");  // overrides the indexed items of the key
+  EXPECT_EQ(built.reverseFind("中"), (std::vector<std::string>{"zhong4"}));
+  EXPECT_EQ(built.reverseFind("钟"), (std::vector<std::string>{"zhong"}));
+  EXPECT_EQ(built.reverseFind("重"), (std::vector<std::string>{"chong"}));
+  built.compact();
+  EXPECT_EQ(built.deltaSize(), 0);
+  EXPECT_EQ(built.reverseFind("中"), (std::vector<std::string>{"zhong4"}));
+  EXPECT_EQ(built.reverseFind("钟"), (std::vector<std::string>{"zhong"}));
+
+  options.reverseIndex = false;
+  trie.loadTextFile(helper.txtPath_, options);
+  EXPECT_THROW((void)trie.reverseFind("重"), std::runtime_error);
+
+  options.onDuplicatedKey = OnDuplicatedKey::Overwrite;
+  options.reverseIndex = true;
+  trie.loadTextFile(helper.txtPath_, options);
+  EXPECT_EQ(trie.reverseFind("重"), (std::vector<std::string>{"zhong"}));
+  EXPECT_EQ(trie.reverseFind("虫"), (std::vector<std::string>{"chong"}));
+}
+
+TEST_F(DictionaryTest, TuneLevelDbAndVisitPrefixMatches) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+  LevelDbOptions tuning;
+  tuning.blockCacheSize = 1024 * 1024;
+  tuning.bloomFilterBitsPerKey = 10;
+  tuning.compression = false;
+  tuning.fillCache = false;
+
+  {
+    LevelDb db;
+    db.loadTextFile(helper.txtPath_, options);
+    db.saveToBinaryFile(helper.levelDbFolderPath_, tuning);
+  }
+
+  std::shared_ptr<LevelDbPrefixIterator> iterator;
+  std::vector<std::pair<std::string, std::string>> all;
+  {
+    LevelDb db;
+    db.loadBinaryFile(helper.levelDbFolderPath_, tuning);
+    DictionaryDataHelper::testSearchItems(db);
+
+    all = db.prefixSearch("accord");
+    ASSERT_EQ(all.size(), 6);
+    std::vector<std::pair<std::string, std::string>> visited;
+    db.forEachPrefixMatch("accord", {2, 1}, [&](std::string_view key, std::string_view item) {
+      visited.emplace_back(key, item);
+    });
+    EXPECT_EQ(visited, (std::vector<std::pair<std::string, std::string>>{all[1], all[2]}));
+    db.forEachPrefixMatch("nonexistent", {}, [](std::string_view, std::string_view) { FAIL(); });
+    iterator = db.prefixIterator("accord");
+  }
+
+  // the iterator keeps the db, and its cache and filter policy, alive
+  size_t count = 0;
+  while (iterator->next().has_value()) {
+    ++count;
+  }
+  EXPECT_EQ(count, all.size());
+}
+
+TEST_F(DictionaryTest, ShareDictionariesOpenedByPath) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+  {
+    rime::Trie trie;
+    trie.loadTextFile(helper.txtPath_, options);
+    trie.saveToBinaryFile(helper.binaryPath_);
+    LevelDb db;
+    db.loadTextFile(helper.txtPath_, options);
+    db.saveToBinaryFile(helper.levelDbFolderPath_);
+  }
+
+  auto& registry = DictionaryRegistry::instance();
+  const size_t opened = registry.size();
+  auto trie = registry.openTrie(helper.binaryPath_);
+  const auto relativePath = std::filesystem::relative(helper.binaryPath_).string();
+  EXPECT_EQ(registry.openTrie(relativePath), trie);
+  EXPECT_EQ(registry.size(), opened + 1);
+  DictionaryDataHelper::testSearchItems(*trie);
+
+  // the modified file is loaded again, while the users of the previous one keep it
+  const auto modified = std::filesystem::last_write_time(helper.binaryPath_);
+  std::filesystem::last_write_time(helper.binaryPath_, modified + std::chrono::seconds(1));
+  auto reloaded = registry.openTrie(helper.binaryPath_);
+  EXPECT_NE(reloaded, trie);
+  EXPECT_EQ(registry.openTrie(helper.binaryPath_), reloaded);
+  DictionaryDataHelper::testSearchItems(*trie);
+  trie.reset();
+  reloaded.reset();
+  EXPECT_EQ(registry.size(), opened);
+
+  // a level db could be opened only once, and it's shared until the last user releases it
+  auto db = registry.openLevelDb(helper.levelDbFolderPath_);
+  EXPECT_EQ(registry.openLevelDb(helper.levelDbFolderPath_), db);
+  DictionaryDataHelper::testSearchItems(*db);
+
+  // closing it by one user keeps it open for the others
+  auto otherUser = registry.openLevelDb(helper.levelDbFolderPath_);
+  db->close();
+  EXPECT_TRUE(otherUser->isLoaded());
+  DictionaryDataHelper::testSearchItems(*otherUser);
+  otherUser.reset();
+  db.reset();
+  db = registry.openLevelDb(helper.levelDbFolderPath_);
+  DictionaryDataHelper::testSearchItems(*db);
+  db.reset();
+
+  EXPECT_THROW((void)registry.openTrie(helper.binaryPath_ + ".nonexistent"), std::runtime_error);
+}
+
+TEST_F(DictionaryTest, SwapInTrieLoadedInBackground) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+  {
+    rime::Trie trie;
+    trie.loadTextFile(helper.txtPath_, options);
+    trie.saveToBinaryFile(helper.binaryPath_);
+  }
+
+  auto trie = std::make_shared<rime::Trie>();
+  EXPECT_FALSE(trie->isLoaded());
+  // not ready yet, the searches find nothing instead of blocking or throwing
+  const auto expectEmpty = [](const std::shared_ptr<rime::Trie>& unloaded) {
+    EXPECT_FALSE(unloaded->find("accord").has_value());
+    EXPECT_TRUE(unloaded->findAll("accord").empty());
+    EXPECT_FALSE(unloaded->findMany({"accord", "accordion"})[1].has_value());
+    EXPECT_FALSE(unloaded->contains("accord"));
+    EXPECT_TRUE(unloaded->prefixSearch("acc").empty());
+    EXPECT_TRUE(unloaded->commonPrefixSearch("accordion").empty());
+    EXPECT_FALSE(unloaded->longestMatchSegmentation("accord").front().value.has_value());
+    EXPECT_TRUE(unloaded->fuzzySearch("accord", 1).empty());
+    EXPECT_FALSE(rime::TriePrefixIterator(unloaded, "acc").next().has_value());
+  };
+  expectEmpty(trie);
+
+  auto loaded = std::make_shared<rime::Trie>();
+  std::thread([loaded, path = helper.binaryPath_] { loaded->loadBinaryFile(path); }).join();
+  rime::TriePrefixIterator staleIterator(trie, "accord");
+  trie->swap(*loaded);
+  EXPECT_TRUE(trie->isLoaded());
+  DictionaryDataHelper::testSearchItems(*trie);
+  EXPECT_FALSE(loaded->isLoaded());
+  expectEmpty(loaded);
+  EXPECT_THROW(loaded->saveToBinaryFile(helper.mergedBinaryPath_), std::runtime_error);
+  EXPECT_THROW(staleIterator.next(), std::runtime_error);
+
+  // the added keys are swapped along with the trie
+  loaded->add("accord", "added");
+  trie->swap(*loaded);
+  EXPECT_EQ(trie->find("accord"), "added");
+  DictionaryDataHelper::testSearchItems(*loaded);
+}
+
+TEST_F(DictionaryTest, DeduplicateAndCompressValues) {
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    for (int i = 0; i < 3000; ++i) {
+      const std::string key = "key" + std::to_string(i);
+      file << key << "\tthe definition of the word " << (i % 7) << "\n";
+      file << key << "\ta sentence of the key " << key << " to be compressed\n";
+    }
+  }
+  ParseTextFileOptions options;
+  options.onDuplicatedKey = OnDuplicatedKey::Concat;
+  rime::Trie plain;
+  plain.buildBinaryFile(helper.txtPath_, options, helper.binaryPath_);
+  const auto plainSize = std::filesystem::file_size(helper.binaryPath_);
+
+  options.deduplicateValues = true;
+  options.compressValues = true;
+  rime::Trie built;
+  built.buildBinaryFile(helper.txtPath_, options, helper.mergedBinaryPath_);
+  EXPECT_LT(std::filesystem::file_size(helper.mergedBinaryPath_), plainSize);
+  // unreadable by the readers of the plain value pool
+  const auto versionOf = [](const std::string& path) {
+    rime::BinaryFileHeader header{};
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(&header), sizeof(header));
+    return header.version;
+  };
+  EXPECT_EQ(versionOf(helper.binaryPath_), rime::binary_format::BASE_VERSION);
+  EXPECT_EQ(versionOf(helper.mergedBinaryPath_), rime::binary_format::VALUE_ENCODING_VERSION);
+
+  rime::TrieLoadOptions loadOptions;
+  loadOptions.cachedValueBlocks = 1;  // to evict the blocks between the lookups
+  auto compressed = std::make_shared<rime::Trie>();
+  compressed->loadBinaryFile(helper.mergedBinaryPath_, loadOptions);
+  for (const auto* key : {"key0", "key1234", "key2999", "key3000"}) {
+    EXPECT_EQ(compressed->find(key), plain.find(key));
+    EXPECT_EQ(compressed->findAll(key), plain.findAll(key));
+  }
+  EXPECT_EQ(compressed->prefixSearch("key12"), plain.prefixSearch("key12"));
+
+  // the items of a value are got again after the lookups in between evict its block
+  rime::TriePrefixIterator iterator(compressed, "key29");
+  size_t count = 0;
+  while (auto item = iterator.next()) {
+    EXPECT_EQ(compressed->find("key0"), plain.find("key0"));
+    EXPECT_TRUE(item->second.find("the definition") == 0 || item->second.find("a sentence") == 0);
+    ++count;
+  }
+  EXPECT_EQ(count, 111 * 2);
+
+  // the values read one after another keep the blocks of the recent batches only
+  {
+    std::ifstream file(helper.mergedBinaryPath_, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    rime::BinaryFileReader reader(data.data(), data.size());
+    rime::ValuePool pool;
+    pool.load(reader, reader.header().valueCount, 1);
+    const auto readValue = pool.pinInBatches([&](size_t id) { return pool.at(id); });
+    size_t size = 0;
+    for (size_t id = 0; id < pool.size(); ++id) {
+      size += readValue(id).size();
+    }
+    const size_t blocks = reader.section(rime::binary_format::SectionType::ValueBlocks).size() /
+                              sizeof(rime::ValueBlock) - 1;
+    EXPECT_GT(size, 3000U * 2 * 20);
+    EXPECT_LT(pool.decodedBlocks(), blocks / 2);
+  }
+
+  // saved the same way as loaded
+  compressed->saveToBinaryFile(helper.binaryPath_);
+  rime::Trie saved;
+  saved.loadBinaryFile(helper.binaryPath_);
+  EXPECT_EQ(saved.prefixSearch("key2"), plain.prefixSearch("key2"));
+
+  const std::string block = "the definition of the word, the definition of the key";
+  const std::string dictionary = rime::block_codec::trainDictionary({block, block}, 64);
+  std::string encoded;
+  rime::BlockCompressor(dictionary).compress(block, encoded);
+  std::string decoded;
+  rime::block_codec::decompress(encoded, dictionary, block.size(), decoded);
+  EXPECT_EQ(decoded, block);
+  EXPECT_THROW(rime::block_codec::decompress(encoded, dictionary, block.size() + 1, decoded),
+               std::runtime_error);
+  EXPECT_THROW(rime::block_codec::decompress(encoded.substr(0, encoded.size() - 1), dictionary,
+                                             block.size(), decoded),
+               std::runtime_error);
+}
+
+TEST_F(DictionaryTest, DoubleArrayTrieMatchesTrie) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+  rime::DoubleArrayTrie dummy;
+  dummy.loadTextFile(helper.txtPath_, options);
+  DictionaryDataHelper::testSearchItems(dummy);
+
+  // the keys sharing prefixes, ending with the first and the last bytes, and in CJK
+  std::unordered_map<std::string, std::string> map;
+  for (int i = 0; i < 2000; ++i) {
+    map.emplace("key" + std::to_string(i), "value" + std::to_string(i));
+    map.emplace("中文" + std::to_string(i % 97), "值" + std::to_string(i % 97));
+  }
+  map.emplace("a", "1");
+  map.emplace("ab", "2");
+  map.emplace(std::string("a\0", 2), "3");
+  map.emplace("a\xFF", "4");
+  rime::Trie trie;
+  trie.build(map);
+  rime::DoubleArrayTrie built;
+  built.build(map);
+  EXPECT_EQ(built.size(), map.size());
+
+  const auto expectSameAsTrie = [&](const rime::DoubleArrayTrie& doubleArray) {
+    for (const auto& [key, value] : map) {
+      EXPECT_EQ(doubleArray.find(key), value);
+      EXPECT_TRUE(doubleArray.contains(key));
+    }
+    for (const auto* key : {"", "k", "key", "key20000", "中", "b", "a\xFE"}) {
+      EXPECT_EQ(doubleArray.find(key), trie.find(key));
+      EXPECT_FALSE(doubleArray.contains(key));
+    }
+    for (const auto* prefix : {"", "a", "key1", "key19", "中文", "nonexistent"}) {
+      auto expected = trie.prefixSearch(prefix);
+      std::sort(expected.begin(), expected.end());
+      EXPECT_EQ(doubleArray.prefixSearch(prefix), expected);  // in the byte order
+    }
+    EXPECT_EQ(doubleArray.prefixSearch("key1", {.limit = 3, .offset = 1}),
+              (std::vector<std::pair<std::string, std::string>>{
+                  {"key10", "value10"}, {"key100", "value100"}, {"key1000", "value1000"}}));
+    EXPECT_EQ(doubleArray.findMany({"a", "nonexistent", "ab"}),
+              (std::vector<std::optional<std::string>>{"1", std::nullopt, "2"}));
+  };
+  expectSameAsTrie(built);
+
+  built.saveToBinaryFile(helper.binaryPath_);
+  rime::DoubleArrayTrie loaded;
+  loaded.loadBinaryFile(helper.binaryPath_, {.verifyChecksums = true});
+  expectSameAsTrie(loaded);
+  EXPECT_EQ(DictionaryRegistry::instance().openDoubleArrayTrie(helper.binaryPath_)->size(),
+            map.size());
+
+  // saved the same way as loaded, with the values compressed
+  ParseTextFileOptions concatOptions;
+  concatOptions.onDuplicatedKey = OnDuplicatedKey::Concat;
+  concatOptions.compressValues = true;
+  {
+    std::ofstream file(helper.txtPath_);
+    file << "zhong\t中\nzhong\t种\nchong\t虫\n";
+  }
+  rime::DoubleArrayTrie concatenated;
+  concatenated.loadTextFile(helper.txtPath_, concatOptions);
+  concatenated.saveToBinaryFile(helper.mergedBinaryPath_);
+  loaded.loadBinaryFile(helper.mergedBinaryPath_);
+  EXPECT_EQ(loaded.findAll("zhong"), (std::vector<std::string>{"中", "种"}));
+  EXPECT_EQ(loaded.findAll("chong"), (std::vector<std::string>{"虫"}));
+  EXPECT_TRUE(loaded.findAll("zh").empty());
+  EXPECT_EQ(loaded.prefixSearch("zh", {.offset = 1}),
+            (std::vector<std::pair<std::string, std::string>>{{"zhong", "种"}}));
+
+  trie.saveToBinaryFile(helper.binaryPath_);
+  EXPECT_THROW(loaded.loadBinaryFile(helper.binaryPath_), std::runtime_error);
+  rime::DoubleArrayTrie empty;
+  EXPECT_FALSE(empty.find("a").has_value());
+  EXPECT_THROW(empty.saveToBinaryFile(helper.mergedBinaryPath_), std::runtime_error);
+  empty.build({});
+  EXPECT_TRUE(empty.prefixSearch("").empty());
+
+  // the temporary file is removed when it fails to replace the file, e.g. a folder
+  std::filesystem::create_directories(helper.levelDbFolderPath_ + "/not-empty");
+  EXPECT_THROW(built.saveToBinaryFile(helper.levelDbFolderPath_),
+               std::filesystem::filesystem_error);
+  EXPECT_FALSE(std::filesystem::exists(helper.levelDbFolderPath_ + ".temp"));
+}
+
+TEST_F(DictionaryTest, FstMatchesTrieAndIteratesRanges) {
+  auto helper = getDictHelper();
+  ParseTextFileOptions options;
+  options.lines = helper.entrySize_;
+  rime::Fst dummy;
+  dummy.loadTextFile(helper.txtPath_, options);
+  DictionaryDataHelper::testSearchItems(dummy);
+
+  // the suffixes after "ta" and "to" are shared, as well as the ones after "tap" and "top"
+  rime::Fst shared;
+  shared.build({{"tap", "1"}, {"taps", "2"}, {"top", "3"}, {"tops", "4"}});
+  EXPECT_EQ(shared.stateCount(), 5U);
+  EXPECT_EQ(shared.arcCount(), 5U);
+  EXPECT_EQ(shared.find("top"), "3");
+  EXPECT_EQ(shared.find("taps"), "2");
+  EXPECT_FALSE(shared.contains("to"));
+
+  std::unordered_map<std::string, std::string> map;
+  for (int i = 0; i < 2000; ++i) {
+    map.emplace("key" + std::to_string(i), "value" + std::to_string(i));
+    map.emplace("中文" + std::to_string(i % 97), "值" + std::to_string(i % 97));
+  }
+  map.emplace("", "0");
+  map.emplace("a", "1");
+  map.emplace("ab", "2");
+  map.emplace(std::string("a\0", 2), "3");
+  map.emplace("a\xFF", "4");
+  const std::map<std::string, std::string> sorted(map.begin(), map.end());
+  rime::Trie trie;
+  trie.build(map);
+  rime::Fst built;
+  built.build(map);
+  EXPECT_EQ(built.size(), map.size());
+
+  const auto expectSameAsTrie = [&](const rime::Fst& fst) {
+    for (const auto& [key, value] : map) {
+      EXPECT_EQ(fst.find(key), value);
+      EXPECT_TRUE(fst.contains(key));
+    }
+    for (const auto* key : {"k", "key", "key20000", "中", "b", "a\xFE"}) {
+      EXPECT_EQ(fst.find(key), trie.find(key));
+      EXPECT_FALSE(fst.contains(key));
+    }
+    for (const auto* prefix : {"", "a", "key1", "key19", "中文", "nonexistent"}) {
+      auto expected = trie.prefixSearch(prefix);
+      std::sort(expected.begin(), expected.end());
+      EXPECT_EQ(fst.prefixSearch(prefix), expected);  // in the byte order
+    }
+    EXPECT_EQ(fst.prefixSearch("key1", {.limit = 3, .offset = 1}),
+              (std::vector<std::pair<std::string, std::string>>{
+                  {"key10", "value10"}, {"key100", "value100"}, {"key1000", "value1000"}}));
+    EXPECT_EQ(fst.findMany({"a", "nonexistent", "ab"}),
+              (std::vector<std::optional<std::string>>{"1", std::nullopt, "2"}));
+
+    // from the keys in the map or between them, to the end or before another key
+    for (const auto* from : {"", "a", "a\x01", "key1999", "key2", "kez", "中文5", "\xFF"}) {
+      for (const auto* to : {"", "ab", "key2", "key20", "中文50", "\xFF"}) {
+        std::vector<std::pair<std::string, std::string>> expected;
+        for (auto it = sorted.lower_bound(from);
+             it != sorted.end() && (std::string(to).empty() || it->first < to); ++it) {
+          expected.emplace_back(*it);
+        }
+        EXPECT_EQ(fst.range(from, to), expected) << from << " " << to;
+      }
+    }
+    EXPECT_EQ(fst.range("key19", "key2", {.limit = 2, .offset = 1}),
+              (std::vector<std::pair<std::string, std::string>>{{"key190", "value190"},
+                                                                {"key1900", "value1900"}}));
+  };
+  expectSameAsTrie(built);
+
+  built.saveToBinaryFile(helper.binaryPath_);
+  rime::Fst loaded;
+  loaded.loadBinaryFile(helper.binaryPath_, {.verifyChecksums = true});
+  expectSameAsTrie(loaded);
+  EXPECT_EQ(loaded.transducerSize(), built.transducerSize());
+  EXPECT_EQ(DictionaryRegistry::instance().openFst(helper.binaryPath_)->size(), map.size());
+
+  // built from the sorted lines, and saved with the values deduplicated
+  ParseTextFileOptions concatOptions;
+  concatOptions.onDuplicatedKey = OnDuplicatedKey::Concat;
+  concatOptions.deduplicateValues = true;
+  {
+    std::ofstream file(helper.txtPath_);
+    file << "zhong\t中\nchong\t虫\nzhong\t种\nchang\t虫\n";
+  }
+  rime::Fst concatenated;
+  concatenated.loadTextFile(helper.txtPath_, concatOptions);
+  concatenated.saveToBinaryFile(helper.mergedBinaryPath_);
+  loaded.loadBinaryFile(helper.mergedBinaryPath_);
+  EXPECT_EQ(loaded.findAll("zhong"), (std::vector<std::string>{"中", "种"}));
+  EXPECT_EQ(loaded.findAll("chang"), (std::vector<std::string>{"虫"}));
+  EXPECT_EQ(loaded.range("c", "d").size(), 2U);
+  EXPECT_EQ(loaded.prefixSearch("zh"),
+            (std::vector<std::pair<std::string, std::string>>{{"zhong", "中"}, {"zhong", "种"}}));
+  EXPECT_TRUE(loaded.findAll("zh").empty());
+
+  trie.saveToBinaryFile(helper.binaryPath_);
+  EXPECT_THROW(loaded.loadBinaryFile(helper.binaryPath_), std::runtime_error);
+  rime::Fst empty;
+  EXPECT_FALSE(empty.find("a").has_value());
+  EXPECT_TRUE(empty.range("", "").empty());
+  EXPECT_THROW(empty.saveToBinaryFile(helper.mergedBinaryPath_), std::runtime_error);
+  empty.build({});
+  EXPECT_TRUE(empty.prefixSearch("").empty());
+  EXPECT_FALSE(empty.contains(""));
+
+  // the temporary file is removed when it fails to replace the file, e.g. a folder
+  std::filesystem::create_directories(helper.levelDbFolderPath_ + "/not-empty");
+  EXPECT_THROW(concatenated.saveToBinaryFile(helper.levelDbFolderPath_),
+               std::filesystem::filesystem_error);
+  EXPECT_FALSE(std::filesystem::exists(helper.levelDbFolderPath_ + ".temp"));
+}
+
+TEST_F(DictionaryTest, SearchSortedTextFileWithCachedIndex) {
+  auto helper = getDictHelper();
+  const std::string indexPath = rime::SortedTextDictionary::indexPathOf(helper.txtPath_);
+  rime::SortedTextDictionary dummy;  // the dummy file is sorted
+  dummy.loadTextFile(helper.txtPath_, {});
+  DictionaryDataHelper::testSearchItems(dummy);
+  EXPECT_TRUE(std::filesystem::exists(indexPath));
+
+  // the keys of several blocks of the index, the duplicated ones across the blocks, the comments
+  // and the line breaks of Windows
+  std::map<std::string, std::string> sorted;
+  for (int i = 0; i < 500; ++i) {
+    sorted.emplace("key" + std::to_string(i), "value" + std::to_string(i));
+    sorted.emplace("中文" + std::to_string(i % 97), "值" + std::to_string(i % 97));
+  }
+  {
+    std::ofstream file(helper.txtPath_, std::ios::binary);
+    file << "# a comment\tignored\n";
+    for (const auto& [key, value] : sorted) {
+      file << key << '\t' << value << "\r\n";
+      if (key == "key1" || key == "key2") {
+        for (int i = 0; i < 20; ++i) {
+          file << key << '\t' << "more" << i << '\n';
+        }
+      }
+    }
+    file << "no delimiter\n";
+  }
+  ParseTextFileOptions options;
+  options.onDuplicatedKey = OnDuplicatedKey::Concat;
+  options.concatSeparator = "|";
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+
+  const auto expectSameAsTrie = [&](const rime::SortedTextDictionary& dictionary) {
+    EXPECT_EQ(dictionary.size(), sorted.size());
+    for (const auto& [key, value] : sorted) {
+      EXPECT_EQ(dictionary.find(key), trie.find(key));
+      EXPECT_TRUE(dictionary.contains(key));
+    }
+    for (const auto* key : {"", "k", "key", "key20000", "中", "zzz", "# a comment"}) {
+      EXPECT_EQ(dictionary.find(key), trie.find(key));
+      EXPECT_FALSE(dictionary.contains(key));
+    }
+    EXPECT_EQ(dictionary.findAll("key2").size(), 21U);
+    for (const auto* prefix : {"", "key1", "key2", "key49", "中文", "nonexistent"}) {
+      auto expected = trie.prefixSearch(prefix);
+      auto matches = dictionary.prefixSearch(prefix);
+      EXPECT_TRUE(std::is_sorted(matches.begin(), matches.end(),
+                                 [](const auto& a, const auto& b) { return a.first < b.first; }));
+      std::sort(expected.begin(), expected.end());
+      std::sort(matches.begin(), matches.end());
+      EXPECT_EQ(matches, expected);  // a result per item, the same as the trie
+    }
+    EXPECT_EQ(dictionary.prefixSearch("key1", {.limit = 2, .offset = 21}),
+              (std::vector<std::pair<std::string, std::string>>{{"key10", "value10"},
+                                                                {"key100", "value100"}}));
+    EXPECT_EQ(dictionary.findMany({"key2", "nonexistent"})[1], std::nullopt);
+  };
+
+  rime::SortedTextDictionary built;
+  built.loadTextFile(helper.txtPath_, options);
+  expectSameAsTrie(built);
+  EXPECT_LT(built.indexSize(), sorted.size());  // less than a byte per entry
+
+  // the cached index is reused, and rebuilt with the other options
+  const auto indexTime = std::filesystem::last_write_time(indexPath);
+  rime::SortedTextDictionary cached;
+  cached.loadTextFile(helper.txtPath_, options);
+  EXPECT_EQ(std::filesystem::last_write_time(indexPath), indexTime);
+  expectSameAsTrie(cached);
+  options.comment = "//";
+  cached.loadTextFile(helper.txtPath_, options);
+  EXPECT_TRUE(cached.contains("# a comment"));
+  EXPECT_EQ(DictionaryRegistry::instance().openSortedTextDictionary(helper.txtPath_)->size(),
+            sorted.size());
+
+  // a corrupted index is rebuilt
+  {
+    std::ofstream file(indexPath, std::ios::binary | std::ios::trunc);
+    file << "corrupted";
+  }
+  options.comment = "#";
+  cached.loadTextFile(helper.txtPath_, options);
+  expectSameAsTrie(cached);
+
+  // replaced by renaming the new files over it, as the loaded file is still mapped
+  const auto replaceTextFile = [&](const std::string& content) {
+    {
+      std::ofstream file(helper.mergedBinaryPath_, std::ios::trunc);
+      file << content;
+    }
+    std::filesystem::rename(helper.mergedBinaryPath_, helper.txtPath_);
+  };
+  replaceTextFile("b\t1\na\t2\n");
+  EXPECT_THROW(cached.loadTextFile(helper.txtPath_, options), std::runtime_error);
+  expectSameAsTrie(cached);  // the loaded file is kept
+  replaceTextFile("");
+  rime::SortedTextDictionary empty;
+  EXPECT_FALSE(empty.find("a").has_value());
+  empty.loadTextFile(helper.txtPath_, options);
+  EXPECT_EQ(empty.size(), 0U);
+  EXPECT_TRUE(empty.prefixSearch("").empty());
+
+  // rewritten in place instead, the mapped file is not read anymore
+  replaceTextFile("a\t1\nb\t2\n");
+  rime::SortedTextDictionary rewritten;
+  rewritten.loadTextFile(helper.txtPath_, options);
+  EXPECT_EQ(rewritten.find("b"), "2");
+  {
+    std::ofstream file(helper.txtPath_, std::ios::app);
+    file << "c\t3\n";
+  }
+  EXPECT_THROW((void)rewritten.find("b"), std::runtime_error);
+  std::filesystem::remove(indexPath);
+}
+
+TEST_F(DictionaryTest, FindKeysByPerfectHashIndex) {
+  std::vector<std::pair<uint64_t, uint32_t>> hashes;
+  for (uint32_t id = 0; id < 10000; ++id) {
+    hashes.emplace_back(rime::PerfectHashIndex::hashOf("key" + std::to_string(id)), id);
+  }
+  rime::PerfectHashIndex index;
+  index.build(hashes);
+  ASSERT_TRUE(index.isBuilt());
+  EXPECT_EQ(index.size(), hashes.size());
+  EXPECT_LT(index.byteSize(), hashes.size() * 9);  // the 8-byte slots and about 5 bits per key
+  for (uint32_t id = 0; id < 10000; ++id) {
+    EXPECT_EQ(index.find("key" + std::to_string(id)), std::make_optional(id));
+    EXPECT_EQ(index.find("other" + std::to_string(id)), std::nullopt);
+  }
+  index.build({});
+  EXPECT_TRUE(index.isBuilt());
+  EXPECT_EQ(index.find("key0"), std::nullopt);
+  index.build({{1, 0}, {1, 1}});  // the keys of the same hash are never placed
+  EXPECT_FALSE(index.isBuilt());
+
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    for (int i = 0; i < 3000; ++i) {
+      file << "key" << i << "\tvalue" << i << "\n";
+    }
+    file << "key7\tagain\n中文\t汉字\n";
+  }
+  ParseTextFileOptions options;
+  options.onDuplicatedKey = OnDuplicatedKey::Concat;
+  rime::Trie plain;
+  plain.loadTextFile(helper.txtPath_, options);
+  options.perfectHashIndex = true;
+
+  const std::vector<std::string> keys{"key0", "key7", "key2999", "中文", "key3000", "key", "", "中"};
+  const auto expectSameAsPlain = [&](const rime::Trie& trie) {
+    for (const auto& key : keys) {
+      EXPECT_EQ(trie.find(key), plain.find(key));
+      EXPECT_EQ(trie.findAll(key), plain.findAll(key));
+      EXPECT_EQ(trie.contains(key), plain.contains(key));
+    }
+    EXPECT_EQ(trie.findMany(keys), plain.findMany(keys));
+    EXPECT_EQ(trie.prefixSearch("key7").size(), plain.prefixSearch("key7").size());
+  };
+
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+  expectSameAsPlain(trie);
+  trie.saveToBinaryFile(helper.binaryPath_);
+  rime::Trie loaded;
+  loaded.loadBinaryFile(helper.binaryPath_);
+  expectSameAsPlain(loaded);
+  rime::Trie built;
+  built.buildBinaryFile(helper.txtPath_, options, helper.binaryPath_);
+  expectSameAsPlain(built);
+
+  // the added keys are found before the index, and hashed once compacted
+  built.add("key3000", "value3000");
+  built.add("key0", "changed");
+  EXPECT_EQ(built.find("key3000"), "value3000");
+  EXPECT_EQ(built.find("key0"), "changed");
+  built.compact();
+  EXPECT_EQ(built.find("key3000"), "value3000");
+  EXPECT_EQ(built.find("key0"), "changed");
+  EXPECT_EQ(built.find("key1"), "value1");
+  EXPECT_FALSE(built.contains("key3001"));
+}
+
+TEST_F(DictionaryTest, SearchShardedTrieConcurrently) {
+  auto helper = getDictHelper();
+  {
+    std::ofstream file(helper.txtPath_);
+    for (int i = 0; i < 1000; ++i) {
+      file << "key" << i << "\tvalue" << i << "\t" << (i * 37) % 101 << "\n";
+    }
+    file << "key7\tduplicated\t1000\n中文\t汉字\t5\n";
+  }
+  ParseTextFileOptions options;
+  options.weightColumn = 2;
+  options.onDuplicatedKey = OnDuplicatedKey::Concat;
+  rime::Trie trie;
+  trie.loadTextFile(helper.txtPath_, options);
+
+  const auto sortedPrefixSearch = [&](const std::string& prefix) {
+    auto matches = trie.prefixSearch(prefix);
+    std::stable_sort(matches.begin(), matches.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    return matches;
+  };
+  const auto expectSameAsTrie = [&](const rime::ShardedTrie& sharded) {
+    EXPECT_EQ(sharded.size(), 1001U);
+    for (const auto* key : {"key0", "key7", "key999", "中文", "key1000", ""}) {
+      EXPECT_EQ(sharded.find(key), trie.find(key));
+      EXPECT_EQ(sharded.findAll(key), trie.findAll(key));
+      EXPECT_EQ(sharded.contains(key), trie.contains(key));
+    }
+    for (const auto* prefix : {"", "key", "key7", "key99", "中", "none"}) {
+      EXPECT_EQ(sharded.prefixSearch(prefix), sortedPrefixSearch(prefix)) << prefix;
+      const auto topK = sharded.topK(prefix, 5);
+      const auto expected = trie.topK(prefix, 5);
+      ASSERT_EQ(topK.size(), expected.size());
+      for (size_t i = 0; i < topK.size(); ++i) {
+        EXPECT_EQ(topK[i].key, expected[i].key);
+        EXPECT_EQ(topK[i].value, expected[i].value);
+      }
+    }
+    // the items of key7 are counted by the offset and the limit, as by the trie
+    auto expected = sortedPrefixSearch("key7");
+    expected = {expected.begin() + 1, expected.begin() + 4};
+    EXPECT_EQ(sharded.prefixSearch("key7", {.limit = 3, .offset = 1}), expected);
+    expected = sortedPrefixSearch("key");
+    expected = {expected.begin() + 10, expected.begin() + 15};
+    EXPECT_EQ(sharded.prefixSearch("key", {.limit = 5, .offset = 10}), expected);
+  };
+
+  rime::ShardedTrie sharded({.shards = 4, .threads = 2});
+  EXPECT_FALSE(sharded.find("key0").has_value());
+  EXPECT_TRUE(sharded.prefixSearch("").empty());
+  sharded.loadTextFile(helper.txtPath_, options);
+  EXPECT_EQ(sharded.shardCount(), 4U);
+  EXPECT_EQ(sharded.threadCount(), 2U);
+  expectSameAsTrie(sharded);
+
+  // the loaded file keeps its shards, searched in the calling thread
+  sharded.saveToBinaryFile(helper.binaryPath_);
+  rime::ShardedTrie loaded({.shards = 1, .threads = 1});
+  loaded.loadBinaryFile(helper.binaryPath_);
+  EXPECT_EQ(loaded.shardCount(), 4U);
+  EXPECT_EQ(loaded.threadCount(), 1U);
+  expectSameAsTrie(loaded);
+  auto opened = DictionaryRegistry::instance().openShardedTrie(helper.binaryPath_);
+  expectSameAsTrie(*opened);
+
+  // the shards of the previous file are replaced
+  rime::ShardedTrie single({.shards = 1});
+  single.loadTextFile(helper.txtPath_, options);
+  single.saveToBinaryFile(helper.binaryPath_);
+  EXPECT_FALSE(std::filesystem::exists(rime::ShardedTrie::shardPathOf(helper.binaryPath_, 1)));
+  loaded.loadBinaryFile(helper.binaryPath_);
+  EXPECT_EQ(loaded.shardCount(), 1U);
+  expectSameAsTrie(loaded);
+  std::filesystem::remove(rime::ShardedTrie::shardPathOf(helper.binaryPath_, 0));
+
+  // the temporary manifest is removed when it fails to replace the file, e.g. a folder
+  std::filesystem::create_directories(helper.levelDbFolderPath_ + "/not-empty");
+  EXPECT_THROW(single.saveToBinaryFile(helper.levelDbFolderPath_),
+               std::filesystem::filesystem_error);
+  EXPECT_FALSE(std::filesystem::exists(helper.levelDbFolderPath_ + ".temp"));
+  std::filesystem::remove(rime::ShardedTrie::shardPathOf(helper.levelDbFolderPath_, 0));
+
+  options.weightColumn = 0;
+  sharded.loadTextFile(helper.txtPath_, options);
+  EXPECT_THROW((void)sharded.topK("key", 5), std::runtime_error);
+  EXPECT_THROW(loaded.loadBinaryFile(helper.txtPath_), std::runtime_error);
 }
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "../dict_data_helper.hpp"
+#include "../test_helper.hpp"
+#include "../test_switch.h"
+#include "dicts/trie.h"
+#include "types/qjs_types.h"
+
+template <typename T>
+class LoadTrieAsyncTest : public ::testing::Test {
+private:
+  DictionaryDataHelper dictHelper_ =
+      DictionaryDataHelper(getFolderPath(__FILE__).c_str(), "dummy_dict.txt");
+
+protected:
+  DictionaryDataHelper getDictHelper() { return dictHelper_; }
+  void SetUp() override { dictHelper_.createDummyTextFile(); }
+  void TearDown() override { dictHelper_.cleanupDummyFiles(); }
+};
+
+SETUP_JS_ENGINES(LoadTrieAsyncTest);
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TYPED_TEST(LoadTrieAsyncTest, SettleThePromisesOfLoadBinaryFileAsync) {
+  auto helper = this->getDictHelper();
+  {
+    rime::Trie trie;
+    ParseTextFileOptions options;
+    options.lines = helper.entrySize_;
+    trie.loadTextFile(helper.txtPath_, options);
+    trie.saveToBinaryFile(helper.binaryPath_);
+  }
+
+  registerTypesToJsEngine<TypeParam>();
+  auto& jsEngine = JsEngine<TypeParam>::instance();
+  const std::string code = R"(
+    globalThis.asyncLoad = { settled: 0 }
+    {
+      const trie = new Trie()
+      trie.loadBinaryFileAsync(')" + helper.binaryPath_ + R"(').then(() => {
+        asyncLoad.resolved = trie.find('accord')
+        asyncLoad.settled++
+      })
+      const missing = new Trie()
+      missing.loadBinaryFileAsync(')" + helper.binaryPath_ + R"(.nonexistent').catch((e) => {
+        asyncLoad.rejected = e.message
+        asyncLoad.isLoaded = missing.isLoaded()
+        asyncLoad.settled++
+      })
+    }
+  )";
+  auto evalResult = jsEngine.eval(code.c_str());
+  ASSERT_FALSE(jsEngine.isException(evalResult));
+
+  // there is no event loop in the IME, so the host pumps the settlements of the finished loads
+  auto global = jsEngine.getGlobalObject();
+  auto asyncLoad = jsEngine.getObjectProperty(jsEngine.toObject(global), "asyncLoad");
+  constexpr int MAX_POLLS = 500;
+  for (int i = 0; i < MAX_POLLS; ++i) {
+    jsEngine.runPendingJobs();
+    auto settled = jsEngine.getObjectProperty(jsEngine.toObject(asyncLoad), "settled");
+    const auto count = jsEngine.toInt(settled);
+    jsEngine.freeValue(settled);
+    if (count == 2) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  auto resolved = jsEngine.getObjectProperty(jsEngine.toObject(asyncLoad), "resolved");
+  EXPECT_EQ(jsEngine.toStdString(resolved),
+            "[ә'kɒ:d]; n. 一致, 调和, 协定\\n vt. 给与, 使一致\\n vi. 相符合");
+  auto rejected = jsEngine.getObjectProperty(jsEngine.toObject(asyncLoad), "rejected");
+  ASSERT_FALSE(jsEngine.isUndefined(rejected));
+  EXPECT_FALSE(jsEngine.toStdString(rejected).empty());
+  auto isLoaded = jsEngine.getObjectProperty(jsEngine.toObject(asyncLoad), "isLoaded");
+  EXPECT_FALSE(jsEngine.toBool(isLoaded));
+
+  jsEngine.freeValue(evalResult, global, asyncLoad, resolved, rejected, isLoaded);
+}